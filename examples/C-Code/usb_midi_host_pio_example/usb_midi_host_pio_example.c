@@ -37,14 +37,14 @@
 #include "bsp/board_api.h"
 #include "tusb.h"
 #include "usb_midi_descriptor_lib.h"
-#include "utf16_to_utf8.h"
+#include "usb_midi_string_cache.h"
+#include "usb_midi_replug_cache.h"
 #ifdef RASPBERRYPI_PICO_W
 // The Board LED is controlled by the CYW43 WiFi/Bluetooth module
 #include "pico/cyw43_arch.h"
 #endif
 
 static uint8_t midi_dev_idx[CFG_TUH_MIDI];
-static bool display_dev_strings[CFG_TUH_MIDI];
 
 static void blink_led(void)
 {
@@ -102,13 +102,44 @@ static void send_next_note(void)
         message[4] = first_note;
 }
 
-static void print_string_descriptor(uint16_t *buffer)
+static void print_cached_string(const char* label, const char* str)
 {
-    const size_t maxsrc = ((*buffer) & 0xFF)/2 - 1;
-    const size_t maxdest = maxsrc*2+1; // allows up to 2 bytes to encode each utf-16 code unit
-    uint8_t dest[maxdest];
-    utf16ToUtf8(buffer+1, maxsrc, dest, maxdest);
-    printf("%s\r\n", dest);
+    if (str)
+        printf("%s%s\r\n", label, str);
+}
+
+// Print the cached strings of a device
+static void print_device_strings(uint8_t idx)
+{
+    tuh_itf_info_t info;
+    if (!tuh_midi_itf_get_info(midi_dev_idx[idx], &info))
+        return;
+    printf("For device %u at address %u:\r\n", idx, info.daddr);
+    print_cached_string("manufacturer: ", usb_midi_string_cache_get_manufacturer(idx));
+    print_cached_string("product: ", usb_midi_string_cache_get_product(idx));
+    print_cached_string("serial: ", usb_midi_string_cache_get_serial(idx));
+    usb_midi_descriptor_lib_device_summary_t summary;
+    if (!usb_midi_descriptor_lib_get_device_summary(idx, &summary))
+        return;
+    print_cached_string("interface: ", usb_midi_string_cache_get_string(idx, summary.itf_str_idx));
+    for (uint jdx = 0; jdx < summary.num_in_cables; jdx++) {
+        const char* name = usb_midi_string_cache_get_string(idx, summary.in_cable_str_idx[jdx]);
+        if (name)
+            printf("USB MIDI IN cable %u: %s\r\n", jdx, name);
+    }
+    for (uint jdx = 0; jdx < summary.num_out_cables; jdx++) {
+        const char* name = usb_midi_string_cache_get_string(idx, summary.out_cable_str_idx[jdx]);
+        if (name)
+            printf("USB MIDI OUT cable %u: %s\r\n", jdx, name);
+    }
+}
+
+// Called once the string cache has all of a device's strings
+static void device_strings_cached(uint8_t idx)
+{
+    // Remember the device so the next time it is plugged in it needs no parsing or string requests
+    usb_midi_replug_cache_store(idx);
+    print_device_strings(idx);
 }
 
 int main() {
@@ -116,9 +147,9 @@ int main() {
     bi_decl(bi_program_description("A MIDI PIO USB host example"));
     board_init();
     memset(midi_dev_idx, TUSB_INDEX_INVALID_8, sizeof(midi_dev_idx));
-    memset(display_dev_strings, 0, sizeof(display_dev_strings));
     for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++) {
         usb_midi_descriptor_lib_init(idx);
+        usb_midi_string_cache_init(idx);
     }
 
 
@@ -142,48 +173,9 @@ int main() {
             if (tuh_midi_mounted(midi_dev_idx[idx]) && tuh_midi_get_tx_cable_count(midi_dev_idx[idx] > 0)) {
                 tuh_midi_write_flush(midi_dev_idx[idx]);
             }
-            if (display_dev_strings[idx]) {
-                tuh_itf_info_t info;
-                uint16_t buffer[128];
-                if (tuh_midi_itf_get_info(midi_dev_idx[idx], &info)) {
-                    if (tuh_descriptor_get_string_langid_sync(info.daddr, buffer, sizeof(buffer)) == XFER_RESULT_SUCCESS) {
-                        display_dev_strings[idx] = false;
-                        uint16_t langid = buffer[1];
-                        printf("For device %u at address %u:\r\n", idx, info.daddr);
-                        if (tuh_descriptor_get_manufacturer_string_sync(info.daddr, langid, buffer, sizeof(buffer))== XFER_RESULT_SUCCESS) {
-                            printf("manufacturer: ");
-                            print_string_descriptor(buffer);
-                        }
-                        if (tuh_descriptor_get_product_string_sync(info.daddr, langid, buffer, sizeof(buffer))== XFER_RESULT_SUCCESS) {
-                            printf("product: ");
-                            print_string_descriptor(buffer);
-                        }
-                        if (tuh_descriptor_get_serial_string_sync(info.daddr, langid, buffer, sizeof(buffer))== XFER_RESULT_SUCCESS) {
-                            printf("serial: ");
-                            print_string_descriptor(buffer);
-                        }
-                        for (uint jdx = 0; jdx < tuh_midi_get_rx_cable_count(midi_dev_idx[idx]); jdx++) {
-                            uint8_t desc_idx = usb_midi_descriptor_lib_get_str_idx_for_in_cable(idx, jdx);
-                            if (desc_idx > 0) {
-                                if (tuh_descriptor_get_string_sync(info.daddr, desc_idx, langid, buffer, sizeof(buffer))== XFER_RESULT_SUCCESS) {
-                                    printf("USB MIDI IN cable 0: ");
-                                    print_string_descriptor(buffer);
-                                }
-                            }
-                        }
-                        for (uint jdx = 0; jdx < tuh_midi_get_tx_cable_count(midi_dev_idx[idx]); jdx++) {
-                            uint8_t desc_idx = usb_midi_descriptor_lib_get_str_idx_for_out_cable(idx, jdx);
-                            if (desc_idx > 0) {
-                                if (tuh_descriptor_get_string_sync(info.daddr, desc_idx, langid, buffer, sizeof(buffer))== XFER_RESULT_SUCCESS) {
-                                    printf("USB MIDI OUT cable 0: ");
-                                    print_string_descriptor(buffer);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
         }
+        // Fetch device strings without blocking the USB host
+        usb_midi_string_cache_task();
     }
 }
 
@@ -192,7 +184,11 @@ int main() {
 //--------------------------------------------------------------------+
 void tuh_midi_descriptor_cb(uint8_t idx, const tuh_midi_descriptor_cb_t * desc_cb_data)
 {
-    usb_midi_descriptor_lib_configure(idx, (uint8_t const *)(desc_cb_data->desc_midi), desc_cb_data->desc_midi_total_len);
+    tuh_itf_info_t info;
+    tuh_midi_itf_get_info(idx, &info);
+    // A device that was plugged in before is restored from the replug cache
+    if (!usb_midi_replug_cache_lookup(idx, info.daddr, (uint8_t const *)(desc_cb_data->desc_midi), desc_cb_data->desc_midi_total_len))
+        usb_midi_descriptor_lib_configure(idx, (uint8_t const *)(desc_cb_data->desc_midi), desc_cb_data->desc_midi_total_len);
 }
 
 void tuh_midi_mount_cb(uint8_t idx, const tuh_midi_mount_cb_t* mount_cb_data)
@@ -202,7 +198,10 @@ void tuh_midi_mount_cb(uint8_t idx, const tuh_midi_mount_cb_t* mount_cb_data)
   printf("MIDI device %u address = %u, IN endpoint has %u cables, OUT endpoint has %u cables\r\n",
       idx, info.daddr, mount_cb_data->rx_cable_count, mount_cb_data->tx_cable_count);
   midi_dev_idx[idx] = idx;
-  display_dev_strings[idx] = true;
+  if (usb_midi_string_cache_complete(idx))
+    print_device_strings(idx);
+  else
+    usb_midi_string_cache_start(idx, info.daddr, device_strings_cached);
 }
 
 // Invoked when device with hid interface is un-mounted
@@ -211,9 +210,9 @@ void tuh_midi_umount_cb(uint8_t idx)
     tuh_itf_info_t info;
     tuh_midi_itf_get_info(idx, &info);
     usb_midi_descriptor_lib_init(idx);
+    usb_midi_string_cache_init(idx);
 
     midi_dev_idx[idx] = TUSB_INDEX_INVALID_8;
-    display_dev_strings[idx] = false;
     printf("MIDI device %u address %u is unmounted\r\n", idx, info.daddr);
 }
 
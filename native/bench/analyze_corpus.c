@@ -0,0 +1,435 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Parse a directory of configuration descriptors captured from real
+ * devices on a pool of worker threads and report what the compile time
+ * limits need to hold and how fast the library parses them. Each worker
+ * parses into a device and an arena of its own, so the workers share
+ * nothing.
+ *
+ * A file holds one configuration descriptor, optionally preceded by the
+ * device descriptor, either as binary or as text with the bytes written as
+ * two digit hex numbers, the way lsusb -v and hexdump print them. On a text
+ * line everything up to the last ':' is a label; a line with anything but
+ * hex bytes after its label is skipped. With no paths, the built in corpus
+ * is parsed instead.
+ * Usage: analyze_corpus [-j threads] [-r repeat] [-v] [path...]
+ */
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "bench_util.h"
+
+// Longer files can not hold a configuration descriptor, even as hex text
+#define MAX_FILE_LEN (1024 * 1024)
+#define MAX_THREADS 64
+#define NUM_ERRORS (USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_LONG + 1)
+
+static const char* const error_names[NUM_ERRORS] = {
+  "none",
+  "no MIDI Streaming interface",
+  "bad descriptor",
+  "too many endpoints",
+  "arena full",
+  "no cables",
+  "descriptor too long",
+};
+
+typedef struct
+{
+  char* path;
+  uint8_t* data;          // what the file holds, as bytes
+  const uint8_t* config;  // the configuration descriptor in data
+  uint16_t config_len;    // its wTotalLength
+  uint8_t error;          // usb_midi_descriptor_lib_error_t of the first parse
+  uint16_t error_offset;
+} corpus_file_t;
+
+// What one worker found; the workers' results are added up at the end
+typedef struct
+{
+  usb_midi_descriptor_info_t dev;
+  usb_midi_descriptor_lib_arena_t arena;
+  uint8_t arena_bytes[USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE];
+  unsigned long parses;
+  uint64_t bytes;
+  uint64_t parse_ns;
+  unsigned long devices;
+  unsigned long errors[NUM_ERRORS];
+  unsigned long in_cables[MAX_IN_CABLES + 1];   // devices by number of IN endpoint cables
+  unsigned long out_cables[MAX_OUT_CABLES + 1]; // devices by number of OUT endpoint cables
+  unsigned long dropped_cables;   // devices that had cables dropped
+  unsigned long dropped_strings;  // devices that had string indices dropped
+  unsigned long multi_itf;        // devices with more than one MIDI Streaming interface
+  uint8_t max_in_jacks;
+  uint8_t max_out_jacks;
+  uint8_t max_strings;
+  uint8_t max_elements;
+  uint8_t max_audio_entities;
+  uint16_t max_arena_len;
+} analysis_t;
+
+static corpus_file_t* files;
+static size_t nfiles;
+static size_t files_size;
+static unsigned long unreadable; // files that are not a configuration descriptor
+static unsigned long repeat = 1;
+static atomic_ulong next_parse;
+
+static void add_file(const char* path, uint8_t* data, const uint8_t* config)
+{
+  if (nfiles == files_size)
+  {
+    files_size = files_size ? 2 * files_size : 256;
+    files = realloc(files, files_size * sizeof(*files));
+    if (files == NULL)
+    {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  corpus_file_t* file = files + nfiles++;
+  memset(file, 0, sizeof(*file));
+  file->path = strdup(path);
+  file->data = data;
+  file->config = config;
+  file->config_len = config[2] | (config[3] << 8);
+}
+
+// Convert the hex text in buf to bytes in place; return the number of bytes
+static size_t hex_to_bytes(uint8_t* buf, size_t len)
+{
+  size_t nbytes = 0;
+  size_t line = 0;
+  while (line < len)
+  {
+    size_t end = line;
+    while (end < len && buf[end] != '\n')
+      ++end;
+    size_t start = line;
+    for (size_t pos = line; pos < end; pos++)
+    {
+      if (buf[pos] == ':')
+        start = pos + 1;
+    }
+    // The bytes of a line are written over text already read
+    size_t line_bytes = nbytes;
+    bool hex_line = true;
+    for (size_t pos = start; pos < end && hex_line;)
+    {
+      if (isspace(buf[pos]))
+      {
+        ++pos;
+        continue;
+      }
+      if (buf[pos] == '0' && pos + 1 < end && (buf[pos + 1] == 'x' || buf[pos + 1] == 'X'))
+        pos += 2;
+      hex_line = pos + 2 <= end && isxdigit(buf[pos]) && isxdigit(buf[pos + 1]) &&
+        (pos + 2 == end || isspace(buf[pos + 2]) || buf[pos + 2] == ',');
+      if (hex_line)
+      {
+        char digits[3] = {(char)buf[pos], (char)buf[pos + 1], 0};
+        buf[line_bytes++] = (uint8_t)strtoul(digits, NULL, 16);
+        pos += 2 + (pos + 2 < end && buf[pos + 2] == ',');
+      }
+    }
+    if (hex_line)
+      nbytes = line_bytes;
+    line = end + 1;
+  }
+  return nbytes;
+}
+
+// Return the configuration descriptor at the start of buf, after the device descriptor if there is one
+static const uint8_t* find_config(const uint8_t* buf, size_t len)
+{
+  if (len >= sizeof(tusb_desc_device_t) && buf[0] == sizeof(tusb_desc_device_t) && buf[1] == TUSB_DESC_DEVICE)
+  {
+    buf += sizeof(tusb_desc_device_t);
+    len -= sizeof(tusb_desc_device_t);
+  }
+  if (len < sizeof(tusb_desc_configuration_t) || buf[0] < sizeof(tusb_desc_configuration_t) ||
+    buf[1] != TUSB_DESC_CONFIGURATION)
+    return NULL;
+  // The library reads up to wTotalLength, so all of it must be there
+  uint16_t total_len = buf[2] | (buf[3] << 8);
+  return total_len >= buf[0] && total_len <= len ? buf : NULL;
+}
+
+static void load_file(const char* path, off_t size)
+{
+  FILE* fp = size > 0 && size <= MAX_FILE_LEN ? fopen(path, "rb") : NULL;
+  uint8_t* data = fp ? malloc(size) : NULL;
+  size_t len = data ? fread(data, 1, size, fp) : 0;
+  if (fp)
+    fclose(fp);
+  const uint8_t* config = len ? find_config(data, len) : NULL;
+  if (config == NULL && len)
+    config = find_config(data, hex_to_bytes(data, len));
+  if (config == NULL)
+  {
+    fprintf(stderr, "%s: not a whole configuration descriptor\n", path);
+    free(data);
+    ++unreadable;
+    return;
+  }
+  add_file(path, data, config);
+}
+
+// Load a file, or every file under a directory
+static void load_path(const char* path)
+{
+  struct stat st;
+  if (stat(path, &st) != 0)
+  {
+    perror(path);
+    ++unreadable;
+    return;
+  }
+  if (!S_ISDIR(st.st_mode))
+  {
+    load_file(path, st.st_size);
+    return;
+  }
+  DIR* dir = opendir(path);
+  if (dir == NULL)
+  {
+    perror(path);
+    return;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if (entry->d_name[0] == '.')
+      continue;
+    char child[4096];
+    snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+    load_path(child);
+  }
+  closedir(dir);
+}
+
+static int compare_paths(const void* a, const void* b)
+{
+  return strcmp(((const corpus_file_t*)a)->path, ((const corpus_file_t*)b)->path);
+}
+
+static void load_builtin_corpus(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t entry = 0; entry < nentries; entry++)
+    add_file(entries[entry].name, NULL, entries[entry].config);
+}
+
+static void count_max8(uint8_t* max, uint8_t value)
+{
+  if (value > *max)
+    *max = value;
+}
+
+// Record what the library found in a device it just parsed
+static void record_device(analysis_t* analysis, corpus_file_t* file, bool ok)
+{
+  usb_midi_descriptor_info_t* dev = &analysis->dev;
+  usb_midi_descriptor_lib_stats_t stats;
+  usb_midi_descriptor_lib_dev_get_stats(dev, &stats);
+  file->error = stats.error;
+  file->error_offset = stats.error_offset;
+  ++analysis->devices;
+  ++analysis->errors[stats.error < NUM_ERRORS ? stats.error : USB_MIDI_DESCRIPTOR_LIB_ERROR_BAD_DESCRIPTOR];
+  // The jacks and elements are counted even if the parse failed later
+  count_max8(&analysis->max_in_jacks, stats.num_in_jacks);
+  count_max8(&analysis->max_out_jacks, stats.num_out_jacks);
+  count_max8(&analysis->max_elements, stats.num_elements);
+  analysis->dropped_cables += stats.cables_dropped != 0;
+  analysis->dropped_strings += stats.strings_dropped != 0;
+  usb_midi_descriptor_lib_interface_t itfs[2];
+  analysis->multi_itf += usb_midi_descriptor_lib_find_midi_interfaces(file->config, itfs, 2) > 1;
+  if (!ok)
+    return;
+  usb_midi_descriptor_lib_device_summary_t summary;
+  usb_midi_descriptor_lib_dev_get_device_summary(dev, &summary);
+  ++analysis->in_cables[summary.num_in_cables];
+  ++analysis->out_cables[summary.num_out_cables];
+  count_max8(&analysis->max_strings, summary.num_string_indices);
+  count_max8(&analysis->max_audio_entities, usb_midi_descriptor_lib_dev_get_num_audio_entities(dev));
+  uint16_t arena_len = usb_midi_descriptor_lib_dev_get_bytes_used(dev) - sizeof(*dev);
+  if (arena_len > analysis->max_arena_len)
+    analysis->max_arena_len = arena_len;
+}
+
+static void* worker(void* arg)
+{
+  analysis_t* analysis = arg;
+  usb_midi_descriptor_lib_arena_init(&analysis->arena, analysis->arena_bytes, sizeof(analysis->arena_bytes));
+  usb_midi_descriptor_lib_dev_set_arena(&analysis->dev, &analysis->arena);
+  unsigned long nparses = nfiles * repeat;
+  for (unsigned long parse = atomic_fetch_add(&next_parse, 1); parse < nparses; parse = atomic_fetch_add(&next_parse, 1))
+  {
+    corpus_file_t* file = files + parse % nfiles;
+    uint64_t start = bench_now_ns();
+    bool ok = usb_midi_descriptor_lib_dev_configure_from_full(&analysis->dev, file->config);
+    analysis->parse_ns += bench_now_ns() - start;
+    analysis->bytes += file->config_len;
+    ++analysis->parses;
+    // Each file's first parse is the one that is analyzed
+    if (parse < nfiles)
+      record_device(analysis, file, ok);
+  }
+  // Leave nothing in the worker's arena
+  usb_midi_descriptor_lib_dev_init(&analysis->dev);
+  return NULL;
+}
+
+static void add_analysis(analysis_t* total, const analysis_t* analysis)
+{
+  total->parses += analysis->parses;
+  total->bytes += analysis->bytes;
+  total->parse_ns += analysis->parse_ns;
+  total->devices += analysis->devices;
+  for (int error = 0; error < NUM_ERRORS; error++)
+    total->errors[error] += analysis->errors[error];
+  for (int cables = 0; cables <= MAX_IN_CABLES; cables++)
+    total->in_cables[cables] += analysis->in_cables[cables];
+  for (int cables = 0; cables <= MAX_OUT_CABLES; cables++)
+    total->out_cables[cables] += analysis->out_cables[cables];
+  total->dropped_cables += analysis->dropped_cables;
+  total->dropped_strings += analysis->dropped_strings;
+  total->multi_itf += analysis->multi_itf;
+  count_max8(&total->max_in_jacks, analysis->max_in_jacks);
+  count_max8(&total->max_out_jacks, analysis->max_out_jacks);
+  count_max8(&total->max_strings, analysis->max_strings);
+  count_max8(&total->max_elements, analysis->max_elements);
+  count_max8(&total->max_audio_entities, analysis->max_audio_entities);
+  if (analysis->max_arena_len > total->max_arena_len)
+    total->max_arena_len = analysis->max_arena_len;
+}
+
+static void print_histogram(const char* name, const unsigned long* counts, int max_cables)
+{
+  printf("%s\n", name);
+  for (int cables = 0; cables <= max_cables; cables++)
+  {
+    if (counts[cables])
+      printf("  %2d cables %8lu\n", cables, counts[cables]);
+  }
+}
+
+static void print_report(const analysis_t* total, int nthreads, uint64_t wall_ns, bool verbose)
+{
+  printf("%zu devices, %lu files skipped, %d threads, %lu passes\n", nfiles, unreadable, nthreads, repeat);
+  printf("\nparse results\n");
+  for (int error = 0; error < NUM_ERRORS; error++)
+  {
+    if (total->errors[error])
+      printf("  %-28s %8lu\n", error == USB_MIDI_DESCRIPTOR_LIB_ERROR_NONE ? "ok" : error_names[error], total->errors[error]);
+  }
+  if (verbose)
+  {
+    for (size_t idx = 0; idx < nfiles; idx++)
+    {
+      if (files[idx].error != USB_MIDI_DESCRIPTOR_LIB_ERROR_NONE)
+        printf("  %s: %s at offset %u\n", files[idx].path, error_names[files[idx].error], files[idx].error_offset);
+    }
+  }
+  printf("\n");
+  print_histogram("IN endpoint cables", total->in_cables, MAX_IN_CABLES);
+  print_histogram("OUT endpoint cables", total->out_cables, MAX_OUT_CABLES);
+  printf("\n%-28s %8s %8s %8s\n", "limit", "max seen", "limit", "dropped");
+  printf("%-28s %8u %8s\n", "MIDI IN jacks", total->max_in_jacks, "none");
+  printf("%-28s %8u %8s\n", "MIDI OUT jacks", total->max_out_jacks, "none");
+  printf("%-28s %8s %8d %8lu\n", "MAX_IN_CABLES/MAX_OUT_CABLES", "", MAX_IN_CABLES, total->dropped_cables);
+  printf("%-28s %8u %8d %8lu\n", "MAX_STRING_INDICES", total->max_strings, MAX_STRING_INDICES, total->dropped_strings);
+  printf("%-28s %8u %8d\n", "arena bytes per device", total->max_arena_len, USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE);
+  printf("The dropped column counts devices.\n");
+  printf("%lu devices have more than one MIDI Streaming interface; at most %u Elements and %u Audio Control entities\n",
+    total->multi_itf, total->max_elements, total->max_audio_entities);
+  double wall_s = wall_ns / 1e9;
+  printf("\n%lu parses, %.1f MB in %.3f s: %.0f parses/s, %.1f MB/s, %.1f ns per parse per thread\n",
+    total->parses, total->bytes / 1e6, wall_s, total->parses / wall_s, total->bytes / 1e6 / wall_s,
+    total->parses ? (double)total->parse_ns / total->parses : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+  long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:r:v")) != -1)
+  {
+    if (opt == 'j')
+      nthreads = strtol(optarg, NULL, 0);
+    else if (opt == 'r')
+      repeat = strtoul(optarg, NULL, 0);
+    else if (opt == 'v')
+      verbose = true;
+    else
+    {
+      fprintf(stderr, "Usage: %s [-j threads] [-r repeat] [-v] [path...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (nthreads < 1)
+    nthreads = 1;
+  if (nthreads > MAX_THREADS)
+    nthreads = MAX_THREADS;
+  if (repeat < 1)
+    repeat = 1;
+  for (int arg = optind; arg < argc; arg++)
+    load_path(argv[arg]);
+  if (optind == argc)
+    load_builtin_corpus();
+  else if (nfiles)
+    qsort(files, nfiles, sizeof(*files), compare_paths);
+  if (nfiles == 0)
+  {
+    fprintf(stderr, "no configuration descriptors found\n");
+    return 1;
+  }
+
+  static analysis_t analyses[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  uint64_t start = bench_now_ns();
+  for (long thread = 0; thread < nthreads; thread++)
+    pthread_create(threads + thread, NULL, worker, analyses + thread);
+  analysis_t total = {0};
+  for (long thread = 0; thread < nthreads; thread++)
+  {
+    pthread_join(threads[thread], NULL);
+    add_analysis(&total, analyses + thread);
+  }
+  uint64_t wall_ns = bench_now_ns() - start;
+  print_report(&total, (int)nthreads, wall_ns, verbose);
+  return 0;
+}
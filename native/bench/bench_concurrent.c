@@ -0,0 +1,185 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Look up cable string indices from reader threads while a writer thread
+ * keeps unplugging and replugging corpus devices in every device slot, the
+ * way a UI core reads device names while the USB host core mounts devices.
+ * Every result must be what some corpus device would return, or what an
+ * unconfigured slot returns. Reports the reader cost per lookup with and
+ * without the hotplug churn.
+ * Usage: bench_concurrent [lookups per reader]
+ */
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "bench_util.h"
+
+#define NUM_READERS 2
+#define MAX_ENTRIES 16
+#define MAX_CABLES 16
+
+// What each corpus device returns, recorded before any thread starts
+typedef struct
+{
+  int nstrings;
+  uint8_t strings[256];
+  uint8_t in_cables[MAX_CABLES];
+  uint8_t out_cables[MAX_CABLES];
+} expected_t;
+
+static expected_t expected[MAX_ENTRIES];
+static size_t nexpected;
+static const descriptor_corpus_entry_t* entries;
+static atomic_bool stop;
+static atomic_ulong num_bad;
+static unsigned long num_lookups;
+
+static bool cable_ok(bool in, uint8_t cable, int str_idx)
+{
+  if (str_idx == 0)
+    return true;
+  for (size_t entry = 0; entry < nexpected; entry++)
+  {
+    if (cable < MAX_CABLES && (in ? expected[entry].in_cables[cable] : expected[entry].out_cables[cable]) == str_idx)
+      return true;
+  }
+  return false;
+}
+
+static bool strings_ok(int nstrings, const uint8_t* strings)
+{
+  if (nstrings < 0)
+    return true;
+  for (size_t entry = 0; entry < nexpected; entry++)
+  {
+    if (expected[entry].nstrings == nstrings && memcmp(expected[entry].strings, strings, nstrings) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void* reader(void* arg)
+{
+  (void)arg;
+  uint8_t strings[256];
+  uint32_t sum = 0;
+  for (unsigned long lookup = 0; lookup < num_lookups; lookup++)
+  {
+    uint8_t idx = lookup % CFG_TUH_MIDI;
+    uint8_t cable = (lookup / CFG_TUH_MIDI) % MAX_CABLES;
+    int in_str_idx = usb_midi_descriptor_lib_get_str_idx_for_in_cable(idx, cable);
+    int out_str_idx = usb_midi_descriptor_lib_get_str_idx_for_out_cable(idx, cable);
+    if (!cable_ok(true, cable, in_str_idx) || !cable_ok(false, cable, out_str_idx))
+      atomic_fetch_add(&num_bad, 1);
+    if (cable == 0)
+    {
+      int nstrings = usb_midi_descriptor_lib_copy_all_str_indices(idx, strings, sizeof(strings) - 1);
+      if (!strings_ok(nstrings, strings))
+        atomic_fetch_add(&num_bad, 1);
+    }
+    sum += in_str_idx + out_str_idx;
+  }
+  bench_consume(sum);
+  return NULL;
+}
+
+static void* writer(void* arg)
+{
+  unsigned long* nreplugs = arg;
+  size_t entry = 0;
+  while (!atomic_load(&stop))
+  {
+    for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++)
+    {
+      // A configure that does not fit in the arena leaves the slot unconfigured
+      usb_midi_descriptor_lib_configure_from_full(idx, entries[entry].config);
+      entry = (entry + 1) % nexpected;
+      ++*nreplugs;
+    }
+  }
+  return NULL;
+}
+
+// Return the reader time per lookup, in ns
+static double run_readers(void)
+{
+  pthread_t readers[NUM_READERS];
+  uint64_t start = bench_now_ns();
+  for (int thread = 0; thread < NUM_READERS; thread++)
+    pthread_create(readers + thread, NULL, reader, NULL);
+  for (int thread = 0; thread < NUM_READERS; thread++)
+    pthread_join(readers[thread], NULL);
+  return (double)(bench_now_ns() - start) / (NUM_READERS * num_lookups * 2.0);
+}
+
+int main(int argc, char** argv)
+{
+  num_lookups = bench_iterations(argc, argv, 2000000);
+  nexpected = descriptor_corpus_get(&entries);
+  if (nexpected > MAX_ENTRIES)
+    nexpected = MAX_ENTRIES;
+  for (size_t entry = 0; entry < nexpected; entry++)
+  {
+    usb_midi_descriptor_lib_init(0);
+    if (!usb_midi_descriptor_lib_configure_from_full(0, entries[entry].config))
+    {
+      printf("%s: parse failed\n", entries[entry].name);
+      return 1;
+    }
+    expected_t* exp = expected + entry;
+    const uint8_t* strings;
+    exp->nstrings = usb_midi_descriptor_lib_get_all_str_inidices(0, &strings);
+    if (exp->nstrings > 0)
+      memcpy(exp->strings, strings, exp->nstrings);
+    for (uint8_t cable = 0; cable < MAX_CABLES; cable++)
+    {
+      exp->in_cables[cable] = usb_midi_descriptor_lib_get_str_idx_for_in_cable(0, cable);
+      exp->out_cables[cable] = usb_midi_descriptor_lib_get_str_idx_for_out_cable(0, cable);
+    }
+  }
+
+  // Readers alone, with a corpus device in every slot that fits
+  for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++)
+    usb_midi_descriptor_lib_configure_from_full(idx, entries[idx % nexpected].config);
+  double quiet_ns = run_readers();
+
+  // Readers while the writer replugs devices
+  unsigned long nreplugs = 0;
+  pthread_t writer_thread;
+  pthread_create(&writer_thread, NULL, writer, &nreplugs);
+  double churn_ns = run_readers();
+  atomic_store(&stop, true);
+  pthread_join(writer_thread, NULL);
+
+  printf("%d readers, %lu lookups each, %d device slots\n", NUM_READERS, num_lookups, CFG_TUH_MIDI);
+  printf("%-24s %12s\n", "", "ns/lookup");
+  printf("%-24s %12.2f\n", "no hotplug", quiet_ns);
+  printf("%-24s %12.2f\n", "hotplug churn", churn_ns);
+  printf("%lu replugs, %lu inconsistent results\n", nreplugs, atomic_load(&num_bad));
+  return atomic_load(&num_bad) ? 1 : 0;
+}
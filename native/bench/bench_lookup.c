@@ -0,0 +1,111 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measure the cost of looking up the string index of every cable of a
+ * configured device, the way a UI refresh labels each cable, and of getting
+ * everything a UI shows about the device with the per-endpoint and per-cable
+ * getters and with one usb_midi_descriptor_lib_get_device_summary() call.
+ * Usage: bench_lookup [iterations]
+ */
+#include <stdio.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "bench_util.h"
+
+// Get what usb_midi_descriptor_lib_get_device_summary() gets, one getter call at a time
+static uint32_t get_with_getters(uint8_t idx)
+{
+  uint32_t sum = 0;
+  uint8_t num_in_eps = usb_midi_descriptor_lib_get_num_in_endpoints(idx);
+  for (uint8_t ep_num = 0; ep_num < num_in_eps; ep_num++)
+  {
+    uint8_t ep_addr, num_cables;
+    usb_midi_descriptor_lib_get_in_endpoint(idx, ep_num, &ep_addr, &num_cables);
+    for (uint8_t cable = 0; cable < num_cables; cable++)
+      sum += usb_midi_descriptor_lib_get_str_idx_for_in_endpoint_cable(idx, ep_num, cable);
+    sum += ep_addr;
+  }
+  uint8_t num_out_eps = usb_midi_descriptor_lib_get_num_out_endpoints(idx);
+  for (uint8_t ep_num = 0; ep_num < num_out_eps; ep_num++)
+  {
+    uint8_t ep_addr, num_cables;
+    usb_midi_descriptor_lib_get_out_endpoint(idx, ep_num, &ep_addr, &num_cables);
+    for (uint8_t cable = 0; cable < num_cables; cable++)
+      sum += usb_midi_descriptor_lib_get_str_idx_for_out_endpoint_cable(idx, ep_num, cable);
+    sum += ep_addr;
+  }
+  uint8_t strings[MAX_STRING_INDICES];
+  sum += usb_midi_descriptor_lib_copy_all_str_indices(idx, strings, sizeof(strings));
+  return sum + strings[0];
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long iterations = bench_iterations(argc, argv, 1000000);
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+
+  printf("%lu iterations per corpus entry\n", iterations);
+  printf("%-36s %6s %12s %12s %12s %12s\n", "descriptor", "cables", "ns/refresh", "ns/lookup", "ns/getters", "ns/summary");
+  for (size_t idx = 0; idx < nentries; idx++)
+  {
+    const descriptor_corpus_entry_t* entry = entries + idx;
+    usb_midi_descriptor_lib_init(0);
+    if (!usb_midi_descriptor_lib_configure_from_full(0, entry->config))
+    {
+      printf("%s: parse failed\n", entry->name);
+      return 1;
+    }
+    unsigned ncables = entry->num_cables_rx + entry->num_cables_tx;
+    uint64_t start = bench_now_ns();
+    for (unsigned long iteration = 0; iteration < iterations; iteration++)
+    {
+      uint32_t sum = 0;
+      for (uint8_t cable = 0; cable < entry->num_cables_rx; cable++)
+        sum += usb_midi_descriptor_lib_get_str_idx_for_in_cable(0, cable);
+      for (uint8_t cable = 0; cable < entry->num_cables_tx; cable++)
+        sum += usb_midi_descriptor_lib_get_str_idx_for_out_cable(0, cable);
+      bench_consume(sum);
+    }
+    double ns = (double)(bench_now_ns() - start) / iterations;
+
+    start = bench_now_ns();
+    for (unsigned long iteration = 0; iteration < iterations; iteration++)
+      bench_consume(get_with_getters(0));
+    double getters_ns = (double)(bench_now_ns() - start) / iterations;
+
+    usb_midi_descriptor_lib_device_summary_t summary;
+    start = bench_now_ns();
+    for (unsigned long iteration = 0; iteration < iterations; iteration++)
+    {
+      usb_midi_descriptor_lib_get_device_summary(0, &summary);
+      bench_consume(summary.in_cable_str_idx[0] + summary.num_string_indices);
+    }
+    double summary_ns = (double)(bench_now_ns() - start) / iterations;
+    printf("%-36s %6u %12.1f %12.2f %12.1f %12.1f\n", entry->name, ncables, ns, ns / ncables, getters_ns, summary_ns);
+  }
+  return 0;
+}
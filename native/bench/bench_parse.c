@@ -0,0 +1,154 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measure how long usb_midi_descriptor_lib_configure_from_full(),
+ * usb_midi_descriptor_lib_configure() and the streaming parser take to
+ * parse each configuration descriptor in the corpus, and how long
+ * usb_midi_descriptor_lib_configure_view() takes to check its MIDI
+ * Streaming interface for reading in place.
+ * Usage: bench_parse [iterations]
+ */
+#include <stdio.h>
+#include <string.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "bench_util.h"
+
+typedef bool (*parse_fn_t)(const descriptor_corpus_entry_t* entry);
+
+static bool parse_full(const descriptor_corpus_entry_t* entry)
+{
+  usb_midi_descriptor_lib_init(0);
+  return usb_midi_descriptor_lib_configure_from_full(0, entry->config);
+}
+
+static bool parse_midi(const descriptor_corpus_entry_t* entry)
+{
+  usb_midi_descriptor_lib_init(0);
+  return usb_midi_descriptor_lib_configure(0, entry->config + entry->midi_offset,
+      entry->config_len - entry->midi_offset);
+}
+
+static bool parse_view(const descriptor_corpus_entry_t* entry)
+{
+  usb_midi_descriptor_lib_init(0);
+  return usb_midi_descriptor_lib_configure_view(0, entry->config + entry->midi_offset,
+      entry->config_len - entry->midi_offset);
+}
+
+// Feed the configuration descriptor in pieces the size of a full speed control transfer packet
+#define STREAM_CHUNK 64
+
+static bool parse_stream(const descriptor_corpus_entry_t* entry)
+{
+  static usb_midi_descriptor_parser_t parser;
+  usb_midi_descriptor_parser_init(&parser, 0);
+  for (uint16_t offset = 0; offset < entry->config_len; offset += STREAM_CHUNK)
+  {
+    uint16_t len = entry->config_len - offset;
+    if (len > STREAM_CHUNK)
+      len = STREAM_CHUNK;
+    if (!usb_midi_descriptor_parser_feed(&parser, entry->config + offset, len))
+      return false;
+  }
+  return usb_midi_descriptor_parser_complete(&parser);
+}
+
+// Everything the getters report for device slot 0
+typedef struct
+{
+  int nstrings;
+  uint8_t strings[MAX_STRING_INDICES];
+  int in_cables[MAX_IN_CABLES];
+  int out_cables[MAX_OUT_CABLES];
+} parse_result_t;
+
+static void get_result(parse_result_t* result)
+{
+  const uint8_t* strings;
+  memset(result, 0, sizeof(*result));
+  result->nstrings = usb_midi_descriptor_lib_get_all_str_inidices(0, &strings);
+  if (result->nstrings > 0)
+    memcpy(result->strings, strings, result->nstrings);
+  for (uint8_t cable = 0; cable < MAX_IN_CABLES; cable++)
+    result->in_cables[cable] = usb_midi_descriptor_lib_get_str_idx_for_in_cable(0, cable);
+  for (uint8_t cable = 0; cable < MAX_OUT_CABLES; cable++)
+    result->out_cables[cable] = usb_midi_descriptor_lib_get_str_idx_for_out_cable(0, cable);
+}
+
+// Return the number of nanoseconds one call to parse takes on average
+static double time_parse(parse_fn_t parse, const descriptor_corpus_entry_t* entry, unsigned long iterations)
+{
+  uint64_t start = bench_now_ns();
+  for (unsigned long iteration = 0; iteration < iterations; iteration++)
+  {
+    bench_consume(parse(entry));
+  }
+  return (double)(bench_now_ns() - start) / iterations;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long iterations = bench_iterations(argc, argv, 200000);
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+
+  printf("%lu iterations per corpus entry\n", iterations);
+  printf("%-36s %5s %5s %10s %10s %9s %10s %9s %10s %9s %10s\n", "descriptor", "bytes", "descs",
+      "full ns", "ns/desc", "MB/s", "midi ns", "MB/s", "stream ns", "MB/s", "view ns");
+  double total_ns = 0;
+  unsigned long total_bytes = 0;
+  for (size_t idx = 0; idx < nentries; idx++)
+  {
+    const descriptor_corpus_entry_t* entry = entries + idx;
+    // Make sure each parse succeeds and that the streaming parser agrees
+    // with the full parse before timing them
+    parse_result_t full_result, result;
+    bool ok = parse_midi(entry) && parse_full(entry);
+    get_result(&full_result);
+    ok = ok && parse_stream(entry);
+    get_result(&result);
+    ok = ok && memcmp(&full_result, &result, sizeof(result)) == 0 && parse_view(entry);
+    if (!ok)
+    {
+      printf("%s: parse failed\n", entry->name);
+      return 1;
+    }
+    double full_ns = time_parse(parse_full, entry, iterations);
+    double midi_ns = time_parse(parse_midi, entry, iterations);
+    double stream_ns = time_parse(parse_stream, entry, iterations);
+    double view_ns = time_parse(parse_view, entry, iterations);
+    uint16_t midi_len = entry->config_len - entry->midi_offset;
+    printf("%-36s %5u %5u %10.1f %10.2f %9.1f %10.1f %9.1f %10.1f %9.1f %10.1f\n", entry->name,
+        entry->config_len, entry->num_descriptors, full_ns, full_ns / entry->num_descriptors,
+        entry->config_len / full_ns * 1e3, midi_ns, midi_len / midi_ns * 1e3,
+        stream_ns, entry->config_len / stream_ns * 1e3, view_ns);
+    total_ns += full_ns;
+    total_bytes += entry->config_len;
+  }
+  printf("corpus total: %.1f ns per pass, %.1f MB/s\n", total_ns, total_bytes / total_ns * 1e3);
+  return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Compare mounting a device the first time, which parses its MIDI
+ * interface descriptors and requests every string descriptor, with
+ * mounting it again, which restores it from the replug cache, and with
+ * mounting it after a power cycle from an image in flash. The USB
+ * host is simulated: each string request completes when the benchmark
+ * completes it, with a made up string.
+ * Usage: bench_replug [iterations]
+ */
+#include <stdio.h>
+#include "usb_midi_descriptor_lib.h"
+#include "usb_midi_string_cache.h"
+#include "usb_midi_replug_cache.h"
+#include "descriptor_corpus.h"
+#include "bench_util.h"
+
+#define BENCH_DADDR 1
+
+// The request the simulated host has in flight
+static tuh_xfer_cb_t pending_cb;
+static uint8_t* pending_buffer;
+static uint8_t pending_str_idx;
+static uintptr_t pending_user_data;
+static unsigned num_requests;
+
+bool tuh_descriptor_get_device_local(uint8_t daddr, tusb_desc_device_t* desc_device)
+{
+  memset(desc_device, 0, sizeof(*desc_device));
+  desc_device->idVendor = 0x1234;
+  desc_device->idProduct = 0x5678 + daddr;
+  desc_device->bcdDevice = 0x0100;
+  desc_device->iManufacturer = 1;
+  desc_device->iProduct = 2;
+  desc_device->iSerialNumber = 3;
+  return true;
+}
+
+static bool start_request(uint8_t index, void* buffer, tuh_xfer_cb_t complete_cb, uintptr_t user_data)
+{
+  if (pending_cb)
+    return false;
+  pending_cb = complete_cb;
+  pending_buffer = buffer;
+  pending_str_idx = index;
+  pending_user_data = user_data;
+  ++num_requests;
+  return true;
+}
+
+bool tuh_descriptor_get_string(uint8_t daddr, uint8_t index, uint16_t language_id, void* buffer, uint16_t len,
+                               tuh_xfer_cb_t complete_cb, uintptr_t user_data)
+{
+  (void)daddr;
+  (void)language_id;
+  (void)len;
+  return start_request(index, buffer, complete_cb, user_data);
+}
+
+bool tuh_descriptor_get_string_langid(uint8_t daddr, void* buffer, uint16_t len,
+                                      tuh_xfer_cb_t complete_cb, uintptr_t user_data)
+{
+  (void)daddr;
+  (void)len;
+  return start_request(0, buffer, complete_cb, user_data);
+}
+
+// Complete the request in flight with the string "String <index>" or, for index 0, US English
+static void complete_request(void)
+{
+  char str[16];
+  int len = pending_str_idx == 0 ? 1 : snprintf(str, sizeof(str), "String %u", pending_str_idx);
+  pending_buffer[0] = 2 + 2 * len;
+  pending_buffer[1] = TUSB_DESC_STRING;
+  for (int unit = 0; unit < len; unit++)
+  {
+    pending_buffer[2 + 2 * unit] = pending_str_idx == 0 ? 0x09 : str[unit];
+    pending_buffer[3 + 2 * unit] = pending_str_idx == 0 ? 0x04 : 0;
+  }
+  tuh_xfer_t xfer = {
+    .daddr = BENCH_DADDR, .result = XFER_RESULT_SUCCESS, .actual_len = 2 + 2 * len,
+    .buffer = pending_buffer, .complete_cb = pending_cb, .user_data = pending_user_data
+  };
+  tuh_xfer_cb_t cb = pending_cb;
+  pending_cb = NULL;
+  cb(&xfer);
+}
+
+// Mount the device the way the examples do. Return true if it came from the replug cache.
+static bool mount(const descriptor_corpus_entry_t* entry)
+{
+  const uint8_t* midi = entry->config + entry->midi_offset;
+  uint32_t midi_len = entry->config_len - entry->midi_offset;
+  if (usb_midi_replug_cache_lookup(0, BENCH_DADDR, midi, midi_len))
+    return true;
+  if (!usb_midi_descriptor_lib_configure(0, midi, midi_len) ||
+      !usb_midi_string_cache_start(0, BENCH_DADDR, NULL))
+    return false;
+  while (pending_cb)
+    complete_request();
+  return usb_midi_string_cache_complete(0) && usb_midi_replug_cache_store(0);
+}
+
+static void unmount(void)
+{
+  usb_midi_descriptor_lib_init(0);
+  usb_midi_string_cache_init(0);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long iterations = bench_iterations(argc, argv, 100000);
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+
+  printf("%lu iterations per corpus entry\n", iterations);
+  printf("%-36s %8s %12s %12s %12s %8s\n", "descriptor", "requests", "ns/mount", "ns/replug", "ns/image", "bytes");
+  for (size_t idx = 0; idx < nentries; idx++)
+  {
+    const descriptor_corpus_entry_t* entry = entries + idx;
+    // The first mount parses and fetches strings
+    uint64_t start = bench_now_ns();
+    for (unsigned long iteration = 0; iteration < iterations; iteration++)
+    {
+      usb_midi_replug_cache_clear();
+      num_requests = 0;
+      if (!mount(entry))
+      {
+        printf("%s: first mount failed\n", entry->name);
+        return 1;
+      }
+      unmount();
+    }
+    double mount_ns = (double)(bench_now_ns() - start) / iterations;
+    unsigned first_requests = num_requests;
+    // Every mount after that is restored from the replug cache
+    num_requests = 0;
+    start = bench_now_ns();
+    for (unsigned long iteration = 0; iteration < iterations; iteration++)
+    {
+      if (!mount(entry))
+      {
+        printf("%s: replug cache miss\n", entry->name);
+        return 1;
+      }
+      bench_consume(usb_midi_string_cache_get_in_cable_name(0, 0) != NULL);
+      unmount();
+    }
+    double replug_ns = (double)(bench_now_ns() - start) / iterations;
+    if (num_requests != 0)
+    {
+      printf("%s: replug requested %u strings\n", entry->name, num_requests);
+      return 1;
+    }
+    // After a power cycle, the device is restored from its image, read in place
+    static uint8_t image[4096];
+    mount(entry);
+    uint16_t image_len = usb_midi_replug_cache_save_image(0, image, sizeof(image));
+    unmount();
+    usb_midi_replug_cache_clear();
+    if (!usb_midi_replug_cache_add_image(image, image_len))
+    {
+      printf("%s: image not valid\n", entry->name);
+      return 1;
+    }
+    start = bench_now_ns();
+    for (unsigned long iteration = 0; iteration < iterations; iteration++)
+    {
+      if (!mount(entry))
+      {
+        printf("%s: image miss\n", entry->name);
+        return 1;
+      }
+      bench_consume(usb_midi_string_cache_get_in_cable_name(0, 0) != NULL);
+      unmount();
+    }
+    double image_ns = (double)(bench_now_ns() - start) / iterations;
+    printf("%-36s %8u %12.1f %12.1f %12.1f %8u\n", entry->name, first_requests, mount_ns, replug_ns, image_ns, image_len);
+  }
+  return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measure utf16ToUtf8() on corpora of ASCII, Latin-1, CJK and emoji
+ * device and jack names, and utf16DescriptorToUtf8() on the same names
+ * as unaligned string descriptors. The build makes this twice: bench_utf16 with
+ * the ASCII fast path and bench_utf16_scalar without it. Both print a
+ * checksum of every converted string so the outputs can be compared.
+ * Usage: bench_utf16 [iterations]
+ */
+#include <stdio.h>
+#include <uchar.h>
+#include "utf16_to_utf8.h"
+#include "bench_util.h"
+
+#define MAX_CORPUS_STRINGS 16
+#define BENCH_RUNS 5
+
+typedef struct
+{
+  const char* name;
+  const char16_t* const* strings;
+  size_t num_strings;
+} utf16_corpus_t;
+
+static const char16_t* const ascii_strings[] = {
+  u"MIDI Interface", u"USB MIDI Keyboard Controller", u"Port 1", u"MIDI IN 16",
+  u"Control Surface DAW Port", u"Synth Expander Module MIDI OUT", u"Serial 0123456789ABCDEF",
+};
+
+static const char16_t* const latin1_strings[] = {
+  u"Größe Klaviatur", u"Contrôleur MIDI Édition", u"Señal de Entrada", u"Æther Ørsted Ånd",
+  u"Café Crème Sortie", u"Über-Synth Ausgang", u"Sémaphore à Réglage",
+};
+
+static const char16_t* const cjk_strings[] = {
+  u"ミディ入力ポート", u"キーボード・コントローラ", u"音源モジュール出力", u"键盘控制器",
+  u"迷笛接口输入", u"미디 인터페이스", u"シンセサイザー端子",
+};
+
+static const char16_t* const emoji_strings[] = {
+  u"🎹 Keys 🎹", u"🎛️ Mixer 🎚️", u"🥁🥁 Drums 🥁🥁", u"🎸 Guitar 🎤 Vocal",
+  u"🎵🎶🎵🎶 Notes", u"🔊 Out 🔈 In", u"😀😃😄😁 Happy",
+};
+
+#define CORPUS(_name, _strings) { _name, _strings, sizeof(_strings) / sizeof(_strings[0]) }
+
+static const utf16_corpus_t corpora[] = {
+  CORPUS("ASCII", ascii_strings),
+  CORPUS("Latin-1", latin1_strings),
+  CORPUS("CJK", cjk_strings),
+  CORPUS("emoji", emoji_strings),
+};
+
+static size_t utf16_len(const char16_t* str)
+{
+  size_t len = 0;
+  while (str[len] != 0)
+    len++;
+  return len;
+}
+
+// FNV-1a hash of a NULL terminated string, including the termination
+static uint32_t checksum(uint32_t hash, const uint8_t* str)
+{
+  do {
+    hash = (hash ^ *str) * 16777619u;
+  } while (*str++ != 0);
+  return hash;
+}
+
+// Build the string descriptor of str the way it arrives from a device
+static void make_descriptor(uint8_t* desc, const char16_t* str, size_t len)
+{
+  desc[0] = (uint8_t)(2 + 2 * len);
+  desc[1] = 3; // TUSB_DESC_STRING
+  for (size_t unit = 0; unit < len; unit++)
+  {
+    desc[2 + 2 * unit] = str[unit] & 0xFF;
+    desc[3 + 2 * unit] = str[unit] >> 8;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long iterations = bench_iterations(argc, argv, 500000);
+  uint8_t dest[3 * 126 + 1];
+  uint8_t desc_dest[3 * 126 + 1];
+  // Each descriptor starts at an odd address, as it may in a transfer buffer
+  static uint8_t descs[MAX_CORPUS_STRINGS][1 + 256];
+  uint32_t total_checksum = 2166136261u;
+
+  printf("best of %d runs of %lu iterations per corpus, ASCII fast path %s\n", BENCH_RUNS, iterations, UTF16_TO_UTF8_ASCII_FAST_PATH ? "on" : "off");
+  printf("%-8s %7s %7s %12s %12s %12s %10s\n", "corpus", "units", "bytes", "ns/string", "ns/unit", "ns/desc", "checksum");
+  for (size_t idx = 0; idx < sizeof(corpora) / sizeof(corpora[0]); idx++)
+  {
+    const utf16_corpus_t* corpus = corpora + idx;
+    size_t lens[MAX_CORPUS_STRINGS];
+    size_t num_units = 0;
+    size_t num_bytes = 0;
+    uint32_t corpus_checksum = 2166136261u;
+    for (size_t str = 0; str < corpus->num_strings; str++)
+    {
+      size_t len = lens[str] = utf16_len(corpus->strings[str]);
+      make_descriptor(descs[str] + 1, corpus->strings[str], len);
+      utf16ToUtf8((uint16_t*)corpus->strings[str], len, dest, sizeof(dest));
+      utf16DescriptorToUtf8(descs[str] + 1, 256, desc_dest, sizeof(desc_dest));
+      if (strcmp((const char*)dest, (const char*)desc_dest) != 0)
+      {
+        printf("%s string %zu: descriptor conversion differs\n", corpus->name, str);
+        return 1;
+      }
+      num_units += len;
+      num_bytes += strlen((const char*)dest);
+      corpus_checksum = checksum(corpus_checksum, dest);
+    }
+    total_checksum = checksum(total_checksum ^ corpus_checksum, (const uint8_t*)"");
+    // Report the fastest of several runs; the slower ones were interrupted
+    double ns = 0;
+    double desc_ns = 0;
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+      uint64_t start = bench_now_ns();
+      for (unsigned long iteration = 0; iteration < iterations; iteration++)
+      {
+        for (size_t str = 0; str < corpus->num_strings; str++)
+        {
+          // Like a string descriptor, the length is known and the NULL termination is not used
+          utf16ToUtf8((uint16_t*)corpus->strings[str], lens[str], dest, sizeof(dest));
+          bench_consume(dest[0]);
+        }
+      }
+      double run_ns = (double)(bench_now_ns() - start) / iterations;
+      if (run == 0 || run_ns < ns)
+        ns = run_ns;
+      start = bench_now_ns();
+      for (unsigned long iteration = 0; iteration < iterations; iteration++)
+      {
+        for (size_t str = 0; str < corpus->num_strings; str++)
+        {
+          utf16DescriptorToUtf8(descs[str] + 1, 256, desc_dest, sizeof(desc_dest));
+          bench_consume(desc_dest[0]);
+        }
+      }
+      run_ns = (double)(bench_now_ns() - start) / iterations;
+      if (run == 0 || run_ns < desc_ns)
+        desc_ns = run_ns;
+    }
+    printf("%-8s %7zu %7zu %12.1f %12.2f %12.1f %10x\n", corpus->name, num_units, num_bytes,
+      ns / corpus->num_strings, ns / num_units, desc_ns / corpus->num_strings, corpus_checksum);
+  }
+  printf("checksum of all output: %08x\n", total_checksum);
+  return 0;
+}
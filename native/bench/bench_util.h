@@ -0,0 +1,61 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Small helpers shared by the native benchmarks
+ */
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Keep the compiler from optimizing away a result that is otherwise unused.
+// The sink is atomic because bench_concurrent consumes on more than one
+// thread; a relaxed load and store costs no more than a volatile add.
+static inline void bench_consume(uint32_t value)
+{
+  static volatile atomic_uint sink;
+  atomic_store_explicit(&sink, atomic_load_explicit(&sink, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+// Get the iteration count from the first command line argument, if any
+static inline unsigned long bench_iterations(int argc, char** argv, unsigned long default_iterations)
+{
+  if (argc > 1)
+  {
+    unsigned long iterations = strtoul(argv[1], NULL, 0);
+    if (iterations > 0)
+      return iterations;
+  }
+  return default_iterations;
+}
@@ -0,0 +1,282 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "descriptor_corpus.h"
+
+// Appendix B of the USB Device Class Definition for MIDI Devices 1.0:
+// a MIDI adapter with one MIDI IN and one MIDI OUT DIN connector
+static const uint8_t spec_midi_adapter[] = {
+  // Configuration descriptor
+  0x09, 0x02, 0x65, 0x00, 0x02, 0x01, 0x00, 0x80, 0x32,
+  // Standard Audio Control interface descriptor
+  0x09, 0x04, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00,
+  // Class-specific Audio Control interface descriptor
+  0x09, 0x24, 0x01, 0x00, 0x01, 0x09, 0x00, 0x01, 0x01,
+  // Standard MIDI Streaming interface descriptor
+  0x09, 0x04, 0x01, 0x00, 0x02, 0x01, 0x03, 0x00, 0x00,
+  // Class-specific MIDI Streaming interface header
+  0x07, 0x24, 0x01, 0x00, 0x01, 0x41, 0x00,
+  // MIDI IN jacks: embedded and external
+  0x06, 0x24, 0x02, 0x01, 0x01, 0x00,
+  0x06, 0x24, 0x02, 0x02, 0x02, 0x00,
+  // MIDI OUT jacks: embedded and external
+  0x09, 0x24, 0x03, 0x01, 0x03, 0x01, 0x02, 0x01, 0x00,
+  0x09, 0x24, 0x03, 0x02, 0x04, 0x01, 0x01, 0x01, 0x00,
+  // Bulk OUT endpoint and its class-specific descriptor
+  0x09, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00,
+  0x05, 0x25, 0x01, 0x01, 0x01,
+  // Bulk IN endpoint and its class-specific descriptor
+  0x09, 0x05, 0x81, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00,
+  0x05, 0x25, 0x01, 0x01, 0x03,
+};
+
+// Describes how to build one of the synthesized corpus entries
+typedef struct
+{
+  const char* name;
+  uint8_t num_cables_rx;  // device to host cables
+  uint8_t num_cables_tx;  // host to device cables
+  bool audio_control;     // precede the MIDI Streaming interface with an Audio Control interface
+  bool audio_streaming;   // add terminals, a feature unit and an Audio Streaming interface
+  bool strings;           // give interfaces, jacks, elements and terminals string indices
+  uint8_t num_elements;   // number of Element descriptors
+  uint8_t num_endpoints;  // number of bulk endpoints in each direction that split the cables
+} corpus_spec_t;
+
+static const corpus_spec_t specs[] = {
+  {"keyboard 1x1, MIDI interface only", 1, 1, false, false, true, 0, 1},
+  {"pad controller 2x1",                2, 1, true,  false, true, 0, 1},
+  {"control surface 4x4",               4, 4, true,  false, true, 0, 1},
+  {"effects pedal audio+MIDI 1x1",      1, 1, true,  true,  true, 0, 1},
+  {"8 port interface 8x8",              8, 8, true,  false, true, 0, 1},
+  {"16 port interface 16x16 elements", 16, 16, true, false, true, 4, 1},
+  {"16 port interface 2x8 endpoints",  16, 16, true, false, true, 0, 2},
+};
+
+#define NUM_ENTRIES (1 + sizeof(specs)/sizeof(specs[0]))
+#define MAX_CONFIG_LEN 1024
+
+static uint8_t storage[NUM_ENTRIES - 1][MAX_CONFIG_LEN];
+static descriptor_corpus_entry_t entries[NUM_ENTRIES];
+static bool built = false;
+
+static uint8_t* put_interface(uint8_t* p, uint8_t num, uint8_t alt, uint8_t neps, uint8_t subclass, uint8_t str)
+{
+  const uint8_t desc[] = {0x09, 0x04, num, alt, neps, 0x01, subclass, 0x00, str};
+  for (size_t idx = 0; idx < sizeof(desc); idx++)
+    *p++ = desc[idx];
+  return p;
+}
+
+static uint8_t* put_in_jack(uint8_t* p, uint8_t type, uint8_t id, uint8_t str)
+{
+  *p++ = 0x06; *p++ = 0x24; *p++ = 0x02; *p++ = type; *p++ = id; *p++ = str;
+  return p;
+}
+
+static uint8_t* put_out_jack(uint8_t* p, uint8_t type, uint8_t id, uint8_t source_id, uint8_t str)
+{
+  *p++ = 0x09; *p++ = 0x24; *p++ = 0x03; *p++ = type; *p++ = id;
+  *p++ = 1; *p++ = source_id; *p++ = 1; // one input pin
+  *p++ = str;
+  return p;
+}
+
+static uint8_t* put_element(uint8_t* p, uint8_t id, uint8_t source_id, uint16_t caps, uint8_t str)
+{
+  *p++ = 0x0E; *p++ = 0x24; *p++ = 0x04; *p++ = id;
+  *p++ = 1; *p++ = source_id; *p++ = 1;  // one input pin
+  *p++ = 1; *p++ = 0; *p++ = 0;          // one output pin, no terminal links
+  *p++ = 2; *p++ = caps & 0xff; *p++ = caps >> 8;
+  *p++ = str;
+  return p;
+}
+
+static uint8_t* put_endpoint(uint8_t* p, uint8_t addr, uint8_t attributes, uint16_t max_packet)
+{
+  // Audio class endpoint descriptors are 9 bytes long
+  *p++ = 0x09; *p++ = 0x05; *p++ = addr; *p++ = attributes;
+  *p++ = max_packet & 0xff; *p++ = max_packet >> 8;
+  *p++ = attributes == 0x02 ? 0 : 1; *p++ = 0; *p++ = 0;
+  return p;
+}
+
+static uint8_t* put_cs_endpoint(uint8_t* p, uint8_t num_jacks, const uint8_t* jack_ids)
+{
+  *p++ = 4 + num_jacks; *p++ = 0x25; *p++ = 0x01; *p++ = num_jacks;
+  for (uint8_t jack = 0; jack < num_jacks; jack++)
+    *p++ = jack_ids[jack];
+  return p;
+}
+
+static uint16_t build(uint8_t* buf, const corpus_spec_t* spec, uint16_t* midi_offset)
+{
+  uint8_t* p = buf + 9; // fill in the configuration descriptor last
+  uint8_t str = 4;      // 1-3 are usually the manufacturer, product and serial strings
+  uint8_t itf = 0;
+  bool audio_control = spec->audio_control || spec->audio_streaming;
+  if (audio_control)
+  {
+    p = put_interface(p, itf++, 0, 0, 0x01, spec->strings ? str++ : 0);
+    uint8_t ncollection = spec->audio_streaming ? 2 : 1;
+    uint8_t* header = p;
+    *p++ = 8 + ncollection; *p++ = 0x24; *p++ = 0x01; *p++ = 0x00; *p++ = 0x01;
+    *p++ = 0; *p++ = 0; // wTotalLength filled in below
+    *p++ = ncollection;
+    for (uint8_t jdx = 0; jdx < ncollection; jdx++)
+      *p++ = itf + jdx;
+    if (spec->audio_streaming)
+    {
+      // USB streaming input terminal -> feature unit -> speaker output terminal
+      const uint8_t it[] = {0x0C, 0x24, 0x02, 0x01, 0x01, 0x01, 0x00, 0x02, 0x03, 0x00, 0x00, spec->strings ? str++ : 0};
+      const uint8_t fu[] = {0x0A, 0x24, 0x06, 0x02, 0x01, 0x01, 0x01, 0x00, 0x00, spec->strings ? str++ : 0};
+      const uint8_t ot[] = {0x09, 0x24, 0x03, 0x03, 0x01, 0x03, 0x00, 0x02, spec->strings ? str++ : 0};
+      for (size_t idx = 0; idx < sizeof(it); idx++)
+        *p++ = it[idx];
+      for (size_t idx = 0; idx < sizeof(fu); idx++)
+        *p++ = fu[idx];
+      for (size_t idx = 0; idx < sizeof(ot); idx++)
+        *p++ = ot[idx];
+    }
+    uint16_t ac_len = p - header;
+    header[5] = ac_len & 0xff;
+    header[6] = ac_len >> 8;
+    if (spec->audio_streaming)
+    {
+      const uint8_t as_general[] = {0x07, 0x24, 0x01, 0x01, 0x01, 0x01, 0x00};
+      const uint8_t format[] = {0x0B, 0x24, 0x02, 0x01, 0x02, 0x02, 0x10, 0x01, 0x44, 0xAC, 0x00};
+      const uint8_t cs_iso_ep[] = {0x07, 0x25, 0x01, 0x00, 0x00, 0x00, 0x00};
+      p = put_interface(p, itf, 0, 0, 0x02, 0);
+      p = put_interface(p, itf++, 1, 1, 0x02, 0);
+      for (size_t idx = 0; idx < sizeof(as_general); idx++)
+        *p++ = as_general[idx];
+      for (size_t idx = 0; idx < sizeof(format); idx++)
+        *p++ = format[idx];
+      p = put_endpoint(p, 0x02, 0x09, 0x00C0);
+      for (size_t idx = 0; idx < sizeof(cs_iso_ep); idx++)
+        *p++ = cs_iso_ep[idx];
+    }
+  }
+
+  // The MIDI Streaming interface
+  *midi_offset = p - buf;
+  uint8_t neps = (spec->num_cables_rx ? spec->num_endpoints : 0) + (spec->num_cables_tx ? spec->num_endpoints : 0);
+  p = put_interface(p, itf++, 0, neps, 0x03, spec->strings ? str++ : 0);
+  uint8_t* ms_header = p;
+  *p++ = 0x07; *p++ = 0x24; *p++ = 0x01; *p++ = 0x00; *p++ = 0x01; *p++ = 0; *p++ = 0;
+  uint8_t jack_id = 1;
+  uint8_t ep_out_jacks[16];
+  uint8_t ep_in_jacks[16];
+  for (uint8_t cable = 0; cable < spec->num_cables_tx; cable++)
+  {
+    // host -> embedded IN jack -> external OUT jack -> DIN OUT
+    uint8_t s = spec->strings ? str++ : 0;
+    ep_out_jacks[cable] = jack_id;
+    p = put_in_jack(p, 0x01, jack_id, s);
+    p = put_out_jack(p, 0x02, jack_id + 1, jack_id, s);
+    jack_id += 2;
+  }
+  for (uint8_t cable = 0; cable < spec->num_cables_rx; cable++)
+  {
+    // DIN IN -> external IN jack -> embedded OUT jack -> host
+    uint8_t s = spec->strings ? str++ : 0;
+    ep_in_jacks[cable] = jack_id + 1;
+    p = put_in_jack(p, 0x02, jack_id, s);
+    p = put_out_jack(p, 0x01, jack_id + 1, jack_id, s);
+    jack_id += 2;
+  }
+  for (uint8_t element = 0; element < spec->num_elements; element++)
+  {
+    // MIDI clock and MTC capable elements fed from the host cables
+    p = put_element(p, jack_id++, ep_out_jacks[element % spec->num_cables_tx], 0x0006, spec->strings ? str++ : 0);
+  }
+  uint8_t first_ep = spec->audio_streaming ? 0x03 : 0x01;
+  for (uint8_t ep = 0; ep < spec->num_endpoints; ep++)
+  {
+    // Split the cables evenly between the endpoints
+    uint8_t first_tx = spec->num_cables_tx * ep / spec->num_endpoints;
+    uint8_t first_rx = spec->num_cables_rx * ep / spec->num_endpoints;
+    uint8_t ntx = spec->num_cables_tx * (ep + 1) / spec->num_endpoints - first_tx;
+    uint8_t nrx = spec->num_cables_rx * (ep + 1) / spec->num_endpoints - first_rx;
+    if (ntx)
+    {
+      p = put_endpoint(p, first_ep + ep, 0x02, 64);
+      p = put_cs_endpoint(p, ntx, ep_out_jacks + first_tx);
+    }
+    if (nrx)
+    {
+      p = put_endpoint(p, 0x80 | (first_ep + ep), 0x02, 64);
+      p = put_cs_endpoint(p, nrx, ep_in_jacks + first_rx);
+    }
+  }
+  uint16_t ms_len = p - ms_header;
+  ms_header[5] = ms_len & 0xff;
+  ms_header[6] = ms_len >> 8;
+
+  uint16_t total = p - buf;
+  const uint8_t cfg[] = {0x09, 0x02, total & 0xff, total >> 8, itf, 0x01, 0x00, 0x80, 0x32};
+  for (size_t idx = 0; idx < sizeof(cfg); idx++)
+    buf[idx] = cfg[idx];
+  if (total > MAX_CONFIG_LEN)
+    abort();
+  return total;
+}
+
+static uint16_t count_descriptors(const uint8_t* config, uint16_t len)
+{
+  uint16_t count = 0;
+  for (uint16_t offset = 0; offset < len && config[offset] != 0; offset += config[offset])
+    ++count;
+  return count;
+}
+
+size_t descriptor_corpus_get(const descriptor_corpus_entry_t** result)
+{
+  if (!built)
+  {
+    entries[0].name = "USB MIDI 1.0 spec adapter 1x1";
+    entries[0].config = spec_midi_adapter;
+    entries[0].config_len = sizeof(spec_midi_adapter);
+    entries[0].midi_offset = 27;
+    entries[0].num_cables_rx = 1;
+    entries[0].num_cables_tx = 1;
+    for (size_t idx = 1; idx < NUM_ENTRIES; idx++)
+    {
+      const corpus_spec_t* spec = specs + idx - 1;
+      entries[idx].name = spec->name;
+      entries[idx].config = storage[idx - 1];
+      entries[idx].config_len = build(storage[idx - 1], spec, &entries[idx].midi_offset);
+      entries[idx].num_cables_rx = spec->num_cables_rx;
+      entries[idx].num_cables_tx = spec->num_cables_tx;
+    }
+    for (size_t idx = 0; idx < NUM_ENTRIES; idx++)
+      entries[idx].num_descriptors = count_descriptors(entries[idx].config, entries[idx].config_len);
+    built = true;
+  }
+  *result = entries;
+  return NUM_ENTRIES;
+}
@@ -0,0 +1,56 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * A corpus of USB MIDI configuration descriptors for exercising the
+ * library on a Linux host. The corpus starts with the example MIDI adapter
+ * from Appendix B of the USB MIDI 1.0 specification and adds descriptors
+ * laid out the way common class compliant devices lay them out, from a
+ * single cable keyboard up to a 16 cable interface with Element descriptors
+ * and a composite audio + MIDI effects pedal.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+  const char* name;
+  const uint8_t* config;  // the full configuration descriptor
+  uint16_t config_len;    // wTotalLength of the configuration descriptor
+  uint16_t midi_offset;   // offset of the MIDI Streaming interface descriptor
+  uint16_t num_descriptors; // number of descriptors in the configuration descriptor
+  uint8_t num_cables_rx;  // number of cables on the IN endpoint
+  uint8_t num_cables_tx;  // number of cables on the OUT endpoint
+} descriptor_corpus_entry_t;
+
+/**
+ * @brief Get the descriptor corpus
+ *
+ * @param entries set to point to the array of corpus entries
+ * @return size_t the number of entries in the corpus
+ */
+size_t descriptor_corpus_get(const descriptor_corpus_entry_t** entries);
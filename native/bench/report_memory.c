@@ -0,0 +1,62 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Report the RAM the library uses for each device in the corpus, and what
+ * the configured MAX_* limits made the parse drop. The build runs this after
+ * linking it so the numbers track the configured limits.
+ * Usage: report_memory
+ */
+#include <stdio.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+
+int main(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+
+  printf("usb_midi_descriptor_lib RAM: %u byte arena shared by %u device slots, %u fixed bytes per slot\n",
+    USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE, CFG_TUH_MIDI, usb_midi_descriptor_lib_get_bytes_used(0));
+  printf("%-36s %6s %6s %6s %8s %8s\n", "descriptor", "cables", "arena", "total",
+    "-cables", "-strings");
+  for (size_t idx = 0; idx < nentries; idx++)
+  {
+    const descriptor_corpus_entry_t* entry = entries + idx;
+    uint16_t arena_free = usb_midi_descriptor_lib_get_arena_bytes_free();
+    if (!usb_midi_descriptor_lib_configure_from_full(0, entry->config))
+    {
+      printf("%s: parse failed\n", entry->name);
+      return 1;
+    }
+    usb_midi_descriptor_lib_stats_t stats;
+    usb_midi_descriptor_lib_get_stats(0, &stats);
+    printf("%-36s %6u %6u %6u %8u %8u\n", entry->name, entry->num_cables_rx + entry->num_cables_tx,
+      arena_free - usb_midi_descriptor_lib_get_arena_bytes_free(), usb_midi_descriptor_lib_get_bytes_used(0),
+      stats.cables_dropped, stats.strings_dropped);
+    usb_midi_descriptor_lib_init(0);
+  }
+  return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check that the Audio Control terminals, units and clock entities before a
+ * MIDI Streaming interface are kept with the right IDs, terminal types,
+ * string indices and protocol: for the corpus effects pedal, for a UAC1
+ * interface whose Processing Unit has process specific bytes after its
+ * string index, and for a UAC2 interface, whose subtypes and string
+ * positions differ from UAC1's.
+ */
+#include <string.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+// The MIDI Streaming interface that follows each Audio Control interface below
+#define MIDI_STREAMING \
+  0x09, 0x04, 0x01, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00, \
+  0x07, 0x24, 0x01, 0x00, 0x01, 0x24, 0x00, \
+  0x06, 0x24, 0x02, 0x01, 0x01, 0x00, \
+  0x09, 0x24, 0x03, 0x02, 0x02, 0x01, 0x01, 0x01, 0x00, \
+  0x09, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, \
+  0x05, 0x25, 0x01, 0x01, 0x01
+
+// Input Terminal 1 -> Processing Unit 4 -> Extension Unit 5 -> Selector Unit 6
+static const uint8_t uac1_units[] = {
+  0x09, 0x02, 0x00, 0x00, 0x02, 0x01, 0x00, 0x80, 0x32,
+  0x09, 0x04, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00,
+  0x09, 0x24, 0x01, 0x00, 0x01, 0x3C, 0x00, 0x01, 0x01,
+  0x0C, 0x24, 0x02, 0x01, 0x01, 0x01, 0x00, 0x02, 0x03, 0x00, 0x00, 0x08,
+  // up/down-mix, one pin, one control byte, iProcessing 9, then two process specific bytes
+  0x11, 0x24, 0x07, 0x04, 0x01, 0x00, 0x01, 0x01, 0x02, 0x03, 0x00, 0x00, 0x01, 0x01, 0x09, 0x01, 0x02,
+  0x0F, 0x24, 0x08, 0x05, 0x00, 0x10, 0x01, 0x04, 0x02, 0x03, 0x00, 0x00, 0x01, 0x01, 0x0A,
+  0x07, 0x24, 0x05, 0x06, 0x01, 0x05, 0x0B,
+  MIDI_STREAMING
+};
+
+// Clock Source 1 -> Input Terminal 2 -> Processing Unit 4 -> Output Terminal 3
+static const uint8_t uac2_entities[] = {
+  0x09, 0x02, 0x00, 0x00, 0x02, 0x01, 0x00, 0x80, 0x32,
+  0x09, 0x04, 0x00, 0x00, 0x00, 0x01, 0x01, 0x20, 0x00,
+  0x09, 0x24, 0x01, 0x00, 0x02, 0x08, 0x41, 0x00, 0x00,
+  0x08, 0x24, 0x0A, 0x01, 0x01, 0x01, 0x00, 0x0C,
+  0x11, 0x24, 0x02, 0x02, 0x01, 0x01, 0x00, 0x01, 0x02, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D,
+  // up/down-mix, one pin, iProcessing 14, then two process specific bytes
+  0x13, 0x24, 0x08, 0x04, 0x01, 0x00, 0x01, 0x02, 0x02, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x01, 0x02,
+  0x0C, 0x24, 0x03, 0x03, 0x01, 0x03, 0x00, 0x04, 0x01, 0x00, 0x00, 0x0F,
+  MIDI_STREAMING
+};
+
+static bool has_str_idx(uint8_t str_idx)
+{
+  const uint8_t* indices;
+  int num_indices = usb_midi_descriptor_lib_get_all_str_inidices(0, &indices);
+  for (int idx = 0; idx < num_indices; idx++) {
+    if (indices[idx] == str_idx)
+      return true;
+  }
+  return false;
+}
+
+// Configure slot 0 from a copy of config with its wTotalLength filled in
+static bool configure(const uint8_t* config, uint16_t len)
+{
+  static uint8_t copy[256];
+  memcpy(copy, config, len);
+  copy[2] = len & 0xFF;
+  copy[3] = len >> 8;
+  return usb_midi_descriptor_lib_configure_from_full(0, copy);
+}
+
+// Check that entity entity_num is the expected one and that its ID finds it
+static void check_entity(uint8_t entity_num, uint8_t id, uint8_t subtype, uint16_t terminal_type, uint8_t str_idx,
+                         uint8_t protocol)
+{
+  usb_midi_descriptor_lib_audio_entity_t entity, found;
+  memset(&entity, 0, sizeof(entity));
+  TEST_CHECK(usb_midi_descriptor_lib_get_audio_entity(0, entity_num, &entity));
+  TEST_CHECK(entity.id == id && entity.subtype == subtype && entity.terminal_type == terminal_type);
+  TEST_CHECK(entity.str_idx == str_idx && entity.protocol == protocol && has_str_idx(str_idx));
+  TEST_CHECK(usb_midi_descriptor_lib_find_audio_entity(0, id, &found) && memcmp(&found, &entity, sizeof(found)) == 0);
+}
+
+static void test_uac1_units(void)
+{
+  TEST_CHECK(configure(uac1_units, sizeof(uac1_units)));
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_audio_entities(0) == 4);
+  check_entity(0, 1, AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL, 0x0101, 8, 0);
+  check_entity(1, 4, 0x07, 0, 9, 0);
+  check_entity(2, 5, 0x08, 0, 10, 0);
+  check_entity(3, 6, AUDIO_CS_AC_INTERFACE_SELECTOR_UNIT, 0, 11, 0);
+  TEST_CHECK(!has_str_idx(2)); // the Processing Unit's last process specific byte
+  usb_midi_descriptor_lib_audio_entity_t entity;
+  TEST_CHECK(!usb_midi_descriptor_lib_get_audio_entity(0, 4, &entity));
+  TEST_CHECK(!usb_midi_descriptor_lib_find_audio_entity(0, 2, &entity));
+  TEST_CHECK(!usb_midi_descriptor_lib_find_audio_entity(0, 7, &entity));
+}
+
+static void test_uac2_entities(void)
+{
+  TEST_CHECK(configure(uac2_entities, sizeof(uac2_entities)));
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_audio_entities(0) == 4);
+  check_entity(0, 1, AUDIO_CS_AC_INTERFACE_CLOCK_SOURCE, 0, 12, AUDIO_INT_PROTOCOL_CODE_V2);
+  check_entity(1, 2, AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL, 0x0101, 13, AUDIO_INT_PROTOCOL_CODE_V2);
+  check_entity(2, 4, AUDIO_CS_AC_INTERFACE_PROCESSING_UNIT, 0, 14, AUDIO_INT_PROTOCOL_CODE_V2);
+  check_entity(3, 3, AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL, 0x0301, 15, AUDIO_INT_PROTOCOL_CODE_V2);
+  TEST_CHECK(!has_str_idx(2));
+
+  usb_midi_descriptor_lib_init(0);
+  usb_midi_descriptor_lib_audio_entity_t entity;
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_audio_entities(0) == 0);
+  TEST_CHECK(!usb_midi_descriptor_lib_get_audio_entity(0, 0, &entity));
+  TEST_CHECK(!usb_midi_descriptor_lib_find_audio_entity(0, 1, &entity));
+}
+
+// The corpus effects pedal's streaming input terminal, feature unit and
+// speaker output terminal get the string indices after the Audio Control
+// interface's
+static void test_corpus_entities(const descriptor_corpus_entry_t* entry)
+{
+  TEST_CHECK(usb_midi_descriptor_lib_configure_from_full(0, entry->config));
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_audio_entities(0) == 3);
+  check_entity(0, 1, AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL, 0x0101, 5, 0);
+  check_entity(1, 2, AUDIO_CS_AC_INTERFACE_FEATURE_UNIT, 0, 6, 0);
+  check_entity(2, 3, AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL, 0x0301, 7, 0);
+
+  // Only the MIDI Streaming interface
+  TEST_CHECK(usb_midi_descriptor_lib_configure(0, entry->config + entry->midi_offset,
+                                               entry->config_len - entry->midi_offset));
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_audio_entities(0) == 0);
+}
+
+int main(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++) {
+    if (strstr(entries[idx].name, "audio")) {
+      test_corpus_entities(entries + idx);
+    } else {
+      TEST_CHECK(usb_midi_descriptor_lib_configure_from_full(0, entries[idx].config));
+      TEST_CHECK(usb_midi_descriptor_lib_get_num_audio_entities(0) == 0);
+    }
+  }
+  test_uac1_units();
+  test_uac2_entities();
+  return test_result("test_audio_entities");
+}
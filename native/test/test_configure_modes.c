@@ -0,0 +1,166 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check that every way of configuring a device gives the same answers for
+ * every corpus device: view mode against a copy of the MIDI Streaming
+ * interface, and the streaming parser fed in pieces of every size against
+ * usb_midi_descriptor_lib_dev_configure_from_full(). While the parser is
+ * part way through, the getters must return nothing from the device.
+ */
+#include <string.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+#define MAX_SAVED 2048
+
+static usb_midi_descriptor_lib_arena_t arena;
+static uint8_t arena_bytes[4096];
+
+// Check that the getters the two devices have in common agree
+static void check_same_cables(const usb_midi_descriptor_info_t* expected, const usb_midi_descriptor_info_t* got)
+{
+  usb_midi_descriptor_lib_device_summary_t expected_summary, got_summary;
+  memset(&expected_summary, 0, sizeof(expected_summary));
+  memset(&got_summary, 0, sizeof(got_summary));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_device_summary(expected, &expected_summary));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_device_summary(got, &got_summary));
+  TEST_CHECK(memcmp(&expected_summary, &got_summary, sizeof(got_summary)) == 0);
+
+  uint8_t expected_indices[MAX_STRING_INDICES], got_indices[MAX_STRING_INDICES];
+  int num_indices = usb_midi_descriptor_lib_dev_copy_all_str_indices(expected, expected_indices, MAX_STRING_INDICES);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_copy_all_str_indices(got, got_indices, MAX_STRING_INDICES) == num_indices);
+  TEST_CHECK(num_indices >= 0 && memcmp(expected_indices, got_indices, (size_t)num_indices) == 0);
+  for (uint8_t ep_num = 0; ep_num < expected_summary.num_in_eps; ep_num++) {
+    for (uint8_t cable = 0; cable <= expected_summary.in_ep_num_cables[ep_num]; cable++) {
+      TEST_CHECK(usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(expected, ep_num, cable) ==
+                 usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(got, ep_num, cable));
+    }
+  }
+  for (uint8_t ep_num = 0; ep_num < expected_summary.num_out_eps; ep_num++) {
+    for (uint8_t cable = 0; cable <= expected_summary.out_ep_num_cables[ep_num]; cable++) {
+      TEST_CHECK(usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(expected, ep_num, cable) ==
+                 usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(got, ep_num, cable));
+    }
+  }
+}
+
+static void test_view(const descriptor_corpus_entry_t* entry)
+{
+  static usb_midi_descriptor_info_t copy, view;
+  const uint8_t* midi = entry->config + entry->midi_offset;
+  uint32_t midi_len = entry->config_len - entry->midi_offset;
+  usb_midi_descriptor_lib_dev_set_arena(&copy, &arena);
+  usb_midi_descriptor_lib_dev_set_arena(&view, NULL);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_configure(&copy, midi, midi_len));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_configure_view(&view, midi, midi_len));
+  check_same_cables(&copy, &view);
+  // a view keeps nothing but where the descriptors are
+  const uint8_t* indices;
+  uint8_t ext_jack_id, str_idx;
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_all_str_indices(&view, &indices) == -1);
+  TEST_CHECK(!usb_midi_descriptor_lib_dev_get_in_endpoint_cable_route(&view, 0, 0, &ext_jack_id, &str_idx));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_num_elements(&view) == 0);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_bytes_used(&view) == sizeof(view));
+  usb_midi_descriptor_lib_dev_init(&copy);
+  usb_midi_descriptor_lib_dev_init(&view);
+}
+
+// The getters of a device that is not configured
+static void check_nothing(const usb_midi_descriptor_info_t* dev)
+{
+  uint8_t ep_addr, num_cables, indices[MAX_STRING_INDICES];
+  usb_midi_descriptor_lib_device_summary_t summary;
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_num_in_endpoints(dev) == 0);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_num_out_endpoints(dev) == 0);
+  TEST_CHECK(!usb_midi_descriptor_lib_dev_get_in_endpoint(dev, 0, &ep_addr, &num_cables));
+  TEST_CHECK(!usb_midi_descriptor_lib_dev_get_out_endpoint(dev, 0, &ep_addr, &num_cables));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(dev, 0, 0) == 0);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_copy_all_str_indices(dev, indices, MAX_STRING_INDICES) == -1);
+  TEST_CHECK(!usb_midi_descriptor_lib_dev_get_device_summary(dev, &summary));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_num_elements(dev) == 0);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_bytes_used(dev) == sizeof(*dev));
+}
+
+// Feed the configuration descriptor, and a few bytes past wTotalLength, to the parser piece bytes at a time
+static void test_streaming(const descriptor_corpus_entry_t* entry, const uint8_t* expected_saved, uint16_t saved_len,
+                           const usb_midi_descriptor_info_t* expected)
+{
+  static usb_midi_descriptor_info_t streamed;
+  static uint8_t config[1024 + 16];
+  static uint8_t saved[MAX_SAVED];
+  memcpy(config, entry->config, entry->config_len);
+  memset(config + entry->config_len, 0xA5, 16);
+  uint32_t len = entry->config_len + 16;
+  for (uint32_t piece = 1; piece <= len; piece = piece < 8 ? piece + 1 : piece * 2) {
+    usb_midi_descriptor_parser_t parser;
+    usb_midi_descriptor_lib_dev_set_arena(&streamed, &arena);
+    usb_midi_descriptor_parser_init_dev(&parser, &streamed);
+    for (uint32_t offset = 0; offset < len; offset += piece) {
+      // the bytes after the ones that complete the parse must not change anything
+      bool done = usb_midi_descriptor_parser_complete(&parser);
+      if (!done)
+        check_nothing(&streamed);
+      TEST_CHECK(usb_midi_descriptor_parser_feed(&parser, config + offset, offset + piece <= len ? piece : len - offset));
+    }
+    TEST_CHECK(usb_midi_descriptor_parser_complete(&parser));
+    check_same_cables(expected, &streamed);
+    TEST_CHECK(usb_midi_descriptor_lib_dev_save(&streamed, saved, MAX_SAVED) == saved_len);
+    TEST_CHECK(memcmp(saved, expected_saved, saved_len) == 0);
+    usb_midi_descriptor_lib_dev_init(&streamed);
+  }
+}
+
+static void test_full(const descriptor_corpus_entry_t* entry)
+{
+  static usb_midi_descriptor_info_t full;
+  static uint8_t saved[MAX_SAVED];
+  usb_midi_descriptor_lib_dev_set_arena(&full, &arena);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_configure_from_full(&full, entry->config));
+  uint16_t saved_len = usb_midi_descriptor_lib_dev_save(&full, saved, MAX_SAVED);
+  TEST_CHECK(saved_len > 0);
+  test_streaming(entry, saved, saved_len, &full);
+  // reconfiguring a configured device: the getters return nothing until the new parse is done
+  usb_midi_descriptor_parser_t parser;
+  usb_midi_descriptor_parser_init_dev(&parser, &full);
+  check_nothing(&full);
+  TEST_CHECK(usb_midi_descriptor_parser_feed(&parser, entry->config, entry->config_len / 2));
+  check_nothing(&full);
+  usb_midi_descriptor_lib_dev_init(&full);
+}
+
+int main(void)
+{
+  usb_midi_descriptor_lib_arena_init(&arena, arena_bytes, sizeof(arena_bytes));
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++) {
+    test_view(entries + idx);
+    test_full(entries + idx);
+  }
+  TEST_CHECK(usb_midi_descriptor_lib_arena_bytes_free(&arena) == sizeof(arena_bytes));
+  return test_result("test_configure_modes");
+}
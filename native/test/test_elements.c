@@ -0,0 +1,140 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check that every MIDI Element is kept in descriptor order, found by ID
+ * and has the right pins, terminal links, capabilities and sources: for
+ * the corpus device with Elements and for a MIDI Streaming interface whose
+ * Elements have gaps between their IDs, more than 8 capability bits, and
+ * one Element fed by another.
+ */
+#include <string.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+// Embedded IN jacks 1 and 2 -> Element 40 -> Element 20 -> external OUT jack 5
+static const uint8_t two_elements[] = {
+  0x09, 0x04, 0x00, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00,
+  0x07, 0x24, 0x01, 0x00, 0x01, 0x38, 0x00,
+  0x06, 0x24, 0x02, 0x01, 0x01, 0x00,
+  0x06, 0x24, 0x02, 0x01, 0x02, 0x00,
+  // two input pins, terminal links 3 and 4, MIDI clock, MTC, patch bay and bit 16, iElement 9
+  0x11, 0x24, 0x04, 0x28, 0x02, 0x01, 0x01, 0x02, 0x01, 0x01, 0x03, 0x04, 0x03, 0x06, 0x02, 0x01, 0x09,
+  // fed by Element 40, two output pins, custom capabilities, no string
+  0x0D, 0x24, 0x04, 0x14, 0x01, 0x28, 0x01, 0x02, 0x00, 0x00, 0x01, 0x01, 0x00,
+  0x09, 0x24, 0x03, 0x02, 0x05, 0x01, 0x14, 0x01, 0x00,
+  0x09, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00,
+  0x06, 0x25, 0x01, 0x02, 0x01, 0x02,
+};
+
+static bool has_str_idx(uint8_t str_idx)
+{
+  const uint8_t* indices;
+  int num_indices = usb_midi_descriptor_lib_get_all_str_inidices(0, &indices);
+  for (int idx = 0; idx < num_indices; idx++) {
+    if (indices[idx] == str_idx)
+      return true;
+  }
+  return false;
+}
+
+static void test_two_elements(void)
+{
+  TEST_CHECK(usb_midi_descriptor_lib_configure(0, two_elements, sizeof(two_elements)));
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_elements(0) == 2);
+  usb_midi_descriptor_lib_element_t element;
+  TEST_CHECK(usb_midi_descriptor_lib_get_element(0, 0, &element) && element.id == 40);
+  TEST_CHECK(usb_midi_descriptor_lib_get_element(0, 1, &element) && element.id == 20);
+  TEST_CHECK(!usb_midi_descriptor_lib_get_element(0, 2, &element));
+
+  memset(&element, 0, sizeof(element));
+  TEST_CHECK(usb_midi_descriptor_lib_find_element(0, 40, &element));
+  TEST_CHECK(element.id == 40 && element.num_in_pins == 2 && element.num_out_pins == 1);
+  TEST_CHECK(element.in_terminal_link == 3 && element.out_terminal_link == 4 && element.str_idx == 9);
+  TEST_CHECK(element.caps == (USB_MIDI_ELEMENT_CAPS_MIDI_CLOCK | USB_MIDI_ELEMENT_CAPS_MTC |
+                              USB_MIDI_ELEMENT_CAPS_MIDI_PATCH_BAY | (1u << 16)));
+  TEST_CHECK(usb_midi_descriptor_lib_find_element(0, 20, &element));
+  TEST_CHECK(element.id == 20 && element.num_in_pins == 1 && element.num_out_pins == 2);
+  TEST_CHECK(element.in_terminal_link == 0 && element.out_terminal_link == 0 && element.str_idx == 0);
+  TEST_CHECK(element.caps == USB_MIDI_ELEMENT_CAPS_CUSTOM);
+  // IDs in the gap and on either side of the elements
+  TEST_CHECK(!usb_midi_descriptor_lib_find_element(0, 19, &element));
+  TEST_CHECK(!usb_midi_descriptor_lib_find_element(0, 30, &element));
+  TEST_CHECK(!usb_midi_descriptor_lib_find_element(0, 41, &element));
+  TEST_CHECK(!usb_midi_descriptor_lib_find_element(0, 0, &element));
+
+  uint8_t source_id = 0, source_pin = 0;
+  TEST_CHECK(usb_midi_descriptor_lib_get_element_source(0, 40, 0, &source_id, &source_pin));
+  TEST_CHECK(source_id == 1 && source_pin == 1);
+  TEST_CHECK(usb_midi_descriptor_lib_get_element_source(0, 40, 1, &source_id, &source_pin));
+  TEST_CHECK(source_id == 2 && source_pin == 1);
+  TEST_CHECK(!usb_midi_descriptor_lib_get_element_source(0, 40, 2, &source_id, &source_pin));
+  TEST_CHECK(usb_midi_descriptor_lib_get_element_source(0, 20, 0, &source_id, &source_pin));
+  TEST_CHECK(source_id == 40 && source_pin == 1);
+  TEST_CHECK(!usb_midi_descriptor_lib_get_element_source(0, 30, 0, &source_id, &source_pin));
+  TEST_CHECK(has_str_idx(9));
+
+  usb_midi_descriptor_lib_init(0);
+  TEST_CHECK(usb_midi_descriptor_lib_get_num_elements(0) == 0);
+  TEST_CHECK(!usb_midi_descriptor_lib_find_element(0, 40, &element));
+}
+
+// The corpus device with Elements numbers them after its 64 jacks, feeds
+// each from a host to device cable's embedded IN jack and gives them the
+// string indices after the 32 cables'
+static void test_corpus_elements(const descriptor_corpus_entry_t* entry)
+{
+  TEST_CHECK(usb_midi_descriptor_lib_configure_from_full(0, entry->config));
+  uint8_t num_elements = usb_midi_descriptor_lib_get_num_elements(0);
+  TEST_CHECK(num_elements == 4);
+  for (uint8_t elem_num = 0; elem_num < num_elements; elem_num++) {
+    usb_midi_descriptor_lib_element_t element, found;
+    TEST_CHECK(usb_midi_descriptor_lib_get_element(0, elem_num, &element));
+    TEST_CHECK(element.id == 65 + elem_num && element.num_in_pins == 1 && element.num_out_pins == 1);
+    TEST_CHECK(element.caps == (USB_MIDI_ELEMENT_CAPS_MIDI_CLOCK | USB_MIDI_ELEMENT_CAPS_MTC));
+    TEST_CHECK(element.str_idx == 38 + elem_num && has_str_idx(element.str_idx));
+    TEST_CHECK(usb_midi_descriptor_lib_find_element(0, element.id, &found) && memcmp(&found, &element, sizeof(found)) == 0);
+    uint8_t source_id = 0, source_pin = 0;
+    TEST_CHECK(usb_midi_descriptor_lib_get_element_source(0, element.id, 0, &source_id, &source_pin));
+    TEST_CHECK(source_id == 1 + 2 * elem_num && source_pin == 1);
+  }
+}
+
+int main(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++) {
+    if (strstr(entries[idx].name, "elements")) {
+      test_corpus_elements(entries + idx);
+    } else {
+      TEST_CHECK(usb_midi_descriptor_lib_configure_from_full(0, entries[idx].config));
+      TEST_CHECK(usb_midi_descriptor_lib_get_num_elements(0) == 0);
+    }
+  }
+  test_two_elements();
+  return test_result("test_elements");
+}
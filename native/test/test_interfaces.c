@@ -0,0 +1,182 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check that usb_midi_descriptor_lib_find_midi_interfaces() lists every
+ * MIDI Streaming interface of a configuration descriptor and that
+ * usb_midi_descriptor_lib_configure_interface() configures a slot from
+ * each one exactly as usb_midi_descriptor_lib_configure_from_full()
+ * configures it from a device that has only that interface: for every
+ * corpus device, and for a composite device made of two corpus devices
+ * where the second function has an IAD and an alternate setting.
+ */
+#include <string.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+#define MAX_CONFIG_LEN 2048
+#define MAX_ITFS 4
+
+// What the getters of a slot return
+typedef struct
+{
+  int num_indices;
+  uint8_t indices[MAX_STRING_INDICES];
+  uint8_t num_eps[2];
+  uint8_t ep_addrs[2][2];
+  uint8_t ep_num_cables[2][2];
+  int cable_str_idx[2][2][16];
+  uint8_t routes[2][2][16][3];
+} slot_state_t;
+
+static void get_slot_state(uint8_t idx, slot_state_t* state)
+{
+  memset(state, 0, sizeof(*state));
+  const uint8_t* indices;
+  state->num_indices = usb_midi_descriptor_lib_get_all_str_inidices(idx, &indices);
+  for (int pos = 0; pos < state->num_indices; pos++)
+    state->indices[pos] = indices[pos];
+  for (int dir = 0; dir < 2; dir++) {
+    bool in = dir == 0;
+    state->num_eps[dir] = in ? usb_midi_descriptor_lib_get_num_in_endpoints(idx) :
+                               usb_midi_descriptor_lib_get_num_out_endpoints(idx);
+    for (uint8_t ep_num = 0; ep_num < state->num_eps[dir] && ep_num < 2; ep_num++) {
+      uint8_t* ep_addr = &state->ep_addrs[dir][ep_num];
+      uint8_t* num_cables = &state->ep_num_cables[dir][ep_num];
+      TEST_CHECK(in ? usb_midi_descriptor_lib_get_in_endpoint(idx, ep_num, ep_addr, num_cables) :
+                      usb_midi_descriptor_lib_get_out_endpoint(idx, ep_num, ep_addr, num_cables));
+      for (uint8_t cable = 0; cable < *num_cables && cable < 16; cable++) {
+        uint8_t* route = state->routes[dir][ep_num][cable];
+        if (in) {
+          state->cable_str_idx[dir][ep_num][cable] = usb_midi_descriptor_lib_get_str_idx_for_in_endpoint_cable(idx, ep_num, cable);
+          route[0] = usb_midi_descriptor_lib_get_in_endpoint_cable_route(idx, ep_num, cable, route + 1, route + 2);
+        } else {
+          state->cable_str_idx[dir][ep_num][cable] = usb_midi_descriptor_lib_get_str_idx_for_out_endpoint_cable(idx, ep_num, cable);
+          route[0] = usb_midi_descriptor_lib_get_out_endpoint_cable_route(idx, ep_num, cable, route + 1, route + 2);
+        }
+      }
+    }
+  }
+}
+
+// Configure a slot from the device whole, then from interface itf of config, and check they agree.
+// One slot at a time, since the 16 cable devices do not fit in the index API's arena twice.
+static void check_interface(const uint8_t* config, const uint8_t* whole, const usb_midi_descriptor_lib_interface_t* itf)
+{
+  static slot_state_t expected, got;
+  TEST_CHECK(usb_midi_descriptor_lib_configure_from_full(0, whole));
+  get_slot_state(0, &expected);
+  TEST_CHECK(usb_midi_descriptor_lib_configure_interface(0, config, itf));
+  get_slot_state(0, &got);
+  TEST_CHECK(expected.num_indices >= 0 && expected.num_eps[0] + expected.num_eps[1] > 0);
+  TEST_CHECK(memcmp(&expected, &got, sizeof(got)) == 0);
+}
+
+static void test_corpus_entry(const descriptor_corpus_entry_t* entry)
+{
+  usb_midi_descriptor_lib_interface_t itfs[MAX_ITFS];
+  TEST_CHECK(usb_midi_descriptor_lib_find_midi_interfaces(entry->config, itfs, MAX_ITFS) == 1);
+  TEST_CHECK(itfs[0].offset == entry->midi_offset && itfs[0].len == entry->config_len - entry->midi_offset);
+  TEST_CHECK(itfs[0].alt == 0);
+  // The corpus devices with an Audio Control interface start with it
+  TEST_CHECK(itfs[0].control_len == 0 || itfs[0].control_offset == 9);
+  check_interface(entry->config, entry->config, itfs);
+}
+
+// A composite device: the Audio Control and MIDI Streaming interfaces of
+// first, then an IAD and two alternate settings of the MIDI Streaming
+// interface of second, which has no Audio Control interface
+static uint16_t build_composite(uint8_t* config, const descriptor_corpus_entry_t* first,
+                                const descriptor_corpus_entry_t* second)
+{
+  uint16_t len = first->config_len;
+  memcpy(config, first->config, len);
+  uint8_t itf_num = config[4];
+  const uint8_t iad[] = {0x08, 0x0B, itf_num, 0x01, 0x01, 0x03, 0x00, 0x00};
+  memcpy(config + len, iad, sizeof(iad));
+  len += sizeof(iad);
+  uint16_t midi_len = second->config_len - second->midi_offset;
+  for (uint8_t alt = 0; alt < 2; alt++) {
+    memcpy(config + len, second->config + second->midi_offset, midi_len);
+    config[len + 2] = itf_num;
+    config[len + 3] = alt;
+    len += midi_len;
+  }
+  config[2] = len & 0xFF;
+  config[3] = len >> 8;
+  config[4] = itf_num + 1;
+  return len;
+}
+
+static void test_composite(const descriptor_corpus_entry_t* first, const descriptor_corpus_entry_t* second)
+{
+  static uint8_t config[MAX_CONFIG_LEN];
+  uint16_t len = build_composite(config, first, second);
+  usb_midi_descriptor_lib_interface_t itfs[MAX_ITFS];
+  memset(itfs, 0, sizeof(itfs));
+  TEST_CHECK(usb_midi_descriptor_lib_find_midi_interfaces(config, itfs, MAX_ITFS) == 3);
+  TEST_CHECK(itfs[0].itf_num == first->config[4] - 1 && itfs[0].alt == 0);
+  TEST_CHECK(itfs[0].offset == first->midi_offset && itfs[0].len == first->config_len - first->midi_offset);
+  TEST_CHECK(itfs[0].control_offset == 9 && itfs[0].control_len == first->midi_offset - 9);
+  TEST_CHECK(itfs[0].control_str_idx == first->config[9 + 8]);
+  uint16_t midi_len = second->config_len - second->midi_offset;
+  for (uint8_t alt = 0; alt < 2; alt++) {
+    const usb_midi_descriptor_lib_interface_t* itf = itfs + 1 + alt;
+    TEST_CHECK(itf->itf_num == first->config[4] && itf->alt == alt);
+    TEST_CHECK(itf->offset == first->config_len + 8 + alt * midi_len && itf->len == midi_len);
+    // the IAD starts a new function, so the first function's Audio Control interface is not this one's
+    TEST_CHECK(itf->control_str_idx == 0 && itf->control_offset == 0 && itf->control_len == 0);
+  }
+  TEST_CHECK(itfs[2].offset + itfs[2].len == len);
+
+  check_interface(config, first->config, itfs);
+  check_interface(config, second->config, itfs + 1);
+  check_interface(config, second->config, itfs + 2);
+
+  // a list with room for one interface gets the first one
+  usb_midi_descriptor_lib_interface_t one;
+  TEST_CHECK(usb_midi_descriptor_lib_find_midi_interfaces(config, &one, 1) == 1);
+  TEST_CHECK(memcmp(&one, itfs, sizeof(one)) == 0);
+  // cutting the last descriptor short drops the interface it is in, and only that one
+  config[2] = (len - 1) & 0xFF;
+  config[3] = (len - 1) >> 8;
+  TEST_CHECK(usb_midi_descriptor_lib_find_midi_interfaces(config, itfs + 3, 1) == 1);
+  TEST_CHECK(usb_midi_descriptor_lib_find_midi_interfaces(config, itfs, MAX_ITFS) == 2);
+  TEST_CHECK(memcmp(&one, itfs, sizeof(one)) == 0);
+  // anything but a configuration descriptor has none
+  TEST_CHECK(usb_midi_descriptor_lib_find_midi_interfaces(config + 9, itfs, MAX_ITFS) == 0);
+}
+
+int main(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++)
+    test_corpus_entry(entries + idx);
+  // the pad controller has an Audio Control interface, the keyboard does not
+  test_composite(entries + 2, entries + 1);
+  return test_result("test_interfaces");
+}
@@ -0,0 +1,162 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check the descriptor iterator on well formed, truncated and malformed
+ * buffers: it must stop at every bLength that is less than 2 or runs past
+ * the end, take at most len / 2 steps and never return a descriptor that
+ * does not fit. Then check that every configure function fails on every
+ * truncation and bad bLength of every corpus device, reading only the bytes
+ * it was given, which each copy is cut down to.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+#define MAX_CONFIG_LEN 1024
+
+static usb_midi_descriptor_lib_arena_t arena;
+static uint8_t arena_bytes[4096];
+static usb_midi_descriptor_info_t dev;
+
+// Walk len bytes of buf; return the number of steps and set *malformed
+static uint32_t walk(const uint8_t* buf, uint32_t len, bool* malformed)
+{
+  usb_midi_descriptor_lib_iter_t iter;
+  usb_midi_descriptor_lib_iter_init(&iter, buf, len);
+  uint32_t steps = 0;
+  uint32_t offset = 0;
+  while (usb_midi_descriptor_lib_iter_next(&iter)) {
+    ++steps;
+    TEST_CHECK(iter.desc == buf + offset && iter.offset == offset && iter.remaining == len - offset);
+    TEST_CHECK(iter.len >= 2 && iter.len <= iter.remaining && iter.len == buf[offset]);
+    TEST_CHECK(iter.type == buf[offset + 1] && iter.subtype == (iter.len >= 3 ? buf[offset + 2] : 0));
+    offset += iter.len;
+  }
+  TEST_CHECK(steps <= len / 2);
+  // every later call returns false as well
+  bool was_malformed = iter.malformed;
+  TEST_CHECK(!usb_midi_descriptor_lib_iter_next(&iter) && iter.malformed == was_malformed);
+  *malformed = was_malformed;
+  return steps;
+}
+
+static void test_small_buffers(void)
+{
+  bool malformed;
+  static const uint8_t zero_len[] = {0x00, 0x24, 0x01};
+  static const uint8_t one_len[] = {0x01, 0x24, 0x01};
+  static const uint8_t two_len[] = {0x02, 0x24, 0x03, 0x24, 0x01};
+  static const uint8_t past_end[] = {0x09, 0x04, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00};
+  static const uint8_t second_bad[] = {0x03, 0x24, 0x01, 0x05, 0x24, 0x01, 0x00};
+  TEST_CHECK(walk(zero_len, 0, &malformed) == 0 && !malformed);
+  TEST_CHECK(walk(zero_len, sizeof(zero_len), &malformed) == 0 && malformed);
+  TEST_CHECK(walk(one_len, sizeof(one_len), &malformed) == 0 && malformed);
+  // a lone byte cannot hold a descriptor
+  TEST_CHECK(walk(two_len, 1, &malformed) == 0 && malformed);
+  TEST_CHECK(walk(two_len, 2, &malformed) == 1 && !malformed);
+  TEST_CHECK(walk(two_len, sizeof(two_len), &malformed) == 2 && !malformed);
+  TEST_CHECK(walk(past_end, sizeof(past_end), &malformed) == 0 && malformed);
+  TEST_CHECK(walk(second_bad, sizeof(second_bad), &malformed) == 1 && malformed);
+}
+
+// Every configure function on the first len bytes of config, which are
+// copied to a buffer of exactly len bytes with wTotalLength set to len.
+// usb_midi_descriptor_lib_dev_configure() and view mode only get the bytes
+// from the MIDI Streaming interface on, so only if bad_offset is one of them.
+static bool configure_any(const descriptor_corpus_entry_t* entry, const uint8_t* config, uint16_t len,
+                          uint16_t bad_offset)
+{
+  uint8_t* copy = malloc(len);
+  memcpy(copy, config, len);
+  copy[2] = len & 0xFF;
+  copy[3] = len >> 8;
+  bool ok = false;
+  usb_midi_descriptor_lib_dev_set_arena(&dev, &arena);
+  ok |= usb_midi_descriptor_lib_dev_configure_from_full(&dev, copy);
+  usb_midi_descriptor_lib_interface_t itf;
+  if (usb_midi_descriptor_lib_find_midi_interfaces(copy, &itf, 1) == 1)
+    ok |= usb_midi_descriptor_lib_dev_configure_interface(&dev, copy, &itf);
+  usb_midi_descriptor_parser_t parser;
+  usb_midi_descriptor_parser_init_dev(&parser, &dev);
+  ok |= usb_midi_descriptor_parser_feed(&parser, copy, len) && usb_midi_descriptor_parser_complete(&parser);
+  if (bad_offset >= entry->midi_offset) {
+    ok |= usb_midi_descriptor_lib_dev_configure(&dev, copy + entry->midi_offset, len - entry->midi_offset);
+    ok |= usb_midi_descriptor_lib_dev_configure_view(&dev, copy + entry->midi_offset, len - entry->midi_offset);
+  }
+  usb_midi_descriptor_lib_dev_init(&dev);
+  free(copy);
+  return ok;
+}
+
+static void test_corpus_entry(const descriptor_corpus_entry_t* entry)
+{
+  static bool boundary[MAX_CONFIG_LEN + 1];
+  static uint8_t config[MAX_CONFIG_LEN];
+  bool malformed;
+  TEST_CHECK(walk(entry->config, entry->config_len, &malformed) == entry->num_descriptors && !malformed);
+  memset(boundary, 0, sizeof(boundary));
+  for (uint16_t offset = 0; offset < entry->config_len; offset += entry->config[offset])
+    boundary[offset] = true;
+  boundary[entry->config_len] = true;
+
+  // cut short anywhere
+  for (uint16_t len = 0; len <= entry->config_len; len++) {
+    uint8_t* copy = malloc(len ? len : 1);
+    memcpy(copy, entry->config, len);
+    walk(copy, len, &malformed);
+    TEST_CHECK(malformed == !boundary[len]);
+    free(copy);
+    if (len >= sizeof(tusb_desc_configuration_t) && !boundary[len])
+      TEST_CHECK(!configure_any(entry, entry->config, len, len));
+  }
+
+  // a bLength of 0, 1 or one past the end at any descriptor
+  memcpy(config, entry->config, entry->config_len);
+  for (uint16_t offset = sizeof(tusb_desc_configuration_t); offset < entry->config_len; offset += entry->config[offset]) {
+    uint8_t bad_lens[] = {0, 1, (uint8_t)(entry->config_len - offset + 1)};
+    for (size_t bad = 0; bad < sizeof(bad_lens); bad++) {
+      config[offset] = bad_lens[bad];
+      if (entry->config_len - offset + 1 <= 0xFF || bad < 2)
+        TEST_CHECK(!configure_any(entry, config, entry->config_len, offset));
+    }
+    config[offset] = entry->config[offset];
+  }
+  TEST_CHECK(configure_any(entry, config, entry->config_len, entry->config_len));
+}
+
+int main(void)
+{
+  usb_midi_descriptor_lib_arena_init(&arena, arena_bytes, sizeof(arena_bytes));
+  test_small_buffers();
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++)
+    test_corpus_entry(entries + idx);
+  TEST_CHECK(usb_midi_descriptor_lib_arena_bytes_free(&arena) == sizeof(arena_bytes));
+  return test_result("test_iterator");
+}
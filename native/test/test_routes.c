@@ -0,0 +1,122 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check the route of every virtual cable to its external jack: for the
+ * descriptor corpus, where each cable's embedded jack connects straight to
+ * an external jack, and for a MIDI Streaming interface where an Element sits
+ * between a cable and its external jack and some cables reach no external
+ * jack at all.
+ */
+#include "usb_midi_descriptor_lib.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+// OUT cable 0: embedded IN jack 1 -> Element 5 -> external OUT jack 2 (iJack 7)
+// OUT cable 1: embedded IN jack 3, connected to nothing
+// IN cable 0: external IN jack 9 (iJack 8) -> embedded OUT jack 10
+// IN cable 1: embedded OUT jack 12, with no sources
+static const uint8_t element_between[] = {
+  0x09, 0x04, 0x00, 0x00, 0x02, 0x01, 0x03, 0x00, 0x00,
+  0x07, 0x24, 0x01, 0x00, 0x01, 0x4C, 0x00,
+  0x06, 0x24, 0x02, 0x01, 0x01, 0x00,
+  0x0D, 0x24, 0x04, 0x05, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x01, 0x02, 0x00,
+  0x09, 0x24, 0x03, 0x02, 0x02, 0x01, 0x05, 0x01, 0x07,
+  0x06, 0x24, 0x02, 0x01, 0x03, 0x00,
+  0x06, 0x24, 0x02, 0x02, 0x09, 0x08,
+  0x09, 0x24, 0x03, 0x01, 0x0A, 0x01, 0x09, 0x01, 0x00,
+  0x07, 0x24, 0x03, 0x01, 0x0C, 0x00, 0x00,
+  0x09, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00,
+  0x06, 0x25, 0x01, 0x02, 0x01, 0x03,
+  0x09, 0x05, 0x81, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00,
+  0x06, 0x25, 0x01, 0x02, 0x0A, 0x0C,
+};
+
+// The corpus builds the embedded and external jack of a cable with the same
+// iJack. Host to device cable c is embedded IN jack 1 + 2c feeding external
+// OUT jack 2 + 2c; device to host cable c is external IN jack
+// 1 + 2 * num_cables_tx + 2c feeding the embedded OUT jack after it. The
+// specification's adapter has jacks 1 -> 4 and 2 -> 3 and no strings.
+static void test_corpus_routes(const descriptor_corpus_entry_t* entry, bool spec_adapter)
+{
+  TEST_CHECK(usb_midi_descriptor_lib_configure_from_full(0, entry->config));
+  uint8_t cable = 0;
+  for (uint8_t ep_num = 0; ep_num < usb_midi_descriptor_lib_get_num_in_endpoints(0); ep_num++) {
+    uint8_t ep_addr, num_cables;
+    TEST_CHECK(usb_midi_descriptor_lib_get_in_endpoint(0, ep_num, &ep_addr, &num_cables));
+    for (uint8_t cable_num = 0; cable_num < num_cables; cable_num++, cable++) {
+      uint8_t ext_jack_id = 0, str_idx = 0;
+      TEST_CHECK(usb_midi_descriptor_lib_get_in_endpoint_cable_route(0, ep_num, cable_num, &ext_jack_id, &str_idx));
+      TEST_CHECK(ext_jack_id == (spec_adapter ? 2 : 1 + 2 * entry->num_cables_tx + 2 * cable));
+      TEST_CHECK(str_idx == usb_midi_descriptor_lib_get_str_idx_for_in_endpoint_cable(0, ep_num, cable_num));
+    }
+  }
+  TEST_CHECK(cable == entry->num_cables_rx);
+  cable = 0;
+  for (uint8_t ep_num = 0; ep_num < usb_midi_descriptor_lib_get_num_out_endpoints(0); ep_num++) {
+    uint8_t ep_addr, num_cables;
+    TEST_CHECK(usb_midi_descriptor_lib_get_out_endpoint(0, ep_num, &ep_addr, &num_cables));
+    for (uint8_t cable_num = 0; cable_num < num_cables; cable_num++, cable++) {
+      uint8_t ext_jack_id = 0, str_idx = 0;
+      TEST_CHECK(usb_midi_descriptor_lib_get_out_endpoint_cable_route(0, ep_num, cable_num, &ext_jack_id, &str_idx));
+      TEST_CHECK(ext_jack_id == (spec_adapter ? 4 : 2 + 2 * cable));
+      TEST_CHECK(str_idx == usb_midi_descriptor_lib_get_str_idx_for_out_endpoint_cable(0, ep_num, cable_num));
+    }
+    // past the endpoint's last cable
+    uint8_t ext_jack_id = 0xFF, str_idx = 0xFF;
+    TEST_CHECK(!usb_midi_descriptor_lib_get_out_endpoint_cable_route(0, ep_num, num_cables, &ext_jack_id, &str_idx));
+  }
+  TEST_CHECK(cable == entry->num_cables_tx);
+}
+
+static void test_element_between(void)
+{
+  TEST_CHECK(usb_midi_descriptor_lib_configure(0, element_between, sizeof(element_between)));
+  uint8_t ext_jack_id = 0xFF, str_idx = 0xFF;
+  TEST_CHECK(usb_midi_descriptor_lib_get_out_endpoint_cable_route(0, 0, 0, &ext_jack_id, &str_idx));
+  TEST_CHECK(ext_jack_id == 2 && str_idx == 7);
+  ext_jack_id = str_idx = 0xFF;
+  TEST_CHECK(!usb_midi_descriptor_lib_get_out_endpoint_cable_route(0, 0, 1, &ext_jack_id, &str_idx));
+  TEST_CHECK(ext_jack_id == 0 && str_idx == 0);
+  ext_jack_id = str_idx = 0xFF;
+  TEST_CHECK(usb_midi_descriptor_lib_get_in_endpoint_cable_route(0, 0, 0, &ext_jack_id, &str_idx));
+  TEST_CHECK(ext_jack_id == 9 && str_idx == 8);
+  ext_jack_id = str_idx = 0xFF;
+  TEST_CHECK(!usb_midi_descriptor_lib_get_in_endpoint_cable_route(0, 0, 1, &ext_jack_id, &str_idx));
+  TEST_CHECK(ext_jack_id == 0 && str_idx == 0);
+  // an unconfigured slot has no routes
+  usb_midi_descriptor_lib_init(0);
+  TEST_CHECK(!usb_midi_descriptor_lib_get_in_endpoint_cable_route(0, 0, 0, &ext_jack_id, &str_idx));
+}
+
+int main(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++)
+    test_corpus_routes(entries + idx, idx == 0);
+  test_element_between();
+  return test_result("test_routes");
+}
@@ -0,0 +1,349 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Save every device of the descriptor corpus, restore it, and check that
+ * every getter returns what it returned before the save: for
+ * usb_midi_descriptor_lib_dev_save() with a restore to the arena and a
+ * restore in place, and for replug cache flash images with their strings.
+ * The USB host is simulated the way bench_replug simulates it.
+ */
+#include <stdarg.h>
+#include "usb_midi_descriptor_lib.h"
+#include "usb_midi_string_cache.h"
+#include "usb_midi_replug_cache.h"
+#include "descriptor_corpus.h"
+#include "test_util.h"
+
+#define TEST_DADDR 1
+#define MAX_SAVED 2048
+#define MAX_DESCRIPTION 8192
+
+// The serial number is the longest string a descriptor can hold: 126 CJK code units, each 3 UTF-8 bytes
+#define SERIAL_STR_IDX 3
+#define SERIAL_UNITS 126
+#define SERIAL_UTF8_LEN (3 * SERIAL_UNITS)
+
+// The request the simulated host has in flight
+static tuh_xfer_cb_t pending_cb;
+static uint8_t* pending_buffer;
+static uint8_t pending_str_idx;
+static uintptr_t pending_user_data;
+
+bool tuh_descriptor_get_device_local(uint8_t daddr, tusb_desc_device_t* desc_device)
+{
+  memset(desc_device, 0, sizeof(*desc_device));
+  desc_device->idVendor = 0x1234;
+  desc_device->idProduct = 0x5678 + daddr;
+  desc_device->bcdDevice = 0x0100;
+  desc_device->iManufacturer = 1;
+  desc_device->iProduct = 2;
+  desc_device->iSerialNumber = SERIAL_STR_IDX;
+  return true;
+}
+
+static bool start_request(uint8_t index, void* buffer, tuh_xfer_cb_t complete_cb, uintptr_t user_data)
+{
+  if (pending_cb)
+    return false;
+  pending_cb = complete_cb;
+  pending_buffer = buffer;
+  pending_str_idx = index;
+  pending_user_data = user_data;
+  return true;
+}
+
+bool tuh_descriptor_get_string(uint8_t daddr, uint8_t index, uint16_t language_id, void* buffer, uint16_t len,
+                               tuh_xfer_cb_t complete_cb, uintptr_t user_data)
+{
+  (void)daddr;
+  (void)language_id;
+  (void)len;
+  return start_request(index, buffer, complete_cb, user_data);
+}
+
+bool tuh_descriptor_get_string_langid(uint8_t daddr, void* buffer, uint16_t len,
+                                      tuh_xfer_cb_t complete_cb, uintptr_t user_data)
+{
+  (void)daddr;
+  (void)len;
+  return start_request(0, buffer, complete_cb, user_data);
+}
+
+// Complete the request in flight with the string "String <index>", the long serial number or, for index 0,
+// US English
+static void complete_request(void)
+{
+  char str[16];
+  int len = pending_str_idx == 0 ? 1 : snprintf(str, sizeof(str), "String %u", pending_str_idx);
+  if (pending_str_idx == SERIAL_STR_IDX)
+    len = SERIAL_UNITS;
+  pending_buffer[0] = 2 + 2 * len;
+  pending_buffer[1] = TUSB_DESC_STRING;
+  for (int unit = 0; unit < len; unit++)
+  {
+    uint16_t code_unit = pending_str_idx == 0 ? 0x0409 :
+                         pending_str_idx == SERIAL_STR_IDX ? 0x4E00 + unit : (uint8_t)str[unit];
+    pending_buffer[2 + 2 * unit] = code_unit & 0xFF;
+    pending_buffer[3 + 2 * unit] = code_unit >> 8;
+  }
+  tuh_xfer_t xfer = {
+    .daddr = TEST_DADDR, .result = XFER_RESULT_SUCCESS, .actual_len = 2 + 2 * len,
+    .buffer = pending_buffer, .complete_cb = pending_cb, .user_data = pending_user_data
+  };
+  tuh_xfer_cb_t cb = pending_cb;
+  pending_cb = NULL;
+  cb(&xfer);
+}
+
+typedef struct
+{
+  char text[MAX_DESCRIPTION];
+  size_t len;
+} description_t;
+
+static void describe(description_t* desc, const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(desc->text + desc->len, sizeof(desc->text) - desc->len, format, args);
+  va_end(args);
+  if (len > 0)
+    desc->len += (size_t)len;
+  if (desc->len >= sizeof(desc->text))
+    desc->len = sizeof(desc->text) - 1;
+}
+
+// Describe everything the getters of a device return
+static void describe_device(description_t* desc, const usb_midi_descriptor_info_t* dev)
+{
+  desc->len = 0;
+  desc->text[0] = '\0';
+  const uint8_t* indices;
+  int num_indices = usb_midi_descriptor_lib_dev_get_all_str_indices(dev, &indices);
+  describe(desc, "strings");
+  for (int idx = 0; idx < num_indices; idx++)
+    describe(desc, " %u", indices[idx]);
+  uint8_t copied[MAX_STRING_INDICES];
+  TEST_CHECK(usb_midi_descriptor_lib_dev_copy_all_str_indices(dev, copied, MAX_STRING_INDICES) == num_indices);
+  TEST_CHECK(num_indices <= 0 || memcmp(copied, indices, (size_t)num_indices) == 0);
+
+  uint8_t num_eps = usb_midi_descriptor_lib_dev_get_num_in_endpoints(dev);
+  for (uint8_t ep_num = 0; ep_num < num_eps; ep_num++) {
+    uint8_t ep_addr = 0, num_cables = 0;
+    TEST_CHECK(usb_midi_descriptor_lib_dev_get_in_endpoint(dev, ep_num, &ep_addr, &num_cables));
+    describe(desc, "\nin ep 0x%02x", ep_addr);
+    for (uint8_t cable = 0; cable < num_cables; cable++) {
+      uint8_t jack_id = 0, str_idx = 0;
+      bool routed = usb_midi_descriptor_lib_dev_get_in_endpoint_cable_route(dev, ep_num, cable, &jack_id, &str_idx);
+      describe(desc, " %d:%d/%u/%u", usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(dev, ep_num, cable),
+               routed, jack_id, str_idx);
+    }
+  }
+  num_eps = usb_midi_descriptor_lib_dev_get_num_out_endpoints(dev);
+  for (uint8_t ep_num = 0; ep_num < num_eps; ep_num++) {
+    uint8_t ep_addr = 0, num_cables = 0;
+    TEST_CHECK(usb_midi_descriptor_lib_dev_get_out_endpoint(dev, ep_num, &ep_addr, &num_cables));
+    describe(desc, "\nout ep 0x%02x", ep_addr);
+    for (uint8_t cable = 0; cable < num_cables; cable++) {
+      uint8_t jack_id = 0, str_idx = 0;
+      bool routed = usb_midi_descriptor_lib_dev_get_out_endpoint_cable_route(dev, ep_num, cable, &jack_id, &str_idx);
+      describe(desc, " %d:%d/%u/%u", usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(dev, ep_num, cable),
+               routed, jack_id, str_idx);
+    }
+  }
+
+  usb_midi_descriptor_lib_device_summary_t summary;
+  memset(&summary, 0, sizeof(summary));
+  TEST_CHECK(usb_midi_descriptor_lib_dev_get_device_summary(dev, &summary));
+  describe(desc, "\nsummary");
+  for (size_t pos = 0; pos < sizeof(summary); pos++)
+    describe(desc, " %u", ((const uint8_t*)&summary)[pos]);
+
+  uint8_t num_elements = usb_midi_descriptor_lib_dev_get_num_elements(dev);
+  for (uint8_t elem_num = 0; elem_num < num_elements; elem_num++) {
+    usb_midi_descriptor_lib_element_t element, found;
+    TEST_CHECK(usb_midi_descriptor_lib_dev_get_element(dev, elem_num, &element));
+    TEST_CHECK(usb_midi_descriptor_lib_dev_find_element(dev, element.id, &found) && found.id == element.id);
+    describe(desc, "\nelement %u %u/%u %u/%u str %u caps 0x%x sources", element.id, element.num_in_pins,
+             element.num_out_pins, element.in_terminal_link, element.out_terminal_link, element.str_idx,
+             (unsigned)element.caps);
+    for (uint8_t pin = 0; pin < element.num_in_pins; pin++) {
+      uint8_t source_id = 0, source_pin = 0;
+      TEST_CHECK(usb_midi_descriptor_lib_dev_get_element_source(dev, element.id, pin, &source_id, &source_pin));
+      describe(desc, " %u.%u", source_id, source_pin);
+    }
+  }
+
+  uint8_t num_entities = usb_midi_descriptor_lib_dev_get_num_audio_entities(dev);
+  for (uint8_t entity_num = 0; entity_num < num_entities; entity_num++) {
+    usb_midi_descriptor_lib_audio_entity_t entity, found;
+    TEST_CHECK(usb_midi_descriptor_lib_dev_get_audio_entity(dev, entity_num, &entity));
+    TEST_CHECK(usb_midi_descriptor_lib_dev_find_audio_entity(dev, entity.id, &found) &&
+               found.subtype == entity.subtype);
+    describe(desc, "\nentity %u subtype %u type 0x%04x str %u protocol 0x%02x", entity.id, entity.subtype,
+             entity.terminal_type, entity.str_idx, entity.protocol);
+  }
+}
+
+// Describe the strings the string cache has for device slot 0 as well
+static void describe_slot(description_t* desc)
+{
+  usb_midi_descriptor_info_t* dev = usb_midi_descriptor_lib_get_device(0);
+  describe_device(desc, dev);
+  describe(desc, "\n%s|%s|%s", usb_midi_string_cache_get_manufacturer(0), usb_midi_string_cache_get_product(0),
+           usb_midi_string_cache_get_serial(0));
+  const uint8_t* indices;
+  int num_indices = usb_midi_descriptor_lib_dev_get_all_str_indices(dev, &indices);
+  for (int idx = 0; idx < num_indices; idx++) {
+    const char* str = usb_midi_string_cache_get_string(0, indices[idx]);
+    describe(desc, "|%s", str ? str : "(none)");
+  }
+}
+
+static void check_same(const char* name, const char* what, const description_t* expected, const description_t* got)
+{
+  if (strcmp(expected->text, got->text) != 0) {
+    printf("%s: %s differs\nexpected:\n%s\ngot:\n%s\n", name, what, expected->text, got->text);
+    ++test_failures;
+  }
+}
+
+// usb_midi_descriptor_lib_dev_save() and both restores, on devices and an
+// arena the test owns; the device restored in place needs no arena
+static void test_dev_save_restore(const descriptor_corpus_entry_t* entry)
+{
+  static usb_midi_descriptor_info_t parsed, restored, in_place;
+  static usb_midi_descriptor_lib_arena_t arena;
+  static uint8_t arena_bytes[USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE];
+  static description_t expected, got;
+  static uint8_t saved[MAX_SAVED], resaved[MAX_SAVED], unaligned[1 + MAX_SAVED];
+  usb_midi_descriptor_lib_arena_init(&arena, arena_bytes, sizeof(arena_bytes));
+  usb_midi_descriptor_lib_dev_set_arena(&parsed, &arena);
+  usb_midi_descriptor_lib_dev_set_arena(&restored, &arena);
+  usb_midi_descriptor_lib_dev_init(&in_place);
+  uint16_t index_arena_free = usb_midi_descriptor_lib_get_arena_bytes_free();
+  TEST_CHECK(usb_midi_descriptor_lib_dev_configure_from_full(&parsed, entry->config));
+  TEST_CHECK(usb_midi_descriptor_lib_arena_bytes_free(&arena) < sizeof(arena_bytes));
+  TEST_CHECK(usb_midi_descriptor_lib_get_arena_bytes_free() == index_arena_free);
+  describe_device(&expected, &parsed);
+
+  uint16_t len = usb_midi_descriptor_lib_dev_save(&parsed, NULL, 0);
+  TEST_CHECK(len > 0 && len <= MAX_SAVED);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_save(&parsed, saved, len - 1) == 0);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_save(&parsed, saved, MAX_SAVED) == len);
+  // make room in the arena for the restore
+  usb_midi_descriptor_lib_dev_init(&parsed);
+
+  TEST_CHECK(usb_midi_descriptor_lib_dev_restore(&restored, saved, len));
+  describe_device(&got, &restored);
+  check_same(entry->name, "restore", &expected, &got);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_save(&restored, resaved, MAX_SAVED) == len);
+  TEST_CHECK(memcmp(saved, resaved, len) == 0);
+
+  memcpy(unaligned + 1, saved, len);
+  uint16_t arena_free = usb_midi_descriptor_lib_arena_bytes_free(&arena);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_restore_in_place(&in_place, unaligned + 1, len));
+  TEST_CHECK(usb_midi_descriptor_lib_arena_bytes_free(&arena) == arena_free);
+  describe_device(&got, &in_place);
+  check_same(entry->name, "restore in place", &expected, &got);
+  TEST_CHECK(usb_midi_descriptor_lib_dev_save(&in_place, resaved, MAX_SAVED) == len);
+  TEST_CHECK(memcmp(saved, resaved, len) == 0);
+
+  // saved data cut short is rejected
+  for (uint16_t short_len = 0; short_len < len; short_len++) {
+    TEST_CHECK(!usb_midi_descriptor_lib_dev_restore(&restored, saved, short_len));
+    TEST_CHECK(!usb_midi_descriptor_lib_dev_restore_in_place(&in_place, saved, short_len));
+  }
+  // a device with no arena can only be a view or restored in place
+  TEST_CHECK(!usb_midi_descriptor_lib_dev_restore(&in_place, saved, len));
+  usb_midi_descriptor_lib_dev_init(&restored);
+  usb_midi_descriptor_lib_dev_init(&in_place);
+  TEST_CHECK(usb_midi_descriptor_lib_arena_bytes_free(&arena) == sizeof(arena_bytes));
+}
+
+static void unmount(void)
+{
+  usb_midi_descriptor_lib_init(0);
+  usb_midi_string_cache_init(0);
+}
+
+// A replug cache flash image, added back as after a power cycle
+static void test_image(const descriptor_corpus_entry_t* entry)
+{
+  static description_t expected, got;
+  static uint8_t flash[1 + 4096];
+  uint8_t* image = flash + 1;
+  const uint8_t* midi = entry->config + entry->midi_offset;
+  uint32_t midi_len = entry->config_len - entry->midi_offset;
+
+  // Mount the device the way the examples do; the lookup keys the slot
+  usb_midi_replug_cache_clear();
+  TEST_CHECK(!usb_midi_replug_cache_lookup(0, TEST_DADDR, midi, midi_len));
+  TEST_CHECK(usb_midi_descriptor_lib_configure(0, midi, midi_len));
+  TEST_CHECK(usb_midi_string_cache_start(0, TEST_DADDR, NULL));
+  while (pending_cb)
+    complete_request();
+  TEST_CHECK(usb_midi_string_cache_complete(0));
+  TEST_CHECK(strlen(usb_midi_string_cache_get_serial(0)) == SERIAL_UTF8_LEN);
+  describe_slot(&expected);
+  uint16_t len = usb_midi_replug_cache_save_image(0, NULL, 0);
+  TEST_CHECK(len > 0 && len <= sizeof(flash) - 1);
+  TEST_CHECK(usb_midi_replug_cache_save_image(0, image, len) == len);
+  unmount();
+
+  TEST_CHECK(usb_midi_replug_cache_add_image(image, len));
+  uint16_t arena_free = usb_midi_descriptor_lib_get_arena_bytes_free();
+  TEST_CHECK(usb_midi_replug_cache_lookup(0, TEST_DADDR, midi, midi_len));
+  TEST_CHECK(pending_cb == NULL);
+  TEST_CHECK(usb_midi_descriptor_lib_get_arena_bytes_free() == arena_free);
+  TEST_CHECK(strlen(usb_midi_string_cache_get_serial(0)) == SERIAL_UTF8_LEN);
+  describe_slot(&got);
+  check_same(entry->name, "flash image", &expected, &got);
+  unmount();
+
+  // an image with any byte changed or cut short is rejected
+  static uint8_t corrupt[4096];
+  for (uint16_t pos = 0; pos < len; pos++) {
+    usb_midi_replug_cache_clear();
+    memcpy(corrupt, image, len);
+    corrupt[pos] ^= 0x5A;
+    TEST_CHECK(!usb_midi_replug_cache_add_image(corrupt, len));
+  }
+  usb_midi_replug_cache_clear();
+  TEST_CHECK(!usb_midi_replug_cache_add_image(image, len - 1));
+  usb_midi_replug_cache_clear();
+}
+
+int main(void)
+{
+  const descriptor_corpus_entry_t* entries;
+  size_t nentries = descriptor_corpus_get(&entries);
+  for (size_t idx = 0; idx < nentries; idx++) {
+    test_dev_save_restore(entries + idx);
+    test_image(entries + idx);
+  }
+  return test_result("test_save_restore");
+}
@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check utf16DescriptorToUtf8() and utf16ToUtf8Written(): round trips of
+ * well-formed strings through utf8ToUtf16Descriptor(), U+FFFD for unpaired
+ * surrogates, and truncation to the dest buffer. The build makes this twice,
+ * with and without the ASCII fast path.
+ */
+#include <string.h>
+#include "utf8_to_utf16.h"
+#include "utf16_to_utf8.h"
+#include "test_util.h"
+
+static const char* const round_trip_strings[] = {
+  "", "MIDI", "USB MIDI Keyboard Controller MIDI OUT 16",
+  "Gr\xC3\xB6\xC3\x9F" "e Klaviatur", "Contr\xC3\xB4leur MIDI \xC3\x89" "dition",
+  "\xE3\x83\x9F\xE3\x83\x87\xE3\x82\xA3\xE5\x85\xA5\xE5\x8A\x9B", "\xE2\x82\xAC" "100 \xEF\xBF\xBF",
+  "\xF0\x9F\x8E\xB9 Keys \xF0\x9F\x8E\xB8", "\xF0\x90\x80\x80\xF4\x8F\xBF\xBF",
+  "ABCD\xC3\xA9" "FGHIJ" "\xF0\x9F\x8E\xB9" "KLMNOPQRSTUVWXYZ0123456789",
+};
+
+// Convert src to a string descriptor at odd alignment and back
+static void test_round_trip(void)
+{
+  for (size_t idx = 0; idx < sizeof(round_trip_strings) / sizeof(round_trip_strings[0]); idx++) {
+    const char* src = round_trip_strings[idx];
+    uint8_t buf[1 + 254];
+    uint8_t* desc = buf + 1;
+    size_t desc_len = utf8ToUtf16Descriptor((const uint8_t*)src, strlen(src) + 1, desc, 254);
+    uint8_t dest[256];
+    memset(dest, 0xAA, sizeof(dest));
+    size_t len = utf16DescriptorToUtf8(desc, desc_len, dest, sizeof(dest));
+    TEST_CHECK(len == strlen(src));
+    TEST_CHECK(utf16DescriptorToUtf8Length(desc, desc_len) == len);
+    TEST_CHECK(strcmp((const char*)dest, src) == 0);
+    // and from code units in the machine's byte order
+    uint16_t units[127];
+    size_t num_units = (desc_len - 2) / 2;
+    for (size_t unit = 0; unit < num_units; unit++)
+      units[unit] = (uint16_t)(desc[2 + 2 * unit] | (desc[3 + 2 * unit] << 8));
+    TEST_CHECK(utf16ToUtf8Written(units, num_units, dest, sizeof(dest)) == len);
+    TEST_CHECK(utf16ToUtf8Length(units, num_units) == len);
+    TEST_CHECK(strcmp((const char*)dest, src) == 0);
+  }
+}
+
+static void check_utf8(const uint16_t* units, size_t num_units, const char* expected)
+{
+  uint8_t dest[64];
+  size_t len = utf16ToUtf8Written((uint16_t*)units, num_units, dest, sizeof(dest));
+  TEST_CHECK(len == strlen(expected));
+  TEST_CHECK(utf16ToUtf8Length(units, num_units) == len);
+  if (strcmp((const char*)dest, expected) != 0) {
+    printf("utf16ToUtf8Written() gave \"%s\", expected \"%s\"\n", dest, expected);
+    ++test_failures;
+  }
+}
+
+#define CHECK_UTF8(expected, ...) \
+  do { \
+    static const uint16_t units[] = {__VA_ARGS__}; \
+    check_utf8(units, sizeof(units) / sizeof(units[0]), expected); \
+  } while (0)
+
+#define FFFD "\xEF\xBF\xBD"
+
+static void test_ill_formed(void)
+{
+  CHECK_UTF8("a" FFFD "b", 'a', 0xD83C, 'b');
+  CHECK_UTF8("a" FFFD "b", 'a', 0xDFB9, 'b');
+  CHECK_UTF8(FFFD FFFD, 0xDFB9, 0xD83C);
+  CHECK_UTF8(FFFD "\xF0\x9F\x8E\xB9", 0xD83C, 0xD83C, 0xDFB9);
+  CHECK_UTF8("ab" FFFD, 'a', 'b', 0xD83C);
+  // a Byte Order Mark is skipped, U+0000 ends the string
+  CHECK_UTF8("Port", 0xFEFF, 'P', 'o', 'r', 't');
+  CHECK_UTF8("Po", 'P', 'o', 0, 'r', 't');
+  // a descriptor that is not a string descriptor, or bLength past desc_len
+  uint8_t dest[16];
+  static const uint8_t not_string[] = {6, 4, 'a', 0, 'b', 0};
+  TEST_CHECK(utf16DescriptorToUtf8(not_string, sizeof(not_string), dest, sizeof(dest)) == 0 && dest[0] == 0);
+  static const uint8_t long_b_length[] = {10, 3, 'a', 0, 'b', 0};
+  TEST_CHECK(utf16DescriptorToUtf8(long_b_length, sizeof(long_b_length), dest, sizeof(dest)) == 2);
+  TEST_CHECK(utf16DescriptorToUtf8(long_b_length, 5, dest, sizeof(dest)) == 1);
+}
+
+static void test_truncation(void)
+{
+  static const uint16_t units[] = {'a', 0x00E9, 0x20AC, 0xD83C, 0xDFB9, 'b', 'c', 'd', 'e', 'f'};
+  static const size_t num_units = sizeof(units) / sizeof(units[0]);
+  // a character that does not fit is left out whole
+  static const size_t fits[] = {0, 0, 1, 1, 3, 3, 3, 6, 6, 6, 6, 10, 11, 12, 13, 14, 15, 15};
+  for (size_t maxdest = 1; maxdest < sizeof(fits) / sizeof(fits[0]); maxdest++) {
+    uint8_t dest[32];
+    memset(dest, 0xAA, sizeof(dest));
+    size_t len = utf16ToUtf8Written((uint16_t*)units, num_units, dest, maxdest);
+    TEST_CHECK(len == fits[maxdest]);
+    TEST_CHECK(dest[len] == 0 && dest[maxdest] == 0xAA);
+  }
+}
+
+int main(void)
+{
+  test_round_trip();
+  test_ill_formed();
+  test_truncation();
+#if UTF16_TO_UTF8_ASCII_FAST_PATH
+  return test_result("test_utf16_to_utf8");
+#else
+  return test_result("test_utf16_to_utf8_scalar");
+#endif
+}
@@ -0,0 +1,127 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Check utf8ToUtf16Descriptor() against hand encoded descriptors: well-formed
+ * UTF-8 of every length, the U+FFFD replacements the Unicode standard
+ * recommends for ill-formed UTF-8, and truncation to the dest buffer.
+ */
+#include <string.h>
+#include "utf8_to_utf16.h"
+#include "test_util.h"
+
+// Check that src converts to the code units expected, and that the length
+// function agrees with the conversion
+static void check_units(const char* src, const uint16_t* expected, size_t num_expected)
+{
+  uint8_t desc[254];
+  size_t len = utf8ToUtf16Descriptor((const uint8_t*)src, strlen(src) + 1, desc, sizeof(desc));
+  TEST_CHECK(len == 2 + 2 * num_expected);
+  TEST_CHECK(desc[0] == len && desc[1] == 3);
+  TEST_CHECK(utf8ToUtf16DescriptorLength((const uint8_t*)src, strlen(src) + 1) == len);
+  for (size_t idx = 0; idx < num_expected && 2 + 2 * idx < len; idx++) {
+    uint16_t unit = (uint16_t)(desc[2 + 2 * idx] | (desc[3 + 2 * idx] << 8));
+    if (unit != expected[idx]) {
+      printf("\"%s\" code unit %zu is 0x%04x, expected 0x%04x\n", src, idx, unit, expected[idx]);
+      ++test_failures;
+    }
+  }
+}
+
+#define CHECK_UNITS(src, ...) \
+  do { \
+    static const uint16_t expected[] = {__VA_ARGS__}; \
+    check_units(src, expected, sizeof(expected) / sizeof(expected[0])); \
+  } while (0)
+
+static void test_well_formed(void)
+{
+  CHECK_UNITS("Port 1", 'P', 'o', 'r', 't', ' ', '1');
+  CHECK_UNITS("Gr\xC3\xB6\xC3\x9F" "e", 'G', 'r', 0x00F6, 0x00DF, 'e');
+  CHECK_UNITS("\xE2\x82\xAC\xE3\x83\x9F", 0x20AC, 0x30DF);
+  CHECK_UNITS("\xEF\xBF\xBF", 0xFFFF);
+  CHECK_UNITS("\xF0\x9F\x8E\xB9" "a", 0xD83C, 0xDFB9, 'a');
+  CHECK_UNITS("\xF0\x90\x80\x80\xF4\x8F\xBF\xBF", 0xD800, 0xDC00, 0xDBFF, 0xDFFF);
+  // the empty string is only the header
+  uint8_t desc[4] = {0xAA, 0xAA, 0xAA, 0xAA};
+  TEST_CHECK(utf8ToUtf16Descriptor((const uint8_t*)"", 1, desc, sizeof(desc)) == 2);
+  TEST_CHECK(desc[0] == 2 && desc[1] == 3 && desc[2] == 0xAA);
+  // maxsrc ends the string without a NULL termination
+  CHECK_UNITS("MIDI", 'M', 'I', 'D', 'I');
+  TEST_CHECK(utf8ToUtf16Descriptor((const uint8_t*)"MIDI", 2, NULL, 254) == 6);
+}
+
+static void test_ill_formed(void)
+{
+  // Table 3-8 of the Unicode standard: one U+FFFD per maximal subpart
+  CHECK_UNITS("\x61\xF1\x80\x80\xE1\x80\xC2\x62\x80\x63\x80\xBF\x64",
+              'a', 0xFFFD, 0xFFFD, 0xFFFD, 'b', 0xFFFD, 'c', 0xFFFD, 0xFFFD, 'd');
+  // overlong encodings
+  CHECK_UNITS("\xC0\xAF", 0xFFFD, 0xFFFD);
+  CHECK_UNITS("\xC1\xBF", 0xFFFD, 0xFFFD);
+  CHECK_UNITS("\xE0\x80\xAF", 0xFFFD, 0xFFFD, 0xFFFD);
+  CHECK_UNITS("\xF0\x8F\xBF\xBF", 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD);
+  // surrogate code points and code points above U+10FFFF
+  CHECK_UNITS("\xED\xA0\x80" "x", 0xFFFD, 0xFFFD, 0xFFFD, 'x');
+  CHECK_UNITS("\xED\x9F\xBF", 0xD7FF);
+  CHECK_UNITS("\xF4\x90\x80\x80", 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD);
+  CHECK_UNITS("\xF5\x80", 0xFFFD, 0xFFFD);
+  CHECK_UNITS("\xFE\xFF", 0xFFFD, 0xFFFD);
+  // sequences cut short by the next character or the end of the string
+  CHECK_UNITS("\xE2\x82" "A", 0xFFFD, 'A');
+  CHECK_UNITS("\xF0\x9F\x8E", 0xFFFD);
+  CHECK_UNITS("\xC3", 0xFFFD);
+  uint8_t desc[16];
+  TEST_CHECK(utf8ToUtf16Descriptor((const uint8_t*)"\xC3\xB6", 1, desc, sizeof(desc)) == 4);
+  TEST_CHECK(desc[2] == 0xFD && desc[3] == 0xFF);
+}
+
+static void test_truncation(void)
+{
+  uint8_t desc[256];
+  const uint8_t* keys = (const uint8_t*)"a\xF0\x9F\x8E\xB9";
+  // A surrogate pair is never split
+  TEST_CHECK(utf8ToUtf16Descriptor(keys, 6, desc, 7) == 4);
+  TEST_CHECK(desc[0] == 4);
+  TEST_CHECK(utf8ToUtf16Descriptor(keys, 6, desc, 8) == 8);
+  // No room for the header
+  TEST_CHECK(utf8ToUtf16Descriptor(keys, 6, desc, 1) == 0);
+  TEST_CHECK(utf8ToUtf16Descriptor(keys, 6, desc, 2) == 2);
+  // bLength is at most 254 however large dest is
+  uint8_t long_src[300];
+  memset(long_src, 'a', sizeof(long_src) - 1);
+  long_src[sizeof(long_src) - 1] = 0;
+  TEST_CHECK(utf8ToUtf16Descriptor(long_src, sizeof(long_src), desc, sizeof(desc)) == 254);
+  TEST_CHECK(desc[0] == 254);
+  TEST_CHECK(utf8ToUtf16DescriptorLength(long_src, sizeof(long_src)) == 254);
+}
+
+int main(void)
+{
+  test_well_formed();
+  test_ill_formed();
+  test_truncation();
+  return test_result("test_utf8_to_utf16");
+}
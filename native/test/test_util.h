@@ -0,0 +1,51 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Small helpers shared by the native tests. A failed check prints where it
+ * failed and the test keeps going; main() returns test_result() so CTest
+ * sees every failure of a run.
+ */
+#pragma once
+#include <stdio.h>
+
+static int test_failures;
+
+#define TEST_CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++test_failures; \
+    } \
+  } while (0)
+
+static inline int test_result(const char* name)
+{
+  if (test_failures)
+    printf("%s: %d checks failed\n", name, test_failures);
+  else
+    printf("%s: ok\n", name);
+  return test_failures ? 1 : 0;
+}
@@ -23,35 +23,48 @@
  *
  */
 
+#include <stdatomic.h>
 #include "usb_midi_descriptor_lib.h"
-#include "pico/multicore.h"
+#if defined(LIB_PICO_TIME)
+#include "pico/time.h"
+#elif defined(__linux__)
+#include <time.h>
+#endif
 
-typedef struct
+// A device's block in its arena, or the saved block it reads in place, holds in order:
+//   - one record per Audio Control entity (num_audio_entities records of AUDIO_ENTITY_RECORD_LEN bytes)
+//   - one record per jack, per element and per CS endpoint descriptor, in descriptor order
+//   - the string index of each IN endpoint cable's jack (num_in_cables bytes)
+//   - the string index of each OUT endpoint cable's jack (num_out_cables bytes)
+//   - the unique string indices in ascending order (num_string_indices bytes)
+//   - the route of each IN endpoint cable (num_in_cables pairs of bytes)
+//   - the route of each OUT endpoint cable (num_out_cables pairs of bytes)
+//   - the block offset of each element record, little endian (num_elements pairs of bytes)
+//   - the element directory: for each element ID from element_id_first to
+//     element_id_last, 1 + the element's position in the offset list or 0 if no element has the ID
+// A route is the ID and string index of the external jack the cable's embedded
+// jack connects to, or two zeros if the cable does not reach an external jack.
+
+// The part of a device the getters read; read_snapshot() copies only this much
+#define SNAPSHOT_LEN offsetof(usb_midi_descriptor_info_t, seq)
+
+// Each record in a block is a type byte and a length byte followed by length bytes of payload
+enum
 {
-  bool configured;
-  uint8_t ep_in;          // IN endpoint address
-  uint8_t ep_out;         // OUT endpoint address
-  uint8_t num_cables_rx;  // IN endpoint CS descriptor bNumEmbMIDIJack value
-  uint8_t num_cables_tx;  // OUT endpoint CS descriptor bNumEmbMIDIJack value
-  uint8_t all_string_indices[MAX_STRING_INDICES];
-  uint8_t num_string_indices;
-  struct {
-    uint8_t jack_id;
-    uint8_t jack_type;
-    uint8_t string_index;
-  } in_jack_info[MAX_IN_JACKS];
-  uint8_t next_in_jack;
-  struct {
-    uint8_t jack_id;
-    uint8_t jack_type;
-    uint8_t num_source_ids;
-    uint8_t source_ids[MAX_IN_JACKS];
-    uint8_t string_index;
-  } out_jack_info[MAX_OUT_JACKS];
-  uint8_t next_out_jack;
-  uint8_t ep_in_associated_jacks[MAX_IN_CABLES];
-  uint8_t ep_out_associated_jacks[MAX_OUT_CABLES];
-} usb_midi_descriptor_info_t;
+  RECORD_IN_JACK = MIDI_CS_INTERFACE_IN_JACK,   // bJackID, bJackType, iJack
+  RECORD_OUT_JACK = MIDI_CS_INTERFACE_OUT_JACK, // bJackID, bJackType, iJack, bNrInputPins, baSourceID/baSourcePin pairs
+  RECORD_ELEMENT = MIDI_CS_INTERFACE_ELEMENT,   // the Element descriptor from bElementID to iElement
+  RECORD_ENDPOINT = TUSB_DESC_CS_ENDPOINT,      // bEndpointAddress, number of jacks stored, baAssocJackID list
+  RECORD_AUDIO_ENTITY = TUSB_DESC_CS_INTERFACE, // bDescriptorSubtype, ID, wTerminalType, string index, bInterfaceProtocol
+};
+
+#define AUDIO_ENTITY_RECORD_LEN (2 + 6)
+
+// The most bytes a record takes
+#define MAX_RECORD_LEN (2 + 255)
+
+// UAC1 numbers its Processing Unit 7, where UAC2 has its Effect Unit
+#define UAC1_PROCESSING_UNIT 0x07
 
 // This descriptor follows the standard bulk data endpoint descriptor
 typedef struct
@@ -63,274 +76,2430 @@ typedef struct
   uint8_t baAssocJackID[];   ; ///< A list of associated jacks
 } midi_cs_desc_endpoint_t;
 
-static usb_midi_descriptor_info_t midi_host[CFG_TUH_MIDI] ;
+#if defined(LIB_PICO_TIME)
+static uint64_t default_time_us(void)
+{
+  return time_us_64();
+}
+#elif defined(__linux__)
+static uint64_t default_time_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+#else
+#define default_time_us NULL
+#endif
+
+static usb_midi_descriptor_lib_time_us_t time_source = default_time_us;
+
+// Record why the parse of device dev failed and where, unless a
+// deeper check already did. Return false so a TU_VERIFY can call it.
+static bool parse_error(usb_midi_descriptor_info_t* dev, usb_midi_descriptor_lib_error_t error)
+{
+  if (dev->stats.error == USB_MIDI_DESCRIPTOR_LIB_ERROR_NONE)
+  {
+    dev->stats.error = error;
+    dev->stats.error_offset = dev->stats.bytes;
+  }
+  return false;
+}
+
+// Count a descriptor the parse of device dev is done with
+static void visit(usb_midi_descriptor_info_t* dev, uint8_t const* p_desc)
+{
+  ++dev->stats.descriptors;
+  dev->stats.bytes += tu_desc_len(p_desc);
+}
+
+// Readers on other cores load the fields of a device before seq, and read
+// its block, while the writer may be changing them; read_retry() then has
+// them throw away what they read. So that those reads are not data races,
+// the writer changes the fields and the arena with relaxed atomic stores and
+// the readers read them with relaxed atomic loads, which compile to the same
+// instructions as plain loads and stores. Long copies go a pointer sized
+// word at a time where the shared side is aligned; a word load that overlaps
+// the writer's byte stores is still atomic on every target this library
+// runs on. The writer reads what only it writes with plain loads.
+#define STORE(field, value) atomic_store_explicit((_Atomic __typeof__(field)*)&(field), (value), memory_order_relaxed)
+#define LOAD(field) atomic_load_explicit((_Atomic __typeof__(field)*)&(field), memory_order_relaxed)
+
+static bool word_aligned(void const* p)
+{
+  return (uintptr_t)p % sizeof(uintptr_t) == 0;
+}
+
+static void store_byte(uint8_t* dest, uint8_t value)
+{
+  atomic_store_explicit((_Atomic uint8_t*)dest, value, memory_order_relaxed);
+}
+
+static void store_word(uint8_t* dest, uint8_t const* src)
+{
+  uintptr_t value;
+  memcpy(&value, src, sizeof(value));
+  atomic_store_explicit((_Atomic uintptr_t*)dest, value, memory_order_relaxed);
+}
+
+static void store_bytes(uint8_t* dest, uint8_t const* src, uint16_t len)
+{
+  uint16_t pos = 0;
+  for (; pos < len && !word_aligned(dest + pos); pos++)
+    store_byte(dest + pos, src[pos]);
+  for (; pos + sizeof(uintptr_t) <= len; pos += sizeof(uintptr_t))
+    store_word(dest + pos, src + pos);
+  for (; pos < len; pos++)
+    store_byte(dest + pos, src[pos]);
+}
+
+// memmove() with relaxed atomic stores; each word is read before it is stored
+static void move_bytes(uint8_t* dest, uint8_t const* src, uint16_t len)
+{
+  if (dest < src)
+    store_bytes(dest, src, len);
+  else
+  {
+    uint16_t end = len;
+    for (; end > 0 && !word_aligned(dest + end); end--)
+      store_byte(dest + end - 1, src[end - 1]);
+    for (; end >= sizeof(uintptr_t); end -= sizeof(uintptr_t))
+      store_word(dest + end - sizeof(uintptr_t), src + end - sizeof(uintptr_t));
+    for (; end > 0; end--)
+      store_byte(dest + end - 1, src[end - 1]);
+  }
+}
+
+static uint8_t load_byte(uint8_t const* src)
+{
+  return atomic_load_explicit((_Atomic uint8_t const*)src, memory_order_relaxed);
+}
+
+// Copy 2 or 4 aligned bytes at src + pos with one atomic load
+static void load_unit(uint8_t* dest, uint8_t const* src, uint16_t pos, uint8_t size)
+{
+  if (size == sizeof(uint16_t))
+  {
+    uint16_t value = atomic_load_explicit((_Atomic uint16_t const*)(src + pos), memory_order_relaxed);
+    memcpy(dest + pos, &value, sizeof(value));
+  }
+  else
+  {
+    uint32_t value = atomic_load_explicit((_Atomic uint32_t const*)(src + pos), memory_order_relaxed);
+    memcpy(dest + pos, &value, sizeof(value));
+  }
+}
+
+// Step up to word alignment and back down with at most one load of each
+// smaller size instead of a byte loop, which mispredicts as the offsets of
+// the tables in a block vary.
+static void load_bytes(uint8_t* dest, uint8_t const* src, uint16_t len)
+{
+  uint16_t pos = 0;
+  if (len >= sizeof(uintptr_t))
+  {
+    for (uint8_t size = 1; size < sizeof(uintptr_t); size *= 2)
+    {
+      if ((uintptr_t)(src + pos) & size)
+      {
+        if (size == 1)
+          dest[pos] = load_byte(src + pos);
+        else
+          load_unit(dest, src, pos, size);
+        pos += size;
+      }
+    }
+    for (; pos + sizeof(uintptr_t) <= len; pos += sizeof(uintptr_t))
+    {
+      uintptr_t value = atomic_load_explicit((_Atomic uintptr_t const*)(src + pos), memory_order_relaxed);
+      memcpy(dest + pos, &value, sizeof(value));
+    }
+    for (uint8_t size = sizeof(uintptr_t) / 2; size > 1; size /= 2)
+    {
+      if (pos + size <= len)
+      {
+        load_unit(dest, src, pos, size);
+        pos += size;
+      }
+    }
+  }
+  for (; pos < len; pos++)
+    dest[pos] = load_byte(src + pos);
+}
+
+// load_bytes() for the fields before seq. A device is aligned for its
+// pointers, so the words need no alignment checks and each pointer is copied
+// whole, which lets a getter's load of it be forwarded from the store.
+_Static_assert(SNAPSHOT_LEN % sizeof(uint32_t) == 0, "the snapshot must be whole words");
+
+static void load_snapshot(usb_midi_descriptor_info_t* info, const usb_midi_descriptor_info_t* dev)
+{
+  size_t pos = 0;
+  for (; pos + sizeof(uintptr_t) <= SNAPSHOT_LEN; pos += sizeof(uintptr_t))
+  {
+    uintptr_t value = atomic_load_explicit((_Atomic uintptr_t const*)((uint8_t const*)dev + pos), memory_order_relaxed);
+    memcpy((uint8_t*)info + pos, &value, sizeof(value));
+  }
+  for (; pos < SNAPSHOT_LEN; pos += sizeof(uint32_t))
+  {
+    uint32_t value = atomic_load_explicit((_Atomic uint32_t const*)((uint8_t const*)dev + pos), memory_order_relaxed);
+    memcpy((uint8_t*)info + pos, &value, sizeof(value));
+  }
+}
+
+static void count(uint8_t* counter)
+{
+  if (*counter < 0xFF)
+    STORE(*counter, *counter + 1);
+}
+
+// count() n times at once
+static void count_n(uint8_t* counter, unsigned n)
+{
+  STORE(*counter, n < 0xFFu - *counter ? (uint8_t)(*counter + n) : 0xFF);
+}
+
+// A device's sequence number is odd while the writer changes anything a
+// reader of the configured device relies on: resetting the device, marking
+// it configured or moving its block. A device that is being parsed is not
+// configured, and the getters return nothing from a device that is not, so
+// the parse itself does not need to change the number.
+// There is one writer, the code that calls the init, configure and restore
+// functions; any other core may call the getters.
+static void write_begin(usb_midi_descriptor_info_t* dev)
+{
+  unsigned seq = atomic_load_explicit(&dev->seq, memory_order_relaxed);
+  atomic_store_explicit(&dev->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(usb_midi_descriptor_info_t* dev)
+{
+  unsigned seq = atomic_load_explicit(&dev->seq, memory_order_relaxed);
+  atomic_store_explicit(&dev->seq, seq + 1, memory_order_release);
+}
+
+// Wait until the writer is not changing device dev and return its sequence
+// number to pass to read_retry(). The reader then loads the fields it needs;
+// it checks them with read_retry() before it reads the block they locate.
+static unsigned read_begin(const usb_midi_descriptor_info_t* dev)
+{
+  unsigned seq;
+  while ((seq = atomic_load_explicit(&dev->seq, memory_order_acquire)) & 1)
+    ;
+  return seq;
+}
+
+// Return true if the writer changed device dev, and with it possibly
+// the device's block, since read_begin() returned seq
+static bool read_retry(const usb_midi_descriptor_info_t* dev, unsigned seq)
+{
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&dev->seq, memory_order_relaxed) != seq;
+}
+
+// Copy the part of device dev the getters read to *info at a moment the
+// writer was not changing it, for the readers that need most of it. Return
+// the sequence number to pass to read_retry().
+static unsigned read_snapshot(const usb_midi_descriptor_info_t* dev, usb_midi_descriptor_info_t* info)
+{
+  for (;;)
+  {
+    unsigned seq = read_begin(dev);
+    load_snapshot(info, dev);
+    if (!read_retry(dev, seq))
+      return seq;
+  }
+}
+
+// Mark configured device dev configured for readers
+static void publish(usb_midi_descriptor_info_t* dev)
+{
+  write_begin(dev);
+  STORE(dev->configured, true);
+  write_end(dev);
+}
 
-void usb_midi_descriptor_lib_init(uint8_t idx)
+// The blocks of an arena's devices are packed together from the start of its
+// bytes, and every device that has a block is on the arena's block list, in
+// arena order, linked through next_block. Nothing locks an arena: the writer
+// of all of its devices is the only code that changes it.
+
+// Release the block of device dev and slide the blocks above it down. A
+// device that is not in the block list has no block, whatever its fields say.
+static void arena_free(usb_midi_descriptor_info_t* dev)
+{
+  usb_midi_descriptor_lib_arena_t* arena = dev->arena;
+  if (arena == NULL)
+    return;
+  usb_midi_descriptor_info_t** link = &arena->first_block;
+  while (*link != NULL && *link != dev)
+    link = &(*link)->next_block;
+  if (*link == NULL)
+    return;
+  *link = dev->next_block;
+  uint16_t offset = dev->arena_offset;
+  uint16_t len = dev->arena_len;
+  // The blocks above this one move down
+  for (usb_midi_descriptor_info_t* other = dev->next_block; other != NULL; other = other->next_block)
+    write_begin(other);
+  move_bytes(arena->bytes + offset, arena->bytes + offset + len, arena->used - offset - len);
+  arena->used -= len;
+  for (usb_midi_descriptor_info_t* other = dev->next_block; other != NULL; other = other->next_block)
+  {
+    STORE(other->arena_offset, other->arena_offset - len);
+    STORE(other->block, arena->bytes + other->arena_offset);
+    write_end(other);
+  }
+  STORE(dev->arena_len, 0);
+  dev->next_block = NULL;
+}
+
+// Append len bytes to the block of device dev, sliding the blocks above it up.
+// Return a pointer to the new bytes or NULL if the device has no arena or the arena is full.
+static uint8_t* arena_grow(usb_midi_descriptor_info_t* dev, uint16_t len)
+{
+  usb_midi_descriptor_lib_arena_t* arena = dev->arena;
+  TU_VERIFY((arena != NULL && len <= arena->size - arena->used) || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_ARENA_FULL), NULL);
+  if (dev->arena_len == 0)
+  {
+    // A new block goes at the end of the arena and of the block list
+    STORE(dev->arena_offset, arena->used);
+    STORE(dev->block, arena->bytes + arena->used);
+    dev->next_block = NULL;
+    usb_midi_descriptor_info_t** link = &arena->first_block;
+    while (*link != NULL && *link != dev)
+      link = &(*link)->next_block;
+    *link = dev;
+  }
+  uint16_t end = dev->arena_offset + dev->arena_len;
+  if (end != arena->used)
+  {
+    // Another device was configured after this one started; its block moves up
+    for (usb_midi_descriptor_info_t* other = dev->next_block; other != NULL; other = other->next_block)
+      write_begin(other);
+    move_bytes(arena->bytes + end + len, arena->bytes + end, arena->used - end);
+    for (usb_midi_descriptor_info_t* other = dev->next_block; other != NULL; other = other->next_block)
+    {
+      STORE(other->arena_offset, other->arena_offset + len);
+      STORE(other->block, arena->bytes + other->arena_offset);
+      write_end(other);
+    }
+  }
+  arena->used += len;
+  STORE(dev->arena_len, dev->arena_len + len);
+  return arena->bytes + end;
+}
+
+// Append a record to the block of device dev. Return a pointer to its payload or NULL if the arena is full.
+static uint8_t* add_record(usb_midi_descriptor_info_t* dev, uint8_t type, uint8_t len)
 {
-  if (idx < CFG_TUH_MIDI)
-    memset(midi_host+idx, 0, sizeof(midi_host[0]));
+  uint8_t* record = arena_grow(dev, 2 + len);
+  if (record)
+  {
+    store_byte(record, type);
+    store_byte(record + 1, len);
+    record += 2;
+  }
+  return record;
 }
 
-bool usb_midi_descriptor_lib_configure_from_full(uint8_t idx, const uint8_t* full_config_descriptor)
+// Check that an element record payload of len bytes holds every field of
+// an Element descriptor; the field offsets depend on bNrInputPins and bElCapsSize
+static bool element_payload_ok(uint8_t const* payload, uint16_t len)
 {
-  if (idx >= CFG_TUH_MIDI)
+  if (len < 7 || len < 7 + 2 * payload[1])
     return false;
-  tusb_desc_interface_t const *desc_itf = (tusb_desc_interface_t*)(tu_desc_next(full_config_descriptor));
-  uint16_t max_len = ((tusb_desc_configuration_t*)full_config_descriptor)->wTotalLength - tu_desc_len(full_config_descriptor);
-  midi_host[idx].num_string_indices = 0;
-  uint16_t len_parsed = 0;
-  while (len_parsed < max_len && TUSB_CLASS_AUDIO != desc_itf->bInterfaceClass)
+  return len >= 7 + 2 * payload[1] + payload[5 + 2 * payload[1]];
+}
+
+// Record a non-zero string index once. Only unique indices count against
+// MAX_STRING_INDICES; the sorted list is filled in from the bitmap at the
+// end of the parse.
+static void add_string_index(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t str_idx)
+{
+  uint8_t mask = 1 << (str_idx & 7);
+  uint8_t* bitmap_byte = ctx->string_index_bitmap + (str_idx >> 3);
+  if (str_idx == 0 || (*bitmap_byte & mask) != 0)
+    return;
+  if (ctx->num_strings < MAX_STRING_INDICES)
   {
-    len_parsed += tu_desc_len(desc_itf);
-    desc_itf = (tusb_desc_interface_t*)tu_desc_next(desc_itf);
+    *bitmap_byte |= mask;
+    ++ctx->num_strings;
   }
-  TU_VERIFY(len_parsed < max_len && TUSB_CLASS_AUDIO == desc_itf->bInterfaceClass);
-  TU_LOG2("Full interface descriptor:\r\n");
-  TU_LOG_MEM(2, desc_itf, max_len, 2);
+  else
+  {
+    count(&ctx->dev->stats.strings_dropped);
+  }
+}
+
+// Return where the string index of an Audio Control terminal, unit or clock
+// entity descriptor of len bytes is, or 0 if the descriptor has none or is too short
+static uint8_t audio_entity_str_pos(uint8_t const* p_desc, uint8_t len, bool uac2)
+{
+  uint8_t subtype = p_desc[2];
+  switch (subtype)
+  {
+    case AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL:
+      return len >= (uac2 ? 17 : 12) ? (uac2 ? 16 : 11) : 0;
+    case AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL:
+      return len >= (uac2 ? 12 : 9) ? (uac2 ? 11 : 8) : 0;
+    case AUDIO_CS_AC_INTERFACE_MIXER_UNIT:
+    case AUDIO_CS_AC_INTERFACE_SELECTOR_UNIT:
+    case AUDIO_CS_AC_INTERFACE_FEATURE_UNIT:
+      return len >= 6 ? len - 1 : 0;
+    default:
+      break;
+  }
+  if (!uac2)
+  {
+    if (subtype == UAC1_PROCESSING_UNIT)
+    {
+      // The process specific bytes follow iProcessing
+      uint16_t pins = len >= 7 ? p_desc[6] : 0xFF;
+      uint16_t pos = len >= 12 + pins ? 12 + pins + p_desc[11 + pins] : 0xFF;
+      return pos < len ? pos : 0;
+    }
+    return subtype == AUDIO_CS_AC_INTERFACE_PROCESSING_UNIT && len >= 6 ? len - 1 : 0; // the Extension Unit
+  }
+  if (subtype == AUDIO_CS_AC_INTERFACE_PROCESSING_UNIT)
+  {
+    uint16_t pos = len >= 7 ? 15 + p_desc[6] : 0xFF;
+    return pos < len ? pos : 0;
+  }
+  // The Effect and Extension Units and the clock entities end with their string index
+  return subtype >= AUDIO_CS_AC_INTERFACE_EFFECT_UNIT && subtype <= AUDIO_CS_AC_INTERFACE_SAMPLE_RATE_CONVERTER &&
+    len >= 6 ? len - 1 : 0;
+}
+
+// Keep an Audio Control terminal, unit or clock entity descriptor of len bytes;
+// skip every other descriptor. Return false if the arena is full.
+static bool parse_audio_control_descriptor(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t const* p_desc, uint8_t len)
+{
+  usb_midi_descriptor_info_t* dev = ctx->dev;
+  if (tu_desc_type(p_desc) != TUSB_DESC_CS_INTERFACE || len < 4 || dev->num_audio_entities == 0xFF)
+    return true;
+  uint8_t str_pos = audio_entity_str_pos(p_desc, len, ctx->ac_protocol == AUDIO_INT_PROTOCOL_CODE_V2);
+  if (str_pos == 0)
+    return true;
+  uint8_t* record = add_record(dev, RECORD_AUDIO_ENTITY, AUDIO_ENTITY_RECORD_LEN - 2);
+  TU_VERIFY(record != NULL);
+  bool terminal = p_desc[2] == AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL || p_desc[2] == AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL;
+  uint8_t const payload[AUDIO_ENTITY_RECORD_LEN - 2] = {
+    p_desc[2], p_desc[3], terminal ? p_desc[4] : 0, terminal ? p_desc[5] : 0, p_desc[str_pos], ctx->ac_protocol
+  };
+  store_bytes(record, payload, sizeof(payload));
+  add_string_index(ctx, p_desc[str_pos]);
+  STORE(dev->num_audio_entities, dev->num_audio_entities + 1);
+  return true;
+}
+
+void usb_midi_descriptor_lib_dev_init(usb_midi_descriptor_info_t* dev)
+{
+  if (dev != NULL)
+  {
+    write_begin(dev);
+    arena_free(dev);
+    for (uint16_t pos = 0; pos < SNAPSHOT_LEN; pos++)
+      store_byte((uint8_t*)dev + pos, 0);
+    write_end(dev);
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    dev->next_block = NULL;
+  }
+}
+
+void usb_midi_descriptor_lib_dev_set_arena(usb_midi_descriptor_info_t* dev, usb_midi_descriptor_lib_arena_t* arena)
+{
+  if (dev != NULL)
+  {
+    usb_midi_descriptor_lib_dev_init(dev);
+    dev->arena = arena;
+  }
+}
+
+// Start a new parse of device dev; this releases whatever the device held
+static void parse_ctx_init(usb_midi_descriptor_parse_ctx_t* ctx, usb_midi_descriptor_info_t* dev)
+{
+  // The jack and cable lists are written before they are read
+  ctx->dev = dev;
+  ctx->prev_ep_addr = 0;
+  ctx->num_strings = 0;
+  ctx->num_elements = 0;
+  ctx->element_id_first = 0xFF;
+  ctx->element_id_last = 0;
+  ctx->in_audio_control = false;
+  ctx->ac_protocol = 0;
+  memset(ctx->string_index_bitmap, 0, sizeof(ctx->string_index_bitmap));
+  usb_midi_descriptor_lib_dev_init(dev);
+  ctx->start_us = time_source ? time_source() : 0;
+}
+
+// Finish the statistics of a parse that ended with result ok and return ok
+static bool parse_end(usb_midi_descriptor_parse_ctx_t* ctx, bool ok)
+{
+  if (!ok)
+    parse_error(ctx->dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_BAD_DESCRIPTOR);
+  if (time_source)
+    ctx->dev->stats.parse_time_us = time_source() - ctx->start_us;
+  return ok;
+}
+
+void usb_midi_descriptor_lib_iter_init(usb_midi_descriptor_lib_iter_t* iter, const uint8_t* buf, uint32_t len)
+{
+  memset(iter, 0, sizeof(*iter));
+  iter->desc = buf;
+  iter->remaining = len;
+}
+
+bool usb_midi_descriptor_lib_iter_next(usb_midi_descriptor_lib_iter_t* iter)
+{
+  // The current descriptor was checked to fit, so this stays in the buffer.
+  // Every step moves at least 2 bytes, so a walk takes at most len / 2 steps.
+  iter->desc += iter->len;
+  iter->offset += iter->len;
+  iter->remaining -= iter->len;
+  iter->len = 0;
+  if (iter->malformed || iter->remaining == 0)
+    return false;
+  if (iter->remaining < 2 || iter->desc[0] < 2 || iter->desc[0] > iter->remaining)
+  {
+    iter->malformed = true;
+    return false;
+  }
+  iter->len = iter->desc[0];
+  iter->type = iter->desc[1];
+  iter->subtype = iter->len >= 3 ? iter->desc[2] : 0;
+  return true;
+}
+
+// Return true if the iterator is at an interface descriptor of the audio class and, unless subclass is 0, that subclass
+static bool at_audio_itf(usb_midi_descriptor_lib_iter_t const* iter, uint8_t subclass)
+{
+  tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*)iter->desc;
+  return iter->type == TUSB_DESC_INTERFACE && iter->len >= sizeof(tusb_desc_interface_t) &&
+    desc_itf->bInterfaceClass == TUSB_CLASS_AUDIO && (subclass == 0 || desc_itf->bInterfaceSubClass == subclass);
+}
+
+// Note whether the interface descriptor at the iterator starts an Audio Control interface
+static void enter_interface(usb_midi_descriptor_parse_ctx_t* ctx, usb_midi_descriptor_lib_iter_t const* iter)
+{
+  ctx->in_audio_control = at_audio_itf(iter, AUDIO_SUBCLASS_CONTROL);
+  if (ctx->in_audio_control)
+    ctx->ac_protocol = ((tusb_desc_interface_t const*)iter->desc)->bInterfaceProtocol;
+}
+
+static bool configure_midi(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t const *midi_descriptor, uint32_t max_len);
+
+// Find the MIDI Streaming interface in a full configuration descriptor and parse it
+static bool configure_full(usb_midi_descriptor_parse_ctx_t* ctx, const uint8_t* full_config_descriptor)
+{
+  usb_midi_descriptor_info_t* dev = ctx->dev;
+  usb_midi_descriptor_lib_iter_t iter;
+  usb_midi_descriptor_lib_iter_init(&iter, full_config_descriptor,
+    ((tusb_desc_configuration_t const*)full_config_descriptor)->wTotalLength);
+  TU_VERIFY(usb_midi_descriptor_lib_iter_next(&iter));
+  visit(dev, iter.desc);
   // There can be just a MIDI interface or an audio and a MIDI interface. Only open the MIDI interface
-  uint8_t const *p_desc = (uint8_t const *) desc_itf;
-  if (AUDIO_SUBCLASS_CONTROL == desc_itf->bInterfaceSubClass)
+  bool found = false;
+  while (!found && usb_midi_descriptor_lib_iter_next(&iter))
+  {
+    found = at_audio_itf(&iter, 0);
+    if (!found)
+      visit(dev, iter.desc);
+  }
+  TU_VERIFY(found || iter.malformed || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_MIDI_INTERFACE));
+  TU_VERIFY(found);
+  if (at_audio_itf(&iter, AUDIO_SUBCLASS_CONTROL))
   {
     // Keep track of any string descriptor that might be here
-    if (desc_itf->iInterface != 0 && midi_host[idx].num_string_indices < MAX_STRING_INDICES)
-      midi_host[idx].all_string_indices[midi_host[idx].num_string_indices++] = desc_itf->iInterface;
+    add_string_index(ctx, ((tusb_desc_interface_t const*)iter.desc)->iInterface);
     // If this is the audio control interface there might be a MIDI interface following it.
     // Search through every descriptor until a MIDI interface is found or the end of the descriptor is found
-    while (len_parsed < max_len && (desc_itf->bInterfaceClass != TUSB_CLASS_AUDIO || desc_itf->bInterfaceSubClass != AUDIO_SUBCLASS_MIDI_STREAMING))
+    // Keep the terminals, units and clock entities of the Audio Control interface on the way
+    found = false;
+    do
     {
-      len_parsed += desc_itf->bLength;
-      p_desc = tu_desc_next(p_desc);
-      desc_itf = (tusb_desc_interface_t const *)p_desc;
-    }
-
-    TU_VERIFY(TUSB_CLASS_AUDIO == desc_itf->bInterfaceClass);
+      found = at_audio_itf(&iter, AUDIO_SUBCLASS_MIDI_STREAMING);
+      if (!found)
+      {
+        if (iter.type == TUSB_DESC_INTERFACE)
+          enter_interface(ctx, &iter);
+        else if (ctx->in_audio_control)
+          TU_VERIFY(parse_audio_control_descriptor(ctx, iter.desc, iter.len));
+        visit(dev, iter.desc);
+      }
+    } while (!found && usb_midi_descriptor_lib_iter_next(&iter));
+    TU_VERIFY(found || iter.malformed || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_MIDI_INTERFACE));
+    TU_VERIFY(found);
   }
-  TU_VERIFY(AUDIO_SUBCLASS_MIDI_STREAMING == desc_itf->bInterfaceSubClass);
-  return usb_midi_descriptor_lib_configure(idx, p_desc, max_len - len_parsed);
+  TU_VERIFY(at_audio_itf(&iter, AUDIO_SUBCLASS_MIDI_STREAMING) || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_MIDI_INTERFACE));
+  TU_LOG2("Full interface descriptor:\r\n");
+  TU_LOG_MEM(2, iter.desc, iter.remaining, 2);
+  return configure_midi(ctx, iter.desc, iter.remaining);
 }
 
-bool usb_midi_descriptor_lib_configure(uint8_t idx, uint8_t const *midi_descriptor, uint32_t max_len)
+bool usb_midi_descriptor_lib_dev_configure_from_full(usb_midi_descriptor_info_t* dev, const uint8_t* full_config_descriptor)
 {
-  if (idx >= CFG_TUH_MIDI)
+  if (dev == NULL)
     return false;
-  tusb_desc_interface_t const *desc_itf = (tusb_desc_interface_t*)(midi_descriptor);
-  // Keep track of any string descriptor that might be here
-  if (desc_itf->iInterface != 0 && midi_host[idx].num_string_indices < MAX_STRING_INDICES)
-      midi_host[idx].all_string_indices[midi_host[idx].num_string_indices++] = desc_itf->iInterface;
-  uint32_t len_parsed = desc_itf->bLength;
-  uint8_t const *p_desc = tu_desc_next(midi_descriptor);
+  usb_midi_descriptor_parse_ctx_t ctx;
+  parse_ctx_init(&ctx, dev);
+  return parse_end(&ctx, configure_full(&ctx, full_config_descriptor));
+}
+
+// Verify the descriptor that follows the MIDI Streaming interface descriptor
+static bool verify_first_midi_descriptor(uint8_t const *p_desc)
+{
   // Find out if getting the MIDI class specific interface header or an endpoint descriptor
   // or a class-specific endpoint descriptor
-  // Jack descriptors or element descriptors must follow the cs interface header,
-  // but this driver does not support devices that contain element descriptors
+  // Jack descriptors or element descriptors must follow the cs interface header
+  midi_desc_header_t const *p_mdh = (midi_desc_header_t const *)p_desc;
+  return (p_mdh->bDescriptorType == TUSB_DESC_CS_INTERFACE && p_mdh->bDescriptorSubType == MIDI_CS_INTERFACE_HEADER) ||
+    (p_mdh->bDescriptorType == TUSB_DESC_CS_ENDPOINT && p_mdh->bDescriptorSubType == MIDI_CS_ENDPOINT_GENERAL) ||
+    p_mdh->bDescriptorType == TUSB_DESC_ENDPOINT;
+}
 
-  // assume it is an interface header
+// Parse one descriptor from the MIDI Streaming interface into device ctx->dev.
+// ctx->prev_ep_addr is the address of the most recent endpoint descriptor; the CS
+// endpoint descriptor is associated with the previous endpoint descriptor.
+static bool parse_midi_descriptor(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t const *p_desc)
+{
+  usb_midi_descriptor_info_t* dev = ctx->dev;
   midi_desc_header_t const *p_mdh = (midi_desc_header_t const *)p_desc;
-  TU_VERIFY((p_mdh->bDescriptorType == TUSB_DESC_CS_INTERFACE && p_mdh->bDescriptorSubType == MIDI_CS_INTERFACE_HEADER) || 
+  // Every descriptor is checked to be long enough for the fields read from it
+  TU_VERIFY(p_mdh->bLength >= 3);
+  TU_VERIFY((p_mdh->bDescriptorType == TUSB_DESC_CS_INTERFACE) ||
     (p_mdh->bDescriptorType == TUSB_DESC_CS_ENDPOINT && p_mdh->bDescriptorSubType == MIDI_CS_ENDPOINT_GENERAL) ||
     p_mdh->bDescriptorType == TUSB_DESC_ENDPOINT);
 
-  uint8_t prev_ep_addr = 0; // the CS endpoint descriptor is associated with the previous endpoint descrptor
-  while (len_parsed < max_len)
-  {
-    TU_VERIFY((p_mdh->bDescriptorType == TUSB_DESC_CS_INTERFACE) || 
-      (p_mdh->bDescriptorType == TUSB_DESC_CS_ENDPOINT && p_mdh->bDescriptorSubType == MIDI_CS_ENDPOINT_GENERAL) ||
-      p_mdh->bDescriptorType == TUSB_DESC_ENDPOINT);
-
-    if (p_mdh->bDescriptorType == TUSB_DESC_CS_INTERFACE) {
-      // The USB host doesn't really need this information unless it uses
-      // the string descriptor for a jack or Element
+  if (p_mdh->bDescriptorType == TUSB_DESC_CS_INTERFACE) {
+    // The USB host doesn't really need this information unless it uses
+    // the string descriptor for a jack or Element
 
-      // assume it is an input jack
-      midi_desc_in_jack_t const *p_mdij = (midi_desc_in_jack_t const *)p_desc;
-      if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_HEADER)
-      {
-        TU_LOG2("Found MIDI Interface Header\r\n");
-      }
-      else if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_IN_JACK)
-      {
-        // Then it is an in jack. 
-        TU_LOG2("Found in jack %u\r\n", p_mdij->bJackID);
-        if (midi_host[idx].next_in_jack < MAX_IN_JACKS)
-        {
-          midi_host[idx].in_jack_info[midi_host[idx].next_in_jack].jack_id = p_mdij->bJackID;
-          midi_host[idx].in_jack_info[midi_host[idx].next_in_jack].jack_type = p_mdij->bJackType;
-          midi_host[idx].in_jack_info[midi_host[idx].next_in_jack].string_index = p_mdij->iJack;
-          ++midi_host[idx].next_in_jack;
-          // Keep track of any string descriptor that might be here
-          if (p_mdij->iJack != 0 && midi_host[idx].num_string_indices < MAX_STRING_INDICES)
-            midi_host[idx].all_string_indices[midi_host[idx].num_string_indices++] = p_mdij->iJack;
-        }
-      }
-      else if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_OUT_JACK)
-      {
-        // then it is an out jack
-        TU_LOG2("Found out jack %u\r\n", p_mdij->bJackID);
-        if (midi_host[idx].next_out_jack < MAX_OUT_JACKS)
-        {
-          midi_desc_out_jack_t const *p_mdoj = (midi_desc_out_jack_t const *)p_desc;
-          midi_host[idx].out_jack_info[midi_host[idx].next_out_jack].jack_id = p_mdoj->bJackID;
-          midi_host[idx].out_jack_info[midi_host[idx].next_out_jack].jack_type = p_mdoj->bJackType;
-          midi_host[idx].out_jack_info[midi_host[idx].next_out_jack].num_source_ids = p_mdoj->bNrInputPins;
-          const struct associated_jack_s {
-              uint8_t id;
-              uint8_t pin;
-          } *associated_jack = (const struct associated_jack_s *)(p_desc+6);
-          int jack;
-          for (jack = 0; jack < p_mdoj->bNrInputPins; jack++)
-          {
-            midi_host[idx].out_jack_info[midi_host[idx].next_out_jack].source_ids[jack] = associated_jack->id;
-          }
-          midi_host[idx].out_jack_info[midi_host[idx].next_out_jack].string_index = *(p_desc+6+p_mdoj->bNrInputPins*2);
-          ++midi_host[idx].next_out_jack;
-          if (p_mdoj->iJack != 0 && midi_host[idx].num_string_indices < MAX_STRING_INDICES)
-            midi_host[idx].all_string_indices[midi_host[idx].num_string_indices++] = p_mdoj->iJack;
-        }
-      }
-      else if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_ELEMENT)
-      {
-        // the it is an element; collect its string index if there is one
-        const uint8_t* element_descriptor = (const uint8_t*)p_mdij;
-        uint8_t idx= element_descriptor[element_descriptor[0]-1];
-        if (idx > 0 && midi_host[idx].num_string_indices < MAX_STRING_INDICES)
-          midi_host[idx].all_string_indices[midi_host[idx].num_string_indices++] = idx;
-        TU_LOG2("Found element\r\n");
-      }
-      else
-      {
-        TU_LOG2("Unknown CS Interface sub-type %u\r\n", p_mdij->bDescriptorSubType);
-        TU_VERIFY(false); // unknown CS Interface sub-type
-      }
-      len_parsed += p_mdij->bLength;
+    // assume it is an input jack
+    midi_desc_in_jack_t const *p_mdij = (midi_desc_in_jack_t const *)p_desc;
+    if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_HEADER)
+    {
+      TU_LOG2("Found MIDI Interface Header\r\n");
     }
-    else if (p_mdh->bDescriptorType == TUSB_DESC_CS_ENDPOINT)
+    else if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_IN_JACK)
     {
-      TU_LOG2("found CS_ENDPOINT Descriptor for %02x\r\n", prev_ep_addr);
-      TU_VERIFY(prev_ep_addr != 0);
-      // parse out the mapping between the device's embedded jacks and the endpoints
-      // Each embedded IN jack is assocated with an OUT endpoint
-      midi_cs_desc_endpoint_t const* p_csep = (midi_cs_desc_endpoint_t const*)p_mdh;
-      if (tu_edpt_dir(prev_ep_addr) == TUSB_DIR_OUT)
-      {
-        TU_VERIFY(midi_host[idx].ep_out == prev_ep_addr);
-        TU_VERIFY(midi_host[idx].num_cables_tx == 0);
-        midi_host[idx].num_cables_tx = p_csep->bNumEmbMIDIJack;
-        uint8_t jack;
-        uint8_t max_jack = midi_host[idx].num_cables_tx;
-        if (max_jack > sizeof(midi_host[idx].ep_out_associated_jacks))
-        {
-            max_jack = sizeof(midi_host[idx].ep_out_associated_jacks);
-        }
-        for (jack = 0; jack < max_jack; jack++)
-        {
-          midi_host[idx].ep_out_associated_jacks[jack] = p_csep->baAssocJackID[jack];
-        }
-      }
-      else
-      {
-        TU_VERIFY(midi_host[idx].ep_in == prev_ep_addr);
-        TU_VERIFY(midi_host[idx].num_cables_rx == 0);
-        midi_host[idx].num_cables_rx = p_csep->bNumEmbMIDIJack;
-        uint8_t jack;
-        uint8_t max_jack = midi_host[idx].num_cables_rx;
-        if (max_jack > sizeof(midi_host[idx].ep_in_associated_jacks))
-        {
-            max_jack = sizeof(midi_host[idx].ep_in_associated_jacks);
-        }
-        for (jack = 0; jack < max_jack; jack++)
-        {
-          midi_host[idx].ep_in_associated_jacks[jack] = p_csep->baAssocJackID[jack];
-        }
-      }
-      len_parsed += p_csep->bLength;
-      prev_ep_addr = 0;
-    }
-    else if (p_mdh->bDescriptorType == TUSB_DESC_ENDPOINT) {
-      // parse out the bulk endpoint info
-      tusb_desc_endpoint_t *p_ep = (tusb_desc_endpoint_t *)p_mdh;
-      TU_LOG2("found ENDPOINT Descriptor %02x\r\n", p_ep->bEndpointAddress);
-      if (tu_edpt_dir(p_ep->bEndpointAddress) == TUSB_DIR_OUT)
-      {
-        TU_VERIFY(midi_host[idx].ep_out == 0);
-        TU_VERIFY(midi_host[idx].num_cables_tx == 0);
-        midi_host[idx].ep_out = p_ep->bEndpointAddress;
-        prev_ep_addr = midi_host[idx].ep_out;
-      }
-      else
+      // Then it is an in jack. 
+      TU_LOG2("Found in jack %u\r\n", p_mdij->bJackID);
+      TU_VERIFY(p_mdij->bLength >= sizeof(midi_desc_in_jack_t));
+      // Every jack gets a record so cable routes can pass through it
+      uint8_t* record = add_record(dev, RECORD_IN_JACK, 3);
+      TU_VERIFY(record != NULL);
+      store_byte(record, p_mdij->bJackID);
+      store_byte(record + 1, p_mdij->bJackType);
+      store_byte(record + 2, p_mdij->iJack);
+      // Keep track of any string descriptor that might be here
+      add_string_index(ctx, p_mdij->iJack);
+      count(&dev->stats.num_in_jacks);
+      count(&dev->num_in_jacks);
+    }
+    else if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_OUT_JACK)
+    {
+      // then it is an out jack
+      TU_LOG2("Found out jack %u\r\n", p_mdij->bJackID);
+      midi_desc_out_jack_t const *p_mdoj = (midi_desc_out_jack_t const *)p_desc;
+      TU_VERIFY(p_mdoj->bLength >= 7);
+      uint8_t num_pins = p_mdoj->bNrInputPins;
+      TU_VERIFY(p_mdoj->bLength >= 7 + 2 * num_pins);
+      uint8_t* record = add_record(dev, RECORD_OUT_JACK, 4 + 2 * num_pins);
+      TU_VERIFY(record != NULL);
+      store_byte(record, p_mdoj->bJackID);
+      store_byte(record + 1, p_mdoj->bJackType);
+      store_byte(record + 2, p_desc[6 + 2 * num_pins]); // iJack follows the source ID and pin pairs
+      store_byte(record + 3, num_pins);
+      store_bytes(record + 4, p_desc + 6, 2 * num_pins);
+      add_string_index(ctx, record[2]);
+      count(&dev->stats.num_out_jacks);
+      count(&dev->num_out_jacks);
+    }
+    else if (p_mdij->bDescriptorSubType == MIDI_CS_INTERFACE_ELEMENT)
+    {
+      // the it is an element; keep all of it and collect its string index if there is one
+      const uint8_t* element_descriptor = (const uint8_t*)p_mdij;
+      TU_VERIFY(element_descriptor[0] > 3 && element_payload_ok(element_descriptor + 3, element_descriptor[0] - 3));
+      uint8_t* record = add_record(dev, RECORD_ELEMENT, element_descriptor[0] - 3);
+      TU_VERIFY(record != NULL);
+      store_bytes(record, element_descriptor + 3, element_descriptor[0] - 3);
+      uint8_t num_pins = record[1];
+      add_string_index(ctx, record[6 + 2 * num_pins + record[5 + 2 * num_pins]]); // iElement follows bmElementCaps
+      // Only the first 255 elements are indexed
+      if (ctx->num_elements < 0xFF)
       {
-        TU_VERIFY(midi_host[idx].ep_in == 0);
-        TU_VERIFY(midi_host[idx].num_cables_rx == 0);
-        midi_host[idx].ep_in = p_ep->bEndpointAddress;
-        prev_ep_addr = midi_host[idx].ep_in;
+        ++ctx->num_elements;
+        dev->stats.num_elements = ctx->num_elements;
+        ctx->element_id_first = record[0] < ctx->element_id_first ? record[0] : ctx->element_id_first;
+        ctx->element_id_last = record[0] > ctx->element_id_last ? record[0] : ctx->element_id_last;
       }
-      len_parsed += p_mdh->bLength;
+      TU_LOG2("Found element %u\r\n", record[0]);
+    }
+    else
+    {
+      TU_LOG2("Unknown CS Interface sub-type %u\r\n", p_mdij->bDescriptorSubType);
+      TU_VERIFY(false); // unknown CS Interface sub-type
     }
-    p_desc = tu_desc_next(p_desc);
-    p_mdh = (midi_desc_header_t const *)p_desc;
   }
-  TU_LOG2("ep_out=%u num_cables_tx=%u ep_in=%u num_cables_rx=%u\r\n",midi_host.ep_out, midi_host.num_cables_tx, midi_host.ep_in, midi_host.num_cables_rx);
-  TU_VERIFY((midi_host[idx].ep_out != 0 && midi_host[idx].num_cables_tx != 0) ||
-            (midi_host[idx].ep_in != 0 && midi_host[idx].num_cables_rx != 0));
-  TU_LOG2("MIDI descriptor parsed successfully\r\n");
-  // remove duplicate string indices
-  for (int idx=0; idx < midi_host[idx].num_string_indices; idx++) {
-      for (int jdx = idx+1; jdx < midi_host[idx].num_string_indices; jdx++) {
-          while (jdx < midi_host[idx].num_string_indices && midi_host[idx].all_string_indices[idx] == midi_host[idx].all_string_indices[jdx]) {
-              // delete the duplicate by overwriting it with the last entry and reducing the number of entries by 1
-              midi_host[idx].all_string_indices[jdx] = midi_host[idx].all_string_indices[midi_host[idx].num_string_indices-1];
-              --midi_host[idx].num_string_indices;
-          }
-      }
+  else if (p_mdh->bDescriptorType == TUSB_DESC_CS_ENDPOINT)
+  {
+    TU_LOG2("found CS_ENDPOINT Descriptor for %02x\r\n", ctx->prev_ep_addr);
+    TU_VERIFY(ctx->prev_ep_addr != 0);
+    // parse out the mapping between the device's embedded jacks and the endpoints
+    // Each embedded IN jack is assocated with an OUT endpoint
+    midi_cs_desc_endpoint_t const* p_csep = (midi_cs_desc_endpoint_t const*)p_mdh;
+    usb_midi_descriptor_lib_ep_info_t* ep_info;
+    uint8_t* cable_jack_ids;
+    uint8_t* num_cables;
+    uint8_t max_cables;
+    if (tu_edpt_dir(ctx->prev_ep_addr) == TUSB_DIR_OUT)
+    {
+      ep_info = dev->out_eps + dev->num_out_eps - 1;
+      cable_jack_ids = ctx->out_cable_jack_ids;
+      num_cables = &dev->num_out_cables;
+      max_cables = MAX_OUT_CABLES;
+    }
+    else
+    {
+      ep_info = dev->in_eps + dev->num_in_eps - 1;
+      cable_jack_ids = ctx->in_cable_jack_ids;
+      num_cables = &dev->num_in_cables;
+      max_cables = MAX_IN_CABLES;
+    }
+    TU_VERIFY(ep_info->ep_addr == ctx->prev_ep_addr);
+    TU_VERIFY(ep_info->num_cables == 0);
+    TU_VERIFY(p_csep->bLength >= 4 && p_csep->bLength >= 4 + p_csep->bNumEmbMIDIJack);
+    // Only the cables that fit in the cable tables are kept, and the endpoint
+    // reports only those
+    uint8_t num_jacks = p_csep->bNumEmbMIDIJack;
+    if (num_jacks > max_cables - *num_cables)
+    {
+      count_n(&dev->stats.cables_dropped, num_jacks - (max_cables - *num_cables));
+      num_jacks = max_cables - *num_cables;
+    }
+    STORE(ep_info->num_cables, num_jacks);
+    STORE(ep_info->first_cable, *num_cables);
+    uint8_t* record = add_record(dev, RECORD_ENDPOINT, 2 + num_jacks);
+    TU_VERIFY(record != NULL);
+    store_byte(record, ctx->prev_ep_addr);
+    store_byte(record + 1, num_jacks);
+    store_bytes(record + 2, p_csep->baAssocJackID, num_jacks);
+    memcpy(cable_jack_ids + *num_cables, p_csep->baAssocJackID, num_jacks);
+    STORE(*num_cables, *num_cables + num_jacks);
+    ctx->prev_ep_addr = 0;
+  }
+  else if (p_mdh->bDescriptorType == TUSB_DESC_ENDPOINT) {
+    // parse out the bulk endpoint info
+    tusb_desc_endpoint_t *p_ep = (tusb_desc_endpoint_t *)p_mdh;
+    TU_VERIFY(p_ep->bLength >= sizeof(tusb_desc_endpoint_t));
+    TU_LOG2("found ENDPOINT Descriptor %02x\r\n", p_ep->bEndpointAddress);
+    if (tu_edpt_dir(p_ep->bEndpointAddress) == TUSB_DIR_OUT)
+    {
+      TU_VERIFY(dev->num_out_eps < MAX_OUT_ENDPOINTS || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_MANY_ENDPOINTS));
+      STORE(dev->out_eps[dev->num_out_eps].ep_addr, p_ep->bEndpointAddress);
+      STORE(dev->num_out_eps, dev->num_out_eps + 1);
+    }
+    else
+    {
+      TU_VERIFY(dev->num_in_eps < MAX_IN_ENDPOINTS || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_MANY_ENDPOINTS));
+      STORE(dev->in_eps[dev->num_in_eps].ep_addr, p_ep->bEndpointAddress);
+      STORE(dev->num_in_eps, dev->num_in_eps + 1);
+    }
+    ctx->prev_ep_addr = p_ep->bEndpointAddress;
   }
-  midi_host[idx].configured = true;
-  TU_LOG2("MIDI String descriptors parsed successfully\r\n");
   return true;
 }
 
-int usb_midi_descriptor_lib_get_all_str_inidices(uint8_t idx, const uint8_t** inidices)
+// Routes through more elements than this are not followed
+#define MAX_ROUTE_DEPTH 8
+
+// Point *sources at the baSourceID/baSourcePin pairs of an OUT jack or element
+// record. Return the number of pairs; other records have none.
+static uint8_t record_sources(uint8_t const* record, uint8_t const** sources)
 {
-  if (idx >= CFG_TUH_MIDI)
-    return -1;
-  uint8_t nstrings = -1;
-  if (midi_host[idx].configured)
+  if (record[0] == RECORD_OUT_JACK)
   {
-    nstrings = midi_host[idx].num_string_indices;
-    if (nstrings)
-      *inidices = midi_host[idx].all_string_indices;
+    *sources = record + 2 + 4;
+    return record[2 + 3];
   }
-  return nstrings;
+  if (record[0] == RECORD_ELEMENT)
+  {
+    *sources = record + 2 + 2;
+    return record[2 + 1];
+  }
+  return 0;
 }
 
-int usb_midi_descriptor_lib_get_str_idx_for_in_cable(uint8_t idx, uint8_t in_cable_num)
+// Set ext_in[id] to the ID of an external IN jack that feeds jack or element id,
+// or 0 if none does. The first walk finds the external IN jacks and each later
+// walk carries them one more jack or element downstream, so it does not matter
+// what order the device lists them in. A walk that changes nothing, or one walk
+// per element, ends the search.
+static void route_upstream(uint8_t const* records, uint8_t const* records_end, uint8_t* ext_in)
 {
-  if (idx >= CFG_TUH_MIDI)
-    return 0;
-  if (in_cable_num >= midi_host[idx].num_cables_rx)
-    return 0;
-  uint8_t jack_id = midi_host[idx].ep_in_associated_jacks[in_cable_num];
-  // The jacks associated with an IN endpoint will be embedded OUT jacks
-  for (uint8_t jack_idx = 0; jack_idx < midi_host[idx].next_out_jack; jack_idx++)
+  memset(ext_in, 0, 256);
+  uint8_t num_elements = 0;
+  for (uint8_t const* record = records; record < records_end; record += 2 + record[1])
+  {
+    if (record[0] == RECORD_IN_JACK && record[2 + 1] == MIDI_JACK_EXTERNAL)
+      ext_in[record[2]] = record[2];
+    else if (record[0] == RECORD_ELEMENT && num_elements < MAX_ROUTE_DEPTH)
+      ++num_elements;
+  }
+  bool changed = true;
+  for (uint8_t pass = 0; changed && pass <= num_elements; pass++)
   {
-    if (midi_host[idx].out_jack_info[jack_idx].jack_id == jack_id) {
-      return midi_host[idx].out_jack_info[jack_idx].string_index;
+    changed = false;
+    for (uint8_t const* record = records; record < records_end; record += 2 + record[1])
+    {
+      uint8_t const* sources;
+      uint8_t num_pins = record_sources(record, &sources);
+      for (uint8_t pin = 0; pin < num_pins && ext_in[record[2]] == 0; pin++)
+      {
+        ext_in[record[2]] = ext_in[sources[2 * pin]];
+        changed = changed || ext_in[record[2]] != 0;
+      }
     }
   }
-  return 0;
 }
 
-int usb_midi_descriptor_lib_get_str_idx_for_out_cable(uint8_t idx, uint8_t out_cable_num)
+// Set ext_out[id] to the ID of an external OUT jack that jack or element id
+// feeds, or 0 if it feeds none. The first walk gives the sources of each
+// external OUT jack their route and each later walk carries the routes one
+// more element upstream, the same way route_upstream() ends.
+static void route_downstream(uint8_t const* records, uint8_t const* records_end, uint8_t* ext_out)
 {
-  if (idx >= CFG_TUH_MIDI)
+  memset(ext_out, 0, 256);
+  uint8_t num_elements = 0;
+  for (uint8_t const* record = records; record < records_end; record += 2 + record[1])
+  {
+    uint8_t const* sources;
+    uint8_t num_pins = record_sources(record, &sources);
+    if (record[0] == RECORD_OUT_JACK && record[2 + 1] == MIDI_JACK_EXTERNAL)
+    {
+      // The first external OUT jack in descriptor order wins
+      for (uint8_t pin = 0; pin < num_pins; pin++)
+      {
+        if (ext_out[sources[2 * pin]] == 0)
+          ext_out[sources[2 * pin]] = record[2];
+      }
+    }
+    else if (record[0] == RECORD_ELEMENT && num_elements < MAX_ROUTE_DEPTH)
+      ++num_elements;
+  }
+  // An embedded OUT jack leads back to the host, so only elements pass routes on
+  bool changed = true;
+  for (uint8_t pass = 0; changed && pass < num_elements; pass++)
+  {
+    changed = false;
+    for (uint8_t const* record = records; record < records_end; record += 2 + record[1])
+    {
+      uint8_t const* sources;
+      uint8_t num_pins = record[0] == RECORD_ELEMENT ? record_sources(record, &sources) : 0;
+      uint8_t ext_jack_id = ext_out[record[2]];
+      for (uint8_t pin = 0; pin < num_pins && ext_jack_id != 0; pin++)
+      {
+        if (ext_out[sources[2 * pin]] == 0)
+        {
+          ext_out[sources[2 * pin]] = ext_jack_id;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+// Set str_idx[id] to the iJack of each jack record of type jack_record, and to 0 for other IDs
+static void index_jack_str_idx(uint8_t const* records, uint8_t const* records_end, uint8_t jack_record, uint8_t* str_idx)
+{
+  memset(str_idx, 0, 256);
+  for (uint8_t const* record = records; record < records_end; record += 2 + record[1])
+  {
+    if (record[0] == jack_record)
+      str_idx[record[2]] = record[2 + 2];
+  }
+}
+
+// Fill in the string index of each route's external jack. by_id is scratch space.
+static void set_route_str_idx(uint8_t const* records, uint8_t const* records_end, uint8_t* by_id, uint8_t* routes, uint16_t num_routes)
+{
+  memset(by_id, 0, 256);
+  for (uint8_t const* record = records; record < records_end; record += 2 + record[1])
+  {
+    if ((record[0] == RECORD_IN_JACK || record[0] == RECORD_OUT_JACK) && record[2 + 1] == MIDI_JACK_EXTERNAL)
+      by_id[record[2]] = record[2 + 2]; // iJack
+  }
+  for (uint16_t route = 0; route < num_routes; route++)
+    store_byte(routes + 2 * route + 1, by_id[routes[2 * route]]);
+}
+
+// Verify the parsed MIDI Streaming interface and append the lookup tables the getters use
+static bool finish_configure(usb_midi_descriptor_parse_ctx_t* ctx)
+{
+  usb_midi_descriptor_info_t* dev = ctx->dev;
+  bool has_cables = false;
+  for (uint8_t ep = 0; ep < dev->num_out_eps; ep++)
+  {
+    TU_LOG2("ep_out=%u num_cables_tx=%u\r\n", dev->out_eps[ep].ep_addr, dev->out_eps[ep].num_cables);
+    has_cables = has_cables || dev->out_eps[ep].num_cables != 0;
+  }
+  for (uint8_t ep = 0; ep < dev->num_in_eps; ep++)
+  {
+    TU_LOG2("ep_in=%u num_cables_rx=%u\r\n", dev->in_eps[ep].ep_addr, dev->in_eps[ep].num_cables);
+    has_cables = has_cables || dev->in_eps[ep].num_cables != 0;
+  }
+  TU_VERIFY(has_cables || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_CABLES));
+  TU_LOG2("MIDI descriptor parsed successfully\r\n");
+  uint16_t tables = dev->arena_len;
+  uint16_t num_cables = dev->num_in_cables + dev->num_out_cables;
+  uint8_t num_elements = ctx->num_elements;
+  uint8_t element_id_first = ctx->element_id_first;
+  uint8_t element_id_last = ctx->element_id_last;
+  uint16_t directory_len = num_elements ? element_id_last - element_id_first + 1 : 0;
+  uint8_t* in_cable_str_idx = arena_grow(dev, 3 * num_cables + ctx->num_strings + 2 * num_elements + directory_len);
+  TU_VERIFY(in_cable_str_idx != NULL);
+  uint8_t* out_cable_str_idx = in_cable_str_idx + dev->num_in_cables;
+  uint8_t* all_string_indices = out_cable_str_idx + dev->num_out_cables;
+  uint8_t* in_cable_routes = all_string_indices + ctx->num_strings;
+  uint8_t* out_cable_routes = in_cable_routes + 2 * dev->num_in_cables;
+  uint8_t const* records = dev->block;
+  uint8_t const* records_end = records + tables;
+  // List the unique string indices in ascending order; stop at the byte with the largest index
+  uint8_t num_strings = 0;
+  for (uint8_t byte_idx = 0; num_strings < ctx->num_strings; byte_idx++)
+  {
+    uint8_t bits = ctx->string_index_bitmap[byte_idx];
+    for (uint8_t bit = 0; bits != 0; bit++, bits >>= 1)
+    {
+      if (bits & 1)
+        store_byte(all_string_indices + num_strings++, byte_idx * 8 + bit);
+    }
+  }
+  // Resolve the cable to jack to string index mapping once so cable lookups are a table load.
+  // Every jack has a record, so there is no limit on the number of jacks.
+  uint8_t by_id[256];
+  // The jacks associated with an IN endpoint will be embedded OUT jacks
+  index_jack_str_idx(records, records_end, RECORD_OUT_JACK, by_id);
+  for (uint8_t cable = 0; cable < dev->num_in_cables; cable++)
+    store_byte(in_cable_str_idx + cable, by_id[ctx->in_cable_jack_ids[cable]]);
+  // The jacks associated with an OUT endpoint will be embedded IN jacks
+  index_jack_str_idx(records, records_end, RECORD_IN_JACK, by_id);
+  for (uint8_t cable = 0; cable < dev->num_out_cables; cable++)
+    store_byte(out_cable_str_idx + cable, by_id[ctx->out_cable_jack_ids[cable]]);
+  // The embedded OUT jacks of the IN endpoint cables are fed by external IN jacks and the
+  // embedded IN jacks of the OUT endpoint cables feed external OUT jacks, directly or through elements
+  route_upstream(records, records_end, by_id);
+  for (uint8_t cable = 0; cable < dev->num_in_cables; cable++)
+    store_byte(in_cable_routes + 2 * cable, by_id[ctx->in_cable_jack_ids[cable]]);
+  route_downstream(records, records_end, by_id);
+  for (uint8_t cable = 0; cable < dev->num_out_cables; cable++)
+    store_byte(out_cable_routes + 2 * cable, by_id[ctx->out_cable_jack_ids[cable]]);
+  set_route_str_idx(records, records_end, by_id, in_cable_routes, num_cables);
+  // Index the elements by position and by ID so element lookups are a table load
+  uint8_t* element_offsets = out_cable_routes + 2 * dev->num_out_cables;
+  uint8_t* element_directory = element_offsets + 2 * num_elements;
+  for (uint16_t id = 0; id < directory_len; id++)
+    store_byte(element_directory + id, 0);
+  uint8_t element = 0;
+  for (uint8_t const* record = records; element < num_elements; record += 2 + record[1])
+  {
+    if (record[0] != RECORD_ELEMENT)
+      continue;
+    uint16_t offset = record - records;
+    store_byte(element_offsets + 2 * element, offset & 0xFF);
+    store_byte(element_offsets + 2 * element + 1, offset >> 8);
+    ++element;
+    // The first element with an ID wins
+    if (element_directory[record[2] - element_id_first] == 0)
+      store_byte(element_directory + record[2] - element_id_first, element);
+  }
+  STORE(dev->num_elements, num_elements);
+  STORE(dev->element_id_first, element_id_first);
+  STORE(dev->element_id_last, element_id_last);
+  STORE(dev->tables, tables);
+  STORE(dev->num_string_indices, num_strings);
+  publish(dev);
+  TU_LOG2("MIDI String descriptors parsed successfully\r\n");
+  return true;
+}
+
+// Parse the MIDI Streaming interface. On failure, return the device's block to the arena.
+static bool configure_midi(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  usb_midi_descriptor_lib_iter_t iter;
+  usb_midi_descriptor_lib_iter_init(&iter, midi_descriptor, max_len);
+  TU_VERIFY(usb_midi_descriptor_lib_iter_next(&iter) && iter.len >= sizeof(tusb_desc_interface_t));
+  tusb_desc_interface_t const *desc_itf = (tusb_desc_interface_t const*)iter.desc;
+  // Keep track of any string descriptor that might be here
+  add_string_index(ctx, desc_itf->iInterface);
+  STORE(ctx->dev->itf_str_idx, desc_itf->iInterface);
+  visit(ctx->dev, iter.desc);
+  TU_VERIFY(usb_midi_descriptor_lib_iter_next(&iter) && iter.len >= 3 && verify_first_midi_descriptor(iter.desc));
+
+  bool ok = true;
+  do
+  {
+    // The next interface, if any, ends the MIDI Streaming interface
+    if (iter.type == TUSB_DESC_INTERFACE || iter.type == TUSB_DESC_INTERFACE_ASSOCIATION)
+      break;
+    ok = parse_midi_descriptor(ctx, iter.desc);
+    if (ok)
+      visit(ctx->dev, iter.desc);
+  } while (ok && usb_midi_descriptor_lib_iter_next(&iter));
+  ok = ok && !iter.malformed && finish_configure(ctx);
+  if (!ok)
+    arena_free(ctx->dev);
+  return ok;
+}
+
+bool usb_midi_descriptor_lib_dev_configure(usb_midi_descriptor_info_t* dev, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_parse_ctx_t ctx;
+  parse_ctx_init(&ctx, dev);
+  return parse_end(&ctx, configure_midi(&ctx, midi_descriptor, max_len));
+}
+
+uint8_t usb_midi_descriptor_lib_find_midi_interfaces(const uint8_t* full_config_descriptor,
+  usb_midi_descriptor_lib_interface_t* itfs, uint8_t max_itfs)
+{
+  TU_VERIFY(tu_desc_type(full_config_descriptor) == TUSB_DESC_CONFIGURATION, 0);
+  usb_midi_descriptor_lib_iter_t iter;
+  usb_midi_descriptor_lib_iter_init(&iter, full_config_descriptor,
+    ((tusb_desc_configuration_t const*)full_config_descriptor)->wTotalLength);
+  TU_VERIFY(usb_midi_descriptor_lib_iter_next(&iter), 0);
+  uint8_t num_itfs = 0;
+  uint8_t control_str_idx = 0;
+  uint16_t control_offset = 0;
+  uint16_t control_len = 0;
+  bool in_control = false; // control_len is still open
+  bool in_midi = false; // itfs[num_itfs - 1] is still open
+  while (usb_midi_descriptor_lib_iter_next(&iter))
+  {
+    if (iter.type == TUSB_DESC_INTERFACE || iter.type == TUSB_DESC_INTERFACE_ASSOCIATION)
+    {
+      // The next interface, if any, ends a MIDI Streaming interface or an Audio Control interface
+      if (in_midi)
+        itfs[num_itfs - 1].len = iter.offset - itfs[num_itfs - 1].offset;
+      if (in_control)
+        control_len = iter.offset - control_offset;
+      in_midi = false;
+      in_control = false;
+      tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*)iter.desc;
+      if (iter.type == TUSB_DESC_INTERFACE_ASSOCIATION)
+      {
+        // A new function starts
+        control_str_idx = 0;
+        control_offset = 0;
+        control_len = 0;
+      }
+      else if (at_audio_itf(&iter, AUDIO_SUBCLASS_CONTROL))
+      {
+        control_str_idx = desc_itf->iInterface;
+        control_offset = iter.offset;
+        in_control = true;
+      }
+      else if (at_audio_itf(&iter, AUDIO_SUBCLASS_MIDI_STREAMING) && num_itfs < max_itfs)
+      {
+        itfs[num_itfs].itf_num = desc_itf->bInterfaceNumber;
+        itfs[num_itfs].alt = desc_itf->bAlternateSetting;
+        itfs[num_itfs].control_str_idx = control_str_idx;
+        itfs[num_itfs].control_offset = control_offset;
+        itfs[num_itfs].control_len = control_len;
+        itfs[num_itfs].offset = iter.offset;
+        ++num_itfs;
+        in_midi = true;
+      }
+    }
+  }
+  // The last MIDI Streaming interface runs to the end of the descriptors. One that
+  // a malformed descriptor cuts short is not listed: configuring it would
+  // quietly leave out whatever that descriptor hid.
+  if (in_midi && iter.malformed)
+    --num_itfs;
+  else if (in_midi)
+    itfs[num_itfs - 1].len = iter.offset - itfs[num_itfs - 1].offset;
+  return num_itfs;
+}
+
+bool usb_midi_descriptor_lib_dev_configure_interface(usb_midi_descriptor_info_t* dev, const uint8_t* full_config_descriptor,
+  const usb_midi_descriptor_lib_interface_t* itf)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_parse_ctx_t ctx;
+  parse_ctx_init(&ctx, dev);
+  // Keep track of the Audio Control interface string and entities the same way usb_midi_descriptor_lib_configure_from_full() does
+  add_string_index(&ctx, itf->control_str_idx);
+  usb_midi_descriptor_lib_iter_t iter;
+  usb_midi_descriptor_lib_iter_init(&iter, full_config_descriptor + itf->control_offset, itf->control_len);
+  while (usb_midi_descriptor_lib_iter_next(&iter))
+  {
+    if (iter.type == TUSB_DESC_INTERFACE)
+      enter_interface(&ctx, &iter);
+    else if (ctx.in_audio_control && !parse_audio_control_descriptor(&ctx, iter.desc, iter.len))
+      return parse_end(&ctx, false);
+  }
+  // Offsets in the statistics are from the start of the configuration descriptor
+  dev->stats.bytes = itf->offset;
+  return parse_end(&ctx, configure_midi(&ctx, full_config_descriptor + itf->offset, itf->len));
+}
+
+// A view device reads the caller's MIDI Streaming interface descriptors in
+// place instead of a block: block points at the interface descriptor,
+// in_place_len is the length of the interface's descriptors, tables is the
+// offset of the first jack descriptor and cs_ep_offsets holds the offset of
+// each IN and then each OUT endpoint's CS endpoint descriptor. Configuring a
+// view device checks every descriptor, so the getters can walk them unchecked.
+// Nothing writes the caller's descriptors, so the getters read them with
+// plain loads.
+
+// Return the string index of a checked interface, jack or element descriptor; 0 for other descriptors
+static uint8_t view_desc_str_idx(uint8_t const* p_desc)
+{
+  if (tu_desc_type(p_desc) == TUSB_DESC_INTERFACE)
+    return ((tusb_desc_interface_t const*)p_desc)->iInterface;
+  if (tu_desc_type(p_desc) != TUSB_DESC_CS_INTERFACE)
     return 0;
-  if (out_cable_num >= midi_host[idx].num_cables_tx)
+  switch (p_desc[2])
+  {
+  case MIDI_CS_INTERFACE_IN_JACK:
+    return p_desc[5];
+  case MIDI_CS_INTERFACE_OUT_JACK:
+    return p_desc[6 + 2 * p_desc[5]]; // iJack follows the source ID and pin pairs
+  case MIDI_CS_INTERFACE_ELEMENT:
+    return p_desc[9 + 2 * p_desc[4] + p_desc[8 + 2 * p_desc[4]]]; // iElement follows bmElementCaps
+  default:
     return 0;
-  uint8_t jack_id = midi_host[idx].ep_out_associated_jacks[out_cable_num];
-  // The jacks associated with an OUT endpoint will be embedded IN jacks
-  for (uint8_t jack_idx = 0; jack_idx < midi_host[idx].next_in_jack; jack_idx++)
+  }
+}
+
+// Check one descriptor at offset in the MIDI Streaming interface of view device ctx->dev
+static bool view_midi_descriptor(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t const* p_desc, uint16_t offset)
+{
+  usb_midi_descriptor_info_t* dev = ctx->dev;
+  uint8_t len = tu_desc_len(p_desc);
+  TU_VERIFY(len >= 3);
+  if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE)
+  {
+    if (p_desc[2] == MIDI_CS_INTERFACE_IN_JACK)
+    {
+      TU_VERIFY(len >= sizeof(midi_desc_in_jack_t));
+      count(&dev->stats.num_in_jacks);
+    }
+    else if (p_desc[2] == MIDI_CS_INTERFACE_OUT_JACK)
+    {
+      TU_VERIFY(len >= 7 && len >= 7 + 2 * p_desc[5]);
+      count(&dev->stats.num_out_jacks);
+    }
+    else if (p_desc[2] == MIDI_CS_INTERFACE_ELEMENT)
+    {
+      TU_VERIFY(element_payload_ok(p_desc + 3, len - 3));
+      count(&dev->stats.num_elements);
+    }
+    else
+    {
+      TU_VERIFY(p_desc[2] == MIDI_CS_INTERFACE_HEADER);
+    }
+    if ((p_desc[2] == MIDI_CS_INTERFACE_IN_JACK || p_desc[2] == MIDI_CS_INTERFACE_OUT_JACK) && dev->tables == 0)
+      STORE(dev->tables, offset);
+    add_string_index(ctx, view_desc_str_idx(p_desc));
+  }
+  else if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT)
+  {
+    TU_VERIFY(len >= sizeof(tusb_desc_endpoint_t));
+    uint8_t ep_addr = ((tusb_desc_endpoint_t const*)p_desc)->bEndpointAddress;
+    if (tu_edpt_dir(ep_addr) == TUSB_DIR_OUT)
+    {
+      TU_VERIFY(dev->num_out_eps < MAX_OUT_ENDPOINTS || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_MANY_ENDPOINTS));
+      STORE(dev->out_eps[dev->num_out_eps].ep_addr, ep_addr);
+      STORE(dev->num_out_eps, dev->num_out_eps + 1);
+    }
+    else
+    {
+      TU_VERIFY(dev->num_in_eps < MAX_IN_ENDPOINTS || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_MANY_ENDPOINTS));
+      STORE(dev->in_eps[dev->num_in_eps].ep_addr, ep_addr);
+      STORE(dev->num_in_eps, dev->num_in_eps + 1);
+    }
+    ctx->prev_ep_addr = ep_addr;
+  }
+  else
   {
-    if (midi_host[idx].in_jack_info[jack_idx].jack_id == jack_id) {
-      return midi_host[idx].in_jack_info[jack_idx].string_index;
+    midi_cs_desc_endpoint_t const* p_csep = (midi_cs_desc_endpoint_t const*)p_desc;
+    TU_VERIFY(p_csep->bDescriptorType == TUSB_DESC_CS_ENDPOINT && p_csep->bDescriptorSubType == MIDI_CS_ENDPOINT_GENERAL);
+    TU_VERIFY(len >= 4 + p_csep->bNumEmbMIDIJack && ctx->prev_ep_addr != 0);
+    bool out = tu_edpt_dir(ctx->prev_ep_addr) == TUSB_DIR_OUT;
+    uint8_t ep_num = out ? dev->num_out_eps - 1 : dev->num_in_eps - 1;
+    usb_midi_descriptor_lib_ep_info_t* ep_info = out ? dev->out_eps + ep_num : dev->in_eps + ep_num;
+    uint8_t* num_cables = out ? &dev->num_out_cables : &dev->num_in_cables;
+    uint8_t max_cables = out ? MAX_OUT_CABLES : MAX_IN_CABLES;
+    TU_VERIFY(ep_info->ep_addr == ctx->prev_ep_addr && ep_info->num_cables == 0);
+    // Only the cables the parser would keep are kept, so a view device has the same cables
+    uint8_t num_jacks = p_csep->bNumEmbMIDIJack;
+    if (num_jacks > max_cables - *num_cables)
+    {
+      count_n(&dev->stats.cables_dropped, num_jacks - (max_cables - *num_cables));
+      num_jacks = max_cables - *num_cables;
     }
+    STORE(ep_info->num_cables, num_jacks);
+    STORE(ep_info->first_cable, *num_cables);
+    STORE(*num_cables, *num_cables + num_jacks);
+    STORE(dev->cs_ep_offsets[out ? MAX_IN_ENDPOINTS + ep_num : ep_num], offset);
+    ctx->prev_ep_addr = 0;
+  }
+  return true;
+}
+
+// Check the MIDI Streaming interface of view device ctx->dev and record where its descriptors are
+static bool configure_view(usb_midi_descriptor_parse_ctx_t* ctx, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  usb_midi_descriptor_info_t* dev = ctx->dev;
+  usb_midi_descriptor_lib_iter_t iter;
+  usb_midi_descriptor_lib_iter_init(&iter, midi_descriptor, max_len);
+  TU_VERIFY(usb_midi_descriptor_lib_iter_next(&iter) && iter.len >= sizeof(tusb_desc_interface_t) &&
+    iter.type == TUSB_DESC_INTERFACE);
+  add_string_index(ctx, view_desc_str_idx(midi_descriptor));
+  STORE(dev->itf_str_idx, view_desc_str_idx(midi_descriptor));
+  visit(dev, midi_descriptor);
+  bool first = true;
+  while (usb_midi_descriptor_lib_iter_next(&iter))
+  {
+    // The next interface, if any, ends the MIDI Streaming interface
+    if (iter.type == TUSB_DESC_INTERFACE || iter.type == TUSB_DESC_INTERFACE_ASSOCIATION)
+      break;
+    TU_VERIFY(!first || (iter.len >= 3 && verify_first_midi_descriptor(iter.desc)));
+    TU_VERIFY(view_midi_descriptor(ctx, iter.desc, iter.offset));
+    visit(dev, iter.desc);
+    first = false;
+  }
+  TU_VERIFY(!iter.malformed);
+  uint32_t len_parsed = iter.offset;
+  TU_VERIFY(len_parsed <= 0xFFFF || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_LONG));
+  TU_VERIFY(dev->num_in_cables + dev->num_out_cables != 0 || parse_error(dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_CABLES));
+  STORE(dev->num_in_jacks, dev->stats.num_in_jacks);
+  STORE(dev->num_out_jacks, dev->stats.num_out_jacks);
+  STORE(dev->num_string_indices, ctx->num_strings);
+  STORE(dev->in_place_len, len_parsed);
+  if (dev->tables == 0)
+    STORE(dev->tables, len_parsed);
+  STORE(dev->block, midi_descriptor);
+  STORE(dev->view, true);
+  publish(dev);
+  return true;
+}
+
+bool usb_midi_descriptor_lib_dev_configure_view(usb_midi_descriptor_info_t* dev, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_parse_ctx_t ctx;
+  parse_ctx_init(&ctx, dev);
+  return parse_end(&ctx, configure_view(&ctx, midi_descriptor, max_len));
+}
+
+// Return the string index of the jack IN (in is true) or OUT endpoint cable cable_num of
+// endpoint ep_num of view device info is associated with. The caller checks the cable exists.
+// A view device caches nothing, so every call walks the interface's descriptors from the
+// first jack; the header documents the cost.
+static uint8_t view_cable_str_idx(usb_midi_descriptor_info_t const* info, bool in, uint8_t ep_num, uint8_t cable_num)
+{
+  uint8_t jack_id = info->block[info->cs_ep_offsets[in ? ep_num : MAX_IN_ENDPOINTS + ep_num] + 4 + cable_num];
+  // The jacks associated with an IN endpoint are embedded OUT jacks and those with an OUT endpoint embedded IN jacks
+  uint8_t subtype = in ? MIDI_CS_INTERFACE_OUT_JACK : MIDI_CS_INTERFACE_IN_JACK;
+  for (uint16_t offset = info->tables; offset < info->in_place_len; offset += info->block[offset])
+  {
+    uint8_t const* p_desc = info->block + offset;
+    if (tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE && p_desc[2] == subtype && p_desc[4] == jack_id)
+      return view_desc_str_idx(p_desc);
   }
   return 0;
 }
+
+// Copy up to max_indices of the unique string indices of view device info, in ascending
+// order, keeping the same MAX_STRING_INDICES indices the parser would. Return the number copied.
+static uint8_t view_string_indices(usb_midi_descriptor_info_t const* info, uint8_t* indices, uint8_t max_indices)
+{
+  uint8_t bitmap[32] = {0};
+  uint8_t num_strings = 0;
+  for (uint16_t offset = 0; offset < info->in_place_len && num_strings < MAX_STRING_INDICES; offset += info->block[offset])
+  {
+    uint8_t str_idx = view_desc_str_idx(info->block + offset);
+    if (str_idx != 0 && (bitmap[str_idx >> 3] & (1 << (str_idx & 7))) == 0)
+    {
+      bitmap[str_idx >> 3] |= 1 << (str_idx & 7);
+      ++num_strings;
+    }
+  }
+  uint8_t copied = 0;
+  for (uint16_t str_idx = 1; str_idx < 256 && copied < max_indices && copied < num_strings; str_idx++)
+  {
+    if (bitmap[str_idx >> 3] & (1 << (str_idx & 7)))
+      indices[copied++] = str_idx;
+  }
+  return copied;
+}
+
+// usb_midi_descriptor_parser_t states
+enum
+{
+  PARSER_CONFIG_HEADER = 0, // waiting for the configuration descriptor
+  PARSER_FIND_AUDIO,        // looking for the first audio class interface
+  PARSER_FIND_MIDI,         // found an audio control interface; looking for the MIDI Streaming interface
+  PARSER_MIDI_FIRST,        // the next descriptor is the first one in the MIDI Streaming interface
+  PARSER_MIDI,              // parsing the MIDI Streaming interface
+  PARSER_MIDI_DONE,         // past the end of the MIDI Streaming interface
+  PARSER_COMPLETE,          // parsed the whole configuration descriptor
+  PARSER_ERROR,
+};
+
+void usb_midi_descriptor_parser_init_dev(usb_midi_descriptor_parser_t* parser, usb_midi_descriptor_info_t* dev)
+{
+  memset(parser, 0, sizeof(*parser));
+  parser->state = dev != NULL ? PARSER_CONFIG_HEADER : PARSER_ERROR;
+  parse_ctx_init(&parser->ctx, dev);
+}
+
+// Act on one descriptor. len is the descriptor's bLength unless the descriptor
+// is longer than the parser buffer; then it is the number of bytes available.
+static bool parser_process(usb_midi_descriptor_parser_t* parser, uint8_t const* p_desc, uint8_t len)
+{
+  uint8_t type = tu_desc_type(p_desc);
+  tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*)p_desc;
+  bool is_audio_itf = type == TUSB_DESC_INTERFACE && len >= sizeof(tusb_desc_interface_t) &&
+    desc_itf->bInterfaceClass == TUSB_CLASS_AUDIO;
+  switch(parser->state)
+  {
+    case PARSER_CONFIG_HEADER:
+      TU_VERIFY(type == TUSB_DESC_CONFIGURATION && len >= 4);
+      parser->total_len = p_desc[2] | (p_desc[3] << 8); // wTotalLength
+      TU_VERIFY(parser->total_len >= tu_desc_len(p_desc));
+      parser->state = PARSER_FIND_AUDIO;
+      break;
+    case PARSER_FIND_AUDIO:
+      // There can be just a MIDI interface or an audio and a MIDI interface. Only open the MIDI interface
+      if (is_audio_itf)
+      {
+        TU_VERIFY(desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_CONTROL ||
+          desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_MIDI_STREAMING);
+        add_string_index(&parser->ctx, desc_itf->iInterface);
+        if (desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_MIDI_STREAMING)
+          STORE(parser->ctx.dev->itf_str_idx, desc_itf->iInterface);
+        parser->state = desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_CONTROL ? PARSER_FIND_MIDI : PARSER_MIDI_FIRST;
+        parser->ctx.in_audio_control = desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_CONTROL;
+        parser->ctx.ac_protocol = desc_itf->bInterfaceProtocol;
+      }
+      break;
+    case PARSER_FIND_MIDI:
+      if (is_audio_itf && desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_MIDI_STREAMING)
+      {
+        add_string_index(&parser->ctx, desc_itf->iInterface);
+        STORE(parser->ctx.dev->itf_str_idx, desc_itf->iInterface);
+        parser->state = PARSER_MIDI_FIRST;
+      }
+      else if (type == TUSB_DESC_INTERFACE)
+      {
+        parser->ctx.in_audio_control = is_audio_itf && desc_itf->bInterfaceSubClass == AUDIO_SUBCLASS_CONTROL;
+        if (parser->ctx.in_audio_control)
+          parser->ctx.ac_protocol = desc_itf->bInterfaceProtocol;
+      }
+      else if (parser->ctx.in_audio_control && len == tu_desc_len(p_desc))
+      {
+        // Skip an Audio Control descriptor too long for the parser buffer
+        TU_VERIFY(parse_audio_control_descriptor(&parser->ctx, p_desc, len));
+      }
+      break;
+    case PARSER_MIDI_FIRST:
+      TU_VERIFY(len >= 3 && verify_first_midi_descriptor(p_desc));
+      parser->state = PARSER_MIDI;
+      // fall through
+    case PARSER_MIDI:
+      // The next interface, if any, ends the MIDI Streaming interface
+      if (type == TUSB_DESC_INTERFACE || type == TUSB_DESC_INTERFACE_ASSOCIATION)
+      {
+        parser->state = PARSER_MIDI_DONE;
+        break;
+      }
+      // Descriptors in the MIDI Streaming interface must fit in the parser buffer
+      TU_VERIFY(len == tu_desc_len(p_desc) || parse_error(parser->ctx.dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_LONG));
+      TU_VERIFY(parse_midi_descriptor(&parser->ctx, p_desc));
+      break;
+    default:
+      break;
+  }
+  visit(parser->ctx.dev, p_desc);
+  return true;
+}
+
+// Consume up to len bytes of the next descriptor. Return the number of bytes consumed or 0 on error.
+static uint32_t parser_consume(usb_midi_descriptor_parser_t* parser, const uint8_t* bytes, uint32_t len)
+{
+  if (parser->desc_have == 0 && len >= 2 && bytes[0] >= 2 && len >= bytes[0])
+  {
+    // The whole descriptor is in this chunk; parse it in place
+    return parser_process(parser, bytes, bytes[0]) ? bytes[0] : 0;
+  }
+  // Collect the descriptor across chunk boundaries
+  if (parser->desc_have == 0)
+  {
+    TU_VERIFY(bytes[0] >= 2, 0);
+    parser->desc_len = bytes[0];
+  }
+  uint32_t nbytes = parser->desc_len - parser->desc_have;
+  if (nbytes > len)
+    nbytes = len;
+  for (uint32_t jdx = 0; jdx < nbytes; jdx++)
+  {
+    // Keep only as much of the descriptor as fits in the buffer
+    if (parser->desc_have + jdx < USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE)
+      parser->desc[parser->desc_have + jdx] = bytes[jdx];
+  }
+  parser->desc_have += nbytes;
+  if (parser->desc_have == parser->desc_len)
+  {
+    uint8_t desc_len = parser->desc_len < USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE ? parser->desc_len : USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE;
+    parser->desc_have = 0;
+    TU_VERIFY(parser_process(parser, parser->desc, desc_len), 0);
+  }
+  return nbytes;
+}
+
+bool usb_midi_descriptor_parser_feed(usb_midi_descriptor_parser_t* parser, const uint8_t* bytes, uint32_t len)
+{
+  while (len > 0 && parser->state != PARSER_COMPLETE && parser->state != PARSER_ERROR)
+  {
+    uint32_t nbytes = parser_consume(parser, bytes, len);
+    parser->offset += nbytes;
+    // A descriptor still being collected when wTotalLength bytes have arrived runs past it too
+    bool past_end = parser->total_len != 0 &&
+      (parser->offset > parser->total_len || (parser->offset == parser->total_len && parser->desc_have != 0));
+    if (nbytes == 0 || past_end)
+    {
+      // malformed descriptor or one that runs past wTotalLength
+      parser->state = PARSER_ERROR;
+      arena_free(parser->ctx.dev);
+      parse_end(&parser->ctx, false);
+    }
+    else if (parser->offset == parser->total_len)
+    {
+      // The whole configuration descriptor has arrived
+      bool found_midi = parser->state == PARSER_MIDI || parser->state == PARSER_MIDI_DONE;
+      if (!found_midi)
+        parse_error(parser->ctx.dev, USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_MIDI_INTERFACE);
+      parser->state = found_midi && finish_configure(&parser->ctx) ? PARSER_COMPLETE : PARSER_ERROR;
+      if (parser->state == PARSER_ERROR)
+        arena_free(parser->ctx.dev);
+      parse_end(&parser->ctx, parser->state == PARSER_COMPLETE);
+    }
+    bytes += nbytes;
+    len -= nbytes;
+  }
+  return parser->state != PARSER_ERROR;
+}
+
+bool usb_midi_descriptor_parser_complete(const usb_midi_descriptor_parser_t* parser)
+{
+  return parser->state == PARSER_COMPLETE;
+}
+
+// Every getter below loads the fields of the device slot it needs after
+// read_begin(), checks that the slot is configured, since the parse changes
+// the fields of an unconfigured slot without changing its sequence number,
+// and computes its result, then starts over if the writer changed the slot
+// meanwhile. A getter that reads the block checks with read_retry() that the
+// block pointer, lengths and counts it loaded are consistent first, so even a
+// result that is thrown away reads only inside the block; values read from
+// the block itself are bounds checked.
+
+// Load the fields of device dev that say where its tables are to info
+static void load_tables(usb_midi_descriptor_info_t* info, const usb_midi_descriptor_info_t* dev)
+{
+  info->view = LOAD(dev->view);
+  info->block = LOAD(dev->block);
+  info->tables = LOAD(dev->tables);
+  info->num_in_cables = LOAD(dev->num_in_cables);
+  info->num_out_cables = LOAD(dev->num_out_cables);
+  info->num_string_indices = LOAD(dev->num_string_indices);
+}
+
+int usb_midi_descriptor_lib_dev_get_all_str_indices(const usb_midi_descriptor_info_t* dev, const uint8_t** indices)
+{
+  if (dev == NULL)
+    return -1;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  int nstrings;
+  do
+  {
+    seq = read_begin(dev);
+    nstrings = -1;
+    if (!LOAD(dev->configured))
+      continue;
+    load_tables(&info, dev);
+    if (!info.view)
+    {
+      nstrings = info.num_string_indices;
+      if (nstrings)
+        *indices = info.block + info.tables + info.num_in_cables + info.num_out_cables;
+    }
+  } while (read_retry(dev, seq));
+  return nstrings;
+}
+
+int usb_midi_descriptor_lib_dev_copy_all_str_indices(const usb_midi_descriptor_info_t* dev, uint8_t* indices, uint8_t max_indices)
+{
+  if (dev == NULL)
+    return -1;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  int nstrings;
+  do
+  {
+    seq = read_begin(dev);
+    nstrings = -1;
+    if (!LOAD(dev->configured))
+      continue;
+    load_tables(&info, dev);
+    info.in_place_len = LOAD(dev->in_place_len);
+    if (read_retry(dev, seq))
+      continue;
+    nstrings = info.num_string_indices < max_indices ? info.num_string_indices : max_indices;
+    if (info.view)
+      view_string_indices(&info, indices, nstrings);
+    else
+      load_bytes(indices, info.block + info.tables + info.num_in_cables + info.num_out_cables, nstrings);
+  } while (read_retry(dev, seq));
+  return nstrings;
+}
+
+uint8_t usb_midi_descriptor_lib_dev_get_num_in_endpoints(const usb_midi_descriptor_info_t* dev)
+{
+  if (dev == NULL)
+    return 0;
+  unsigned seq;
+  uint8_t num_eps;
+  do
+  {
+    seq = read_begin(dev);
+    num_eps = LOAD(dev->configured) ? LOAD(dev->num_in_eps) : 0;
+  } while (read_retry(dev, seq));
+  return num_eps;
+}
+
+uint8_t usb_midi_descriptor_lib_dev_get_num_out_endpoints(const usb_midi_descriptor_info_t* dev)
+{
+  if (dev == NULL)
+    return 0;
+  unsigned seq;
+  uint8_t num_eps;
+  do
+  {
+    seq = read_begin(dev);
+    num_eps = LOAD(dev->configured) ? LOAD(dev->num_out_eps) : 0;
+  } while (read_retry(dev, seq));
+  return num_eps;
+}
+
+bool usb_midi_descriptor_lib_dev_get_in_endpoint(const usb_midi_descriptor_info_t* dev, uint8_t ep_num, uint8_t* ep_addr, uint8_t* num_cables)
+{
+  if (dev == NULL)
+    return false;
+  unsigned seq;
+  bool found;
+  do
+  {
+    seq = read_begin(dev);
+    found = LOAD(dev->configured) && ep_num < LOAD(dev->num_in_eps);
+    if (found)
+    {
+      *ep_addr = LOAD(dev->in_eps[ep_num].ep_addr);
+      *num_cables = LOAD(dev->in_eps[ep_num].num_cables);
+    }
+  } while (read_retry(dev, seq));
+  return found;
+}
+
+bool usb_midi_descriptor_lib_dev_get_out_endpoint(const usb_midi_descriptor_info_t* dev, uint8_t ep_num, uint8_t* ep_addr, uint8_t* num_cables)
+{
+  if (dev == NULL)
+    return false;
+  unsigned seq;
+  bool found;
+  do
+  {
+    seq = read_begin(dev);
+    found = LOAD(dev->configured) && ep_num < LOAD(dev->num_out_eps);
+    if (found)
+    {
+      *ep_addr = LOAD(dev->out_eps[ep_num].ep_addr);
+      *num_cables = LOAD(dev->out_eps[ep_num].num_cables);
+    }
+  } while (read_retry(dev, seq));
+  return found;
+}
+
+// Return the position of an endpoint's cable in the device's IN or OUT cable tables, or -1 if there is none
+static int cable_pos(usb_midi_descriptor_lib_ep_info_t const* eps, uint8_t num_eps, uint8_t num_cables, uint8_t ep_num, uint8_t cable_num)
+{
+  if (ep_num >= num_eps)
+    return -1;
+  uint16_t cable = eps[ep_num].first_cable + cable_num;
+  if (cable_num >= eps[ep_num].num_cables || cable >= num_cables)
+    return -1;
+  return cable;
+}
+
+// cable_pos() of an IN (in is true) or OUT endpoint cable of device dev, loading only the fields it
+// needs; -1 if the device is not configured either
+static inline int load_cable_pos(const usb_midi_descriptor_info_t* dev, bool in, uint8_t ep_num, uint8_t cable_num)
+{
+  if (!LOAD(dev->configured) || ep_num >= (in ? LOAD(dev->num_in_eps) : LOAD(dev->num_out_eps)))
+    return -1;
+  usb_midi_descriptor_lib_ep_info_t const* ep = in ? dev->in_eps + ep_num : dev->out_eps + ep_num;
+  uint16_t cable = LOAD(ep->first_cable) + cable_num;
+  if (cable_num >= LOAD(ep->num_cables) || cable >= (in ? LOAD(dev->num_in_cables) : LOAD(dev->num_out_cables)))
+    return -1;
+  return cable;
+}
+
+// Load the fields view_cable_str_idx() reads for an IN (in is true) or OUT endpoint of device dev to info
+static void load_view_cable(usb_midi_descriptor_info_t* info, const usb_midi_descriptor_info_t* dev, bool in, uint8_t ep_num)
+{
+  uint8_t ep = in ? ep_num : MAX_IN_ENDPOINTS + ep_num;
+  info->cs_ep_offsets[ep] = LOAD(dev->cs_ep_offsets[ep]);
+  info->in_place_len = LOAD(dev->in_place_len);
+}
+
+int usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(const usb_midi_descriptor_info_t* dev, uint8_t ep_num, uint8_t in_cable_num)
+{
+  if (dev == NULL)
+    return 0;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  int str_idx;
+  do
+  {
+    seq = read_begin(dev);
+    str_idx = 0;
+    int cable = load_cable_pos(dev, true, ep_num, in_cable_num);
+    if (cable < 0)
+      continue;
+    info.view = LOAD(dev->view);
+    info.block = LOAD(dev->block);
+    info.tables = LOAD(dev->tables);
+    if (info.view)
+      load_view_cable(&info, dev, true, ep_num);
+    if (read_retry(dev, seq))
+      continue;
+    if (info.view)
+      str_idx = view_cable_str_idx(&info, true, ep_num, in_cable_num);
+    else
+      str_idx = load_byte(info.block + info.tables + cable);
+  } while (read_retry(dev, seq));
+  return str_idx;
+}
+
+int usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(const usb_midi_descriptor_info_t* dev, uint8_t ep_num, uint8_t out_cable_num)
+{
+  if (dev == NULL)
+    return 0;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  int str_idx;
+  do
+  {
+    seq = read_begin(dev);
+    str_idx = 0;
+    int cable = load_cable_pos(dev, false, ep_num, out_cable_num);
+    if (cable < 0)
+      continue;
+    info.view = LOAD(dev->view);
+    info.block = LOAD(dev->block);
+    info.tables = LOAD(dev->tables);
+    if (info.view)
+      load_view_cable(&info, dev, false, ep_num);
+    else
+      cable = cable + LOAD(dev->num_in_cables);
+    if (read_retry(dev, seq))
+      continue;
+    if (info.view)
+      str_idx = view_cable_str_idx(&info, false, ep_num, out_cable_num);
+    else
+      str_idx = load_byte(info.block + info.tables + cable);
+  } while (read_retry(dev, seq));
+  return str_idx;
+}
+
+// Copy a route from the route tables. Return false if the cable does not reach an
+// external jack; view devices have no route tables and no routes.
+static bool get_route(usb_midi_descriptor_info_t const* info, uint16_t route_offset, uint8_t* ext_jack_id, uint8_t* str_idx)
+{
+  if (info->view)
+    return false;
+  uint8_t const* route = info->block + info->tables + info->num_in_cables + info->num_out_cables +
+    info->num_string_indices + route_offset;
+  *ext_jack_id = load_byte(route);
+  *str_idx = load_byte(route + 1);
+  return *ext_jack_id != 0;
+}
+
+bool usb_midi_descriptor_lib_dev_get_in_endpoint_cable_route(const usb_midi_descriptor_info_t* dev, uint8_t ep_num, uint8_t in_cable_num,
+  uint8_t* ext_jack_id, uint8_t* str_idx)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  bool found;
+  do
+  {
+    seq = read_begin(dev);
+    found = false;
+    int cable = load_cable_pos(dev, true, ep_num, in_cable_num);
+    if (cable < 0)
+      continue;
+    load_tables(&info, dev);
+    if (read_retry(dev, seq))
+      continue;
+    found = get_route(&info, 2 * cable, ext_jack_id, str_idx);
+  } while (read_retry(dev, seq));
+  return found;
+}
+
+bool usb_midi_descriptor_lib_dev_get_out_endpoint_cable_route(const usb_midi_descriptor_info_t* dev, uint8_t ep_num, uint8_t out_cable_num,
+  uint8_t* ext_jack_id, uint8_t* str_idx)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  bool found;
+  do
+  {
+    seq = read_begin(dev);
+    found = false;
+    int cable = load_cable_pos(dev, false, ep_num, out_cable_num);
+    if (cable < 0)
+      continue;
+    load_tables(&info, dev);
+    if (read_retry(dev, seq))
+      continue;
+    found = get_route(&info, 2 * (info.num_in_cables + cable), ext_jack_id, str_idx);
+  } while (read_retry(dev, seq));
+  return found;
+}
+
+// Return the element offset list; the element directory follows it
+static uint8_t const* element_table(usb_midi_descriptor_info_t const* info)
+{
+  return info->block + info->tables + 3 * (info->num_in_cables + info->num_out_cables) + info->num_string_indices;
+}
+
+// Copy the record of element number elem_num to record, which has room for
+// MAX_RECORD_LEN bytes, and return the copy's payload, or NULL if the offset
+// list does not lead to a whole element record
+static uint8_t const* element_payload(usb_midi_descriptor_info_t const* info, uint8_t elem_num, uint8_t* record)
+{
+  if (!info->configured || elem_num >= info->num_elements)
+    return NULL;
+  uint8_t const* offset_bytes = element_table(info) + 2 * elem_num;
+  uint16_t offset = load_byte(offset_bytes) | (load_byte(offset_bytes + 1) << 8);
+  if ((uint32_t)offset + 2 > info->tables)
+    return NULL;
+  load_bytes(record, info->block + offset, 2);
+  if ((uint32_t)offset + 2 + record[1] > info->tables)
+    return NULL;
+  load_bytes(record + 2, info->block + offset + 2, record[1]);
+  return element_payload_ok(record + 2, record[1]) ? record + 2 : NULL;
+}
+
+// Copy the record of the element with ID element_id to record and return
+// the copy's payload, or NULL if there is none
+static uint8_t const* find_element_payload(usb_midi_descriptor_info_t const* info, uint8_t element_id, uint8_t* record)
+{
+  if (!info->configured || info->num_elements == 0 ||
+    element_id < info->element_id_first || element_id > info->element_id_last)
+    return NULL;
+  uint8_t const* directory = element_table(info) + 2 * info->num_elements;
+  uint8_t element = load_byte(directory + element_id - info->element_id_first);
+  return element ? element_payload(info, element - 1, record) : NULL;
+}
+
+// Load the fields of device dev that element_payload() and find_element_payload() read to info.
+// Return false if the device is not configured.
+static bool load_elements(usb_midi_descriptor_info_t* info, const usb_midi_descriptor_info_t* dev)
+{
+  info->configured = LOAD(dev->configured);
+  if (!info->configured)
+    return false;
+  load_tables(info, dev);
+  info->num_elements = LOAD(dev->num_elements);
+  info->element_id_first = LOAD(dev->element_id_first);
+  info->element_id_last = LOAD(dev->element_id_last);
+  return true;
+}
+
+// Copy the fields of an element record payload to the caller
+static void get_element_fields(uint8_t const* payload, usb_midi_descriptor_lib_element_t* element)
+{
+  uint8_t num_pins = payload[1];
+  uint8_t caps_size = payload[5 + 2 * num_pins];
+  element->id = payload[0];
+  element->num_in_pins = num_pins;
+  element->num_out_pins = payload[2 + 2 * num_pins];
+  element->in_terminal_link = payload[3 + 2 * num_pins];
+  element->out_terminal_link = payload[4 + 2 * num_pins];
+  element->str_idx = payload[6 + 2 * num_pins + caps_size];
+  // Only the first 32 capability bits are kept; the USB MIDI 1.0 specification defines 12
+  element->caps = 0;
+  for (uint8_t byte = 0; byte < caps_size && byte < 4; byte++)
+    element->caps |= (uint32_t)payload[6 + 2 * num_pins + byte] << (8 * byte);
+}
+
+// Fill in the cable string indices and the string index list of the summary of view device info
+static void view_summary(usb_midi_descriptor_info_t const* info, usb_midi_descriptor_lib_device_summary_t* summary)
+{
+  for (uint8_t ep_num = 0; ep_num < info->num_in_eps; ep_num++)
+  {
+    for (uint8_t cable_num = 0; cable_pos(info->in_eps, info->num_in_eps, info->num_in_cables, ep_num, cable_num) >= 0; cable_num++)
+      summary->in_cable_str_idx[info->in_eps[ep_num].first_cable + cable_num] = view_cable_str_idx(info, true, ep_num, cable_num);
+  }
+  for (uint8_t ep_num = 0; ep_num < info->num_out_eps; ep_num++)
+  {
+    for (uint8_t cable_num = 0; cable_pos(info->out_eps, info->num_out_eps, info->num_out_cables, ep_num, cable_num) >= 0; cable_num++)
+      summary->out_cable_str_idx[info->out_eps[ep_num].first_cable + cable_num] = view_cable_str_idx(info, false, ep_num, cable_num);
+  }
+  view_string_indices(info, summary->string_indices, info->num_string_indices);
+}
+
+bool usb_midi_descriptor_lib_dev_get_device_summary(const usb_midi_descriptor_info_t* dev, usb_midi_descriptor_lib_device_summary_t* summary)
+{
+  TU_VERIFY(dev != NULL);
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  do
+  {
+    seq = read_snapshot(dev, &info);
+    if (!info.configured)
+      continue;
+    summary->itf_str_idx = info.itf_str_idx;
+    summary->num_in_eps = info.num_in_eps;
+    summary->num_out_eps = info.num_out_eps;
+    for (uint8_t ep_num = 0; ep_num < info.num_in_eps; ep_num++)
+    {
+      summary->in_ep_addrs[ep_num] = info.in_eps[ep_num].ep_addr;
+      summary->in_ep_num_cables[ep_num] = info.in_eps[ep_num].num_cables;
+    }
+    for (uint8_t ep_num = 0; ep_num < info.num_out_eps; ep_num++)
+    {
+      summary->out_ep_addrs[ep_num] = info.out_eps[ep_num].ep_addr;
+      summary->out_ep_num_cables[ep_num] = info.out_eps[ep_num].num_cables;
+    }
+    summary->num_in_cables = info.num_in_cables;
+    summary->num_out_cables = info.num_out_cables;
+    summary->num_string_indices = info.num_string_indices;
+    if (info.view)
+    {
+      view_summary(&info, summary);
+      continue;
+    }
+    // The cable tables and the string index list are next to each other in the block
+    uint8_t const* tables = info.block + info.tables;
+    load_bytes(summary->in_cable_str_idx, tables, info.num_in_cables);
+    tables += info.num_in_cables;
+    load_bytes(summary->out_cable_str_idx, tables, info.num_out_cables);
+    tables += info.num_out_cables;
+    load_bytes(summary->string_indices, tables, info.num_string_indices);
+  } while (read_retry(dev, seq));
+  return info.configured;
+}
+
+uint8_t usb_midi_descriptor_lib_dev_get_num_elements(const usb_midi_descriptor_info_t* dev)
+{
+  if (dev == NULL)
+    return 0;
+  unsigned seq;
+  uint8_t num_elements;
+  do
+  {
+    seq = read_begin(dev);
+    num_elements = LOAD(dev->configured) ? LOAD(dev->num_elements) : 0;
+  } while (read_retry(dev, seq));
+  return num_elements;
+}
+
+bool usb_midi_descriptor_lib_dev_get_element(const usb_midi_descriptor_info_t* dev, uint8_t elem_num, usb_midi_descriptor_lib_element_t* element)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint8_t record[MAX_RECORD_LEN];
+  uint8_t const* payload;
+  do
+  {
+    seq = read_begin(dev);
+    payload = NULL;
+    if (!load_elements(&info, dev) || read_retry(dev, seq))
+      continue;
+    payload = element_payload(&info, elem_num, record);
+    if (payload)
+      get_element_fields(payload, element);
+  } while (read_retry(dev, seq));
+  return payload != NULL;
+}
+
+bool usb_midi_descriptor_lib_dev_find_element(const usb_midi_descriptor_info_t* dev, uint8_t element_id, usb_midi_descriptor_lib_element_t* element)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint8_t record[MAX_RECORD_LEN];
+  uint8_t const* payload;
+  do
+  {
+    seq = read_begin(dev);
+    payload = NULL;
+    if (!load_elements(&info, dev) || read_retry(dev, seq))
+      continue;
+    payload = find_element_payload(&info, element_id, record);
+    if (payload)
+      get_element_fields(payload, element);
+  } while (read_retry(dev, seq));
+  return payload != NULL;
+}
+
+bool usb_midi_descriptor_lib_dev_get_element_source(const usb_midi_descriptor_info_t* dev, uint8_t element_id, uint8_t pin,
+  uint8_t* source_id, uint8_t* source_pin)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint8_t record[MAX_RECORD_LEN];
+  bool found;
+  do
+  {
+    seq = read_begin(dev);
+    found = false;
+    if (!load_elements(&info, dev) || read_retry(dev, seq))
+      continue;
+    uint8_t const* payload = find_element_payload(&info, element_id, record);
+    found = payload != NULL && pin < payload[1];
+    if (found)
+    {
+      *source_id = payload[2 + 2 * pin];
+      *source_pin = payload[3 + 2 * pin];
+    }
+  } while (read_retry(dev, seq));
+  return found;
+}
+
+// Copy the record of Audio Control entity number entity_num to record, which
+// has room for AUDIO_ENTITY_RECORD_LEN bytes, and return the copy's payload,
+// or NULL if there is none
+static uint8_t const* audio_entity_payload(usb_midi_descriptor_info_t const* info, uint8_t entity_num, uint8_t* record)
+{
+  uint32_t offset = (uint32_t)AUDIO_ENTITY_RECORD_LEN * entity_num;
+  if (!info->configured || entity_num >= info->num_audio_entities || offset + AUDIO_ENTITY_RECORD_LEN > info->tables)
+    return NULL;
+  load_bytes(record, info->block + offset, AUDIO_ENTITY_RECORD_LEN);
+  return record[0] == RECORD_AUDIO_ENTITY && record[1] == AUDIO_ENTITY_RECORD_LEN - 2 ? record + 2 : NULL;
+}
+
+// Load the fields of device dev that audio_entity_payload() reads to info.
+// Return false if the device is not configured.
+static bool load_audio_entities(usb_midi_descriptor_info_t* info, const usb_midi_descriptor_info_t* dev)
+{
+  info->configured = LOAD(dev->configured);
+  if (!info->configured)
+    return false;
+  info->num_audio_entities = LOAD(dev->num_audio_entities);
+  info->block = LOAD(dev->block);
+  info->tables = LOAD(dev->tables);
+  return true;
+}
+
+// Copy the fields of an Audio Control entity record payload to the caller
+static void get_audio_entity_fields(uint8_t const* payload, usb_midi_descriptor_lib_audio_entity_t* entity)
+{
+  entity->subtype = payload[0];
+  entity->id = payload[1];
+  entity->terminal_type = payload[2] | (payload[3] << 8);
+  entity->str_idx = payload[4];
+  entity->protocol = payload[5];
+}
+
+uint8_t usb_midi_descriptor_lib_dev_get_num_audio_entities(const usb_midi_descriptor_info_t* dev)
+{
+  if (dev == NULL)
+    return 0;
+  unsigned seq;
+  uint8_t num_entities;
+  do
+  {
+    seq = read_begin(dev);
+    num_entities = LOAD(dev->configured) ? LOAD(dev->num_audio_entities) : 0;
+  } while (read_retry(dev, seq));
+  return num_entities;
+}
+
+bool usb_midi_descriptor_lib_dev_get_audio_entity(const usb_midi_descriptor_info_t* dev, uint8_t entity_num,
+  usb_midi_descriptor_lib_audio_entity_t* entity)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint8_t record[AUDIO_ENTITY_RECORD_LEN];
+  uint8_t const* payload;
+  do
+  {
+    seq = read_begin(dev);
+    payload = NULL;
+    if (!load_audio_entities(&info, dev) || read_retry(dev, seq))
+      continue;
+    payload = audio_entity_payload(&info, entity_num, record);
+    if (payload)
+      get_audio_entity_fields(payload, entity);
+  } while (read_retry(dev, seq));
+  return payload != NULL;
+}
+
+bool usb_midi_descriptor_lib_dev_find_audio_entity(const usb_midi_descriptor_info_t* dev, uint8_t id,
+  usb_midi_descriptor_lib_audio_entity_t* entity)
+{
+  if (dev == NULL)
+    return false;
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint8_t record[AUDIO_ENTITY_RECORD_LEN];
+  uint8_t const* payload;
+  do
+  {
+    seq = read_begin(dev);
+    payload = NULL;
+    if (!load_audio_entities(&info, dev) || read_retry(dev, seq))
+      continue;
+    // Terminals, units and clock entities share one ID space, so the first match is the only one
+    for (uint8_t entity_num = 0; entity_num < info.num_audio_entities && payload == NULL; entity_num++)
+    {
+      payload = audio_entity_payload(&info, entity_num, record);
+      if (payload == NULL)
+        break;
+      if (payload[1] != id)
+        payload = NULL;
+    }
+    if (payload)
+      get_audio_entity_fields(payload, entity);
+  } while (read_retry(dev, seq));
+  return payload != NULL;
+}
+
+bool usb_midi_descriptor_lib_dev_get_stats(const usb_midi_descriptor_info_t* dev, usb_midi_descriptor_lib_stats_t* stats)
+{
+  TU_VERIFY(dev != NULL);
+  *stats = dev->stats;
+  return true;
+}
+
+void usb_midi_descriptor_lib_set_time_source(usb_midi_descriptor_lib_time_us_t time_us)
+{
+  time_source = time_us;
+}
+
+uint16_t usb_midi_descriptor_lib_dev_get_bytes_used(const usb_midi_descriptor_info_t* dev)
+{
+  if (dev == NULL)
+    return 0;
+  unsigned seq;
+  uint16_t arena_len;
+  do
+  {
+    seq = read_begin(dev);
+    arena_len = LOAD(dev->configured) ? LOAD(dev->arena_len) : 0;
+  } while (read_retry(dev, seq));
+  return sizeof(*dev) + arena_len;
+}
+
+void usb_midi_descriptor_lib_arena_init(usb_midi_descriptor_lib_arena_t* arena, uint8_t* bytes, uint16_t size)
+{
+  arena->bytes = bytes;
+  arena->size = size;
+  arena->used = 0;
+  arena->first_block = NULL;
+}
+
+uint16_t usb_midi_descriptor_lib_arena_bytes_free(const usb_midi_descriptor_lib_arena_t* arena)
+{
+  return arena->size - arena->used;
+}
+
+// The saved form of a device slot is these header bytes, then 3 bytes
+// (ep_addr, num_cables, first_cable) per IN endpoint and per OUT endpoint,
+// then the slot's arena block. The 16-bit values are little endian.
+enum
+{
+  SAVED_NUM_IN_EPS = 0,
+  SAVED_NUM_OUT_EPS,
+  SAVED_NUM_IN_JACKS,
+  SAVED_NUM_OUT_JACKS,
+  SAVED_NUM_IN_CABLES,
+  SAVED_NUM_OUT_CABLES,
+  SAVED_NUM_STRING_INDICES,
+  SAVED_NUM_ELEMENTS,
+  SAVED_ELEMENT_ID_FIRST,
+  SAVED_ELEMENT_ID_LAST,
+  SAVED_ITF_STR_IDX,
+  SAVED_NUM_AUDIO_ENTITIES,
+  SAVED_TABLES,               // 2 bytes
+  SAVED_ARENA_LEN = SAVED_TABLES + 2, // 2 bytes
+  SAVED_HEADER_LEN = SAVED_ARENA_LEN + 2
+};
+
+// Save a copy of a device slot; see usb_midi_descriptor_lib_save()
+static uint16_t save_slot(usb_midi_descriptor_info_t const* info, uint8_t* buf, uint16_t maxlen)
+{
+  TU_VERIFY(info->configured && !info->view, 0);
+  uint16_t block_len = info->arena_len ? info->arena_len : info->in_place_len;
+  uint32_t len = SAVED_HEADER_LEN + 3 * (info->num_in_eps + info->num_out_eps) + block_len;
+  if (buf == NULL)
+    return len;
+  TU_VERIFY(len <= maxlen, 0);
+  buf[SAVED_NUM_IN_EPS] = info->num_in_eps;
+  buf[SAVED_NUM_OUT_EPS] = info->num_out_eps;
+  buf[SAVED_NUM_IN_JACKS] = info->num_in_jacks;
+  buf[SAVED_NUM_OUT_JACKS] = info->num_out_jacks;
+  buf[SAVED_NUM_IN_CABLES] = info->num_in_cables;
+  buf[SAVED_NUM_OUT_CABLES] = info->num_out_cables;
+  buf[SAVED_NUM_STRING_INDICES] = info->num_string_indices;
+  buf[SAVED_NUM_ELEMENTS] = info->num_elements;
+  buf[SAVED_ELEMENT_ID_FIRST] = info->element_id_first;
+  buf[SAVED_ELEMENT_ID_LAST] = info->element_id_last;
+  buf[SAVED_ITF_STR_IDX] = info->itf_str_idx;
+  buf[SAVED_NUM_AUDIO_ENTITIES] = info->num_audio_entities;
+  buf[SAVED_TABLES] = info->tables & 0xFF;
+  buf[SAVED_TABLES + 1] = info->tables >> 8;
+  buf[SAVED_ARENA_LEN] = block_len & 0xFF;
+  buf[SAVED_ARENA_LEN + 1] = block_len >> 8;
+  uint8_t* ep = buf + SAVED_HEADER_LEN;
+  for (uint8_t ep_num = 0; ep_num < info->num_in_eps; ep_num++, ep += 3)
+  {
+    ep[0] = info->in_eps[ep_num].ep_addr;
+    ep[1] = info->in_eps[ep_num].num_cables;
+    ep[2] = info->in_eps[ep_num].first_cable;
+  }
+  for (uint8_t ep_num = 0; ep_num < info->num_out_eps; ep_num++, ep += 3)
+  {
+    ep[0] = info->out_eps[ep_num].ep_addr;
+    ep[1] = info->out_eps[ep_num].num_cables;
+    ep[2] = info->out_eps[ep_num].first_cable;
+  }
+  load_bytes(ep, info->block, block_len);
+  return len;
+}
+
+uint16_t usb_midi_descriptor_lib_dev_save(const usb_midi_descriptor_info_t* dev, uint8_t* buf, uint16_t maxlen)
+{
+  TU_VERIFY(dev != NULL, 0);
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint16_t len;
+  do
+  {
+    seq = read_snapshot(dev, &info);
+    len = save_slot(&info, buf, maxlen);
+  } while (read_retry(dev, seq));
+  return len;
+}
+
+// Configure device dev from saved data, copying the block to the arena or reading it in place
+static bool restore_slot(usb_midi_descriptor_info_t* dev, const uint8_t* buf, uint16_t len, bool in_place)
+{
+  TU_VERIFY(dev != NULL);
+  usb_midi_descriptor_lib_dev_init(dev);
+  TU_VERIFY(len >= SAVED_HEADER_LEN);
+  uint8_t num_in_eps = buf[SAVED_NUM_IN_EPS];
+  uint8_t num_out_eps = buf[SAVED_NUM_OUT_EPS];
+  uint16_t tables = buf[SAVED_TABLES] | (buf[SAVED_TABLES + 1] << 8);
+  uint16_t arena_len = buf[SAVED_ARENA_LEN] | (buf[SAVED_ARENA_LEN + 1] << 8);
+  // Check everything the getters rely on before touching the slot
+  TU_VERIFY(num_in_eps <= MAX_IN_ENDPOINTS && num_out_eps <= MAX_OUT_ENDPOINTS);
+  TU_VERIFY(buf[SAVED_NUM_IN_CABLES] <= MAX_IN_CABLES && buf[SAVED_NUM_OUT_CABLES] <= MAX_OUT_CABLES);
+  TU_VERIFY(buf[SAVED_NUM_STRING_INDICES] <= MAX_STRING_INDICES);
+  TU_VERIFY((uint32_t)SAVED_HEADER_LEN + 3 * (num_in_eps + num_out_eps) + arena_len == len);
+  uint8_t num_elements = buf[SAVED_NUM_ELEMENTS];
+  uint8_t element_id_first = buf[SAVED_ELEMENT_ID_FIRST];
+  uint8_t element_id_last = buf[SAVED_ELEMENT_ID_LAST];
+  TU_VERIFY(num_elements == 0 || element_id_first <= element_id_last);
+  uint16_t directory_len = num_elements ? element_id_last - element_id_first + 1 : 0;
+  uint32_t elements = (uint32_t)tables + 3 * (buf[SAVED_NUM_IN_CABLES] + buf[SAVED_NUM_OUT_CABLES]) +
+    buf[SAVED_NUM_STRING_INDICES];
+  TU_VERIFY(elements + 2 * num_elements + directory_len <= arena_len);
+  // Every element offset must lead to a whole element record, and every directory entry to an offset
+  uint8_t const* saved_block = buf + len - arena_len;
+  for (uint8_t element = 0; element < num_elements; element++)
+  {
+    uint16_t offset = saved_block[elements + 2 * element] | (saved_block[elements + 2 * element + 1] << 8);
+    TU_VERIFY((uint32_t)offset + 2 <= tables && saved_block[offset] == RECORD_ELEMENT);
+    TU_VERIFY((uint32_t)offset + 2 + saved_block[offset + 1] <= tables);
+    TU_VERIFY(element_payload_ok(saved_block + offset + 2, saved_block[offset + 1]));
+  }
+  for (uint16_t id = 0; id < directory_len; id++)
+    TU_VERIFY(saved_block[elements + 2 * num_elements + id] <= num_elements);
+  usb_midi_descriptor_info_t* info = dev;
+  if (in_place)
+  {
+    STORE(info->block, saved_block);
+    STORE(info->in_place_len, arena_len);
+  }
+  else
+  {
+    uint8_t* block = arena_grow(dev, arena_len);
+    TU_VERIFY(block != NULL);
+    store_bytes(block, saved_block, arena_len);
+  }
+  STORE(info->num_in_eps, num_in_eps);
+  STORE(info->num_out_eps, num_out_eps);
+  STORE(info->num_in_jacks, buf[SAVED_NUM_IN_JACKS]);
+  STORE(info->num_out_jacks, buf[SAVED_NUM_OUT_JACKS]);
+  STORE(info->num_in_cables, buf[SAVED_NUM_IN_CABLES]);
+  STORE(info->num_out_cables, buf[SAVED_NUM_OUT_CABLES]);
+  STORE(info->num_string_indices, buf[SAVED_NUM_STRING_INDICES]);
+  STORE(info->num_elements, num_elements);
+  STORE(info->element_id_first, element_id_first);
+  STORE(info->element_id_last, element_id_last);
+  STORE(info->itf_str_idx, buf[SAVED_ITF_STR_IDX]);
+  STORE(info->num_audio_entities, buf[SAVED_NUM_AUDIO_ENTITIES]); // the getters check each record
+  STORE(info->tables, tables);
+  const uint8_t* ep = buf + SAVED_HEADER_LEN;
+  for (uint8_t ep_num = 0; ep_num < num_in_eps; ep_num++, ep += 3)
+  {
+    STORE(info->in_eps[ep_num].ep_addr, ep[0]);
+    STORE(info->in_eps[ep_num].num_cables, ep[1]);
+    STORE(info->in_eps[ep_num].first_cable, ep[2]);
+  }
+  for (uint8_t ep_num = 0; ep_num < num_out_eps; ep_num++, ep += 3)
+  {
+    STORE(info->out_eps[ep_num].ep_addr, ep[0]);
+    STORE(info->out_eps[ep_num].num_cables, ep[1]);
+    STORE(info->out_eps[ep_num].first_cable, ep[2]);
+  }
+  publish(dev);
+  return true;
+}
+
+bool usb_midi_descriptor_lib_dev_restore(usb_midi_descriptor_info_t* dev, const uint8_t* buf, uint16_t len)
+{
+  return restore_slot(dev, buf, len, false);
+}
+
+bool usb_midi_descriptor_lib_dev_restore_in_place(usb_midi_descriptor_info_t* dev, const uint8_t* buf, uint16_t len)
+{
+  return restore_slot(dev, buf, len, true);
+}
+
+// Renumber a string index for the device side copy of the interface; see
+// usb_midi_descriptor_lib_build_device_descriptor()
+static uint8_t device_str_idx(usb_midi_descriptor_info_t const* info, uint8_t first_str_idx, uint8_t str_idx)
+{
+  if (first_str_idx == 0 || str_idx == 0)
+    return 0;
+  uint8_t const* all_string_indices = info->block + info->tables + info->num_in_cables + info->num_out_cables;
+  for (uint16_t pos = 0; pos < info->num_string_indices; pos++)
+  {
+    if (load_byte(all_string_indices + pos) == str_idx)
+      return first_str_idx + pos <= 0xFF ? first_str_idx + pos : 0;
+  }
+  return 0;
+}
+
+// Copy the record at pos to record, which has room for MAX_RECORD_LEN bytes.
+// Return where the next record starts, or NULL if the record does not end
+// by records_end, which a reader on another core can see while the writer
+// moves the block.
+static uint8_t const* load_record(uint8_t const* pos, uint8_t const* records_end, uint8_t* record)
+{
+  if (pos + 2 > records_end)
+    return NULL;
+  load_bytes(record, pos, 2);
+  if (pos + 2 + record[1] > records_end)
+    return NULL;
+  load_bytes(record + 2, pos + 2, record[1]);
+  return pos + 2 + record[1];
+}
+
+// Return the number of bytes of device side descriptors a copy of a record
+// becomes; 0 for a record that becomes none
+static uint16_t record_desc_len(uint8_t const* record)
+{
+  uint8_t const* payload = record + 2;
+  switch (record[0])
+  {
+    case RECORD_IN_JACK:
+      return record[1] >= 3 ? 6 : 0;
+    case RECORD_OUT_JACK:
+      return record[1] >= 4 && record[1] >= 4 + 2 * payload[3] ? 7 + 2 * payload[3] : 0;
+    case RECORD_ELEMENT:
+      return element_payload_ok(payload, record[1]) ? 3 + record[1] : 0;
+    case RECORD_ENDPOINT:
+      return record[1] >= 2 && record[1] >= 2 + payload[1] ? 9 + 4 + payload[1] : 0;
+    default:
+      return 0;
+  }
+}
+
+// Build the device side copy of a copy of a device slot; see usb_midi_descriptor_lib_build_device_descriptor()
+static uint16_t build_device_descriptor(usb_midi_descriptor_info_t const* info, const usb_midi_descriptor_lib_device_cfg_t* cfg,
+  uint8_t* buf, uint16_t maxlen)
+{
+  TU_VERIFY(info->configured && !info->view, 0);
+  uint8_t const* records_end = info->block + info->tables;
+  uint8_t record[MAX_RECORD_LEN];
+  // Size everything first so nothing is written unless it all fits
+  uint32_t len = 9 + 7;
+  uint8_t num_in_eps = 0;
+  uint8_t num_out_eps = 0;
+  for (uint8_t const* pos = info->block; (pos = load_record(pos, records_end, record)) != NULL; )
+  {
+    uint16_t desc_len = record_desc_len(record);
+    len += desc_len;
+    if (desc_len != 0 && record[0] == RECORD_ENDPOINT)
+    {
+      if (tu_edpt_dir(record[2]) == TUSB_DIR_IN)
+        ++num_in_eps;
+      else
+        ++num_out_eps;
+    }
+  }
+  // Every endpoint needs a device side address from cfg
+  TU_VERIFY(num_in_eps <= MAX_IN_ENDPOINTS && num_out_eps <= MAX_OUT_ENDPOINTS, 0);
+  TU_VERIFY(len <= 0xFFFF, 0);
+  if (buf == NULL)
+    return len;
+  TU_VERIFY(len <= maxlen, 0);
+
+  uint8_t* desc = buf;
+  // Standard MIDI Streaming interface descriptor
+  desc[0] = 9;
+  desc[1] = TUSB_DESC_INTERFACE;
+  desc[2] = cfg->itf_num;
+  desc[3] = 0; // bAlternateSetting
+  desc[4] = num_in_eps + num_out_eps;
+  desc[5] = TUSB_CLASS_AUDIO;
+  desc[6] = AUDIO_SUBCLASS_MIDI_STREAMING;
+  desc[7] = 0; // bInterfaceProtocol
+  desc[8] = device_str_idx(info, cfg->first_str_idx, info->itf_str_idx);
+  desc += 9;
+  // Class-specific MIDI Streaming interface header; wTotalLength covers
+  // the header, the jacks and the endpoints
+  uint16_t total_len = len - 9;
+  desc[0] = 7;
+  desc[1] = TUSB_DESC_CS_INTERFACE;
+  desc[2] = MIDI_CS_INTERFACE_HEADER;
+  desc[3] = 0x00; // bcdMSC 1.00
+  desc[4] = 0x01;
+  desc[5] = total_len & 0xFF;
+  desc[6] = total_len >> 8;
+  desc += 7;
+  // The jacks and elements, in the order the MIDI device listed them. A
+  // block that changed since it was sized is only read, never overrun.
+  for (uint8_t const* pos = info->block; (pos = load_record(pos, records_end, record)) != NULL; )
+  {
+    uint8_t const* payload = record + 2;
+    uint16_t desc_len = record_desc_len(record);
+    if (desc_len == 0 || record[0] == RECORD_ENDPOINT)
+      continue;
+    TU_VERIFY(desc + desc_len <= buf + len, 0);
+    if (record[0] == RECORD_IN_JACK)
+    {
+      desc[0] = 6;
+      desc[1] = TUSB_DESC_CS_INTERFACE;
+      desc[2] = MIDI_CS_INTERFACE_IN_JACK;
+      desc[3] = payload[1]; // bJackType
+      desc[4] = payload[0]; // bJackID
+      desc[5] = device_str_idx(info, cfg->first_str_idx, payload[2]);
+    }
+    else if (record[0] == RECORD_OUT_JACK)
+    {
+      uint8_t num_pins = payload[3];
+      desc[0] = 7 + 2 * num_pins;
+      desc[1] = TUSB_DESC_CS_INTERFACE;
+      desc[2] = MIDI_CS_INTERFACE_OUT_JACK;
+      desc[3] = payload[1]; // bJackType
+      desc[4] = payload[0]; // bJackID
+      desc[5] = num_pins;
+      for (uint8_t pin = 0; pin < 2 * num_pins; pin++)
+        desc[6 + pin] = payload[4 + pin]; // baSourceID/baSourcePin pairs
+      desc[6 + 2 * num_pins] = device_str_idx(info, cfg->first_str_idx, payload[2]);
+    }
+    else
+    {
+      // The record is the Element descriptor from bElementID on; only iElement changes
+      uint8_t str_pos = 6 + 2 * payload[1] + payload[5 + 2 * payload[1]];
+      desc[0] = 3 + record[1];
+      desc[1] = TUSB_DESC_CS_INTERFACE;
+      desc[2] = MIDI_CS_INTERFACE_ELEMENT;
+      memcpy(desc + 3, payload, record[1]);
+      desc[3 + str_pos] = device_str_idx(info, cfg->first_str_idx, payload[str_pos]);
+    }
+    desc += desc_len;
+  }
+  // The endpoints, each with its embedded jacks
+  num_in_eps = 0;
+  num_out_eps = 0;
+  for (uint8_t const* pos = info->block; (pos = load_record(pos, records_end, record)) != NULL; )
+  {
+    uint8_t const* payload = record + 2;
+    uint16_t desc_len = record_desc_len(record);
+    if (desc_len == 0 || record[0] != RECORD_ENDPOINT)
+      continue;
+    TU_VERIFY(desc + desc_len <= buf + len, 0);
+    uint8_t num_jacks = payload[1];
+    desc[0] = 9;
+    desc[1] = TUSB_DESC_ENDPOINT;
+    if (tu_edpt_dir(payload[0]) == TUSB_DIR_IN)
+    {
+      TU_VERIFY(num_in_eps < MAX_IN_ENDPOINTS, 0);
+      desc[2] = cfg->in_ep_addrs[num_in_eps++];
+    }
+    else
+    {
+      TU_VERIFY(num_out_eps < MAX_OUT_ENDPOINTS, 0);
+      desc[2] = cfg->out_ep_addrs[num_out_eps++];
+    }
+    desc[3] = TUSB_XFER_BULK;
+    desc[4] = cfg->ep_size & 0xFF;
+    desc[5] = cfg->ep_size >> 8;
+    desc[6] = 0; // bInterval
+    desc[7] = 0; // bRefresh
+    desc[8] = 0; // bSynchAddress
+    desc += 9;
+    desc[0] = 4 + num_jacks;
+    desc[1] = TUSB_DESC_CS_ENDPOINT;
+    desc[2] = MIDI_CS_ENDPOINT_GENERAL;
+    desc[3] = num_jacks;
+    for (uint8_t jack = 0; jack < num_jacks; jack++)
+      desc[4 + jack] = payload[2 + jack]; // baAssocJackID
+    desc += 4 + num_jacks;
+  }
+  return len;
+}
+
+uint16_t usb_midi_descriptor_lib_dev_build_device_descriptor(const usb_midi_descriptor_info_t* dev, const usb_midi_descriptor_lib_device_cfg_t* cfg,
+  uint8_t* buf, uint16_t maxlen)
+{
+  TU_VERIFY(dev != NULL, 0);
+  usb_midi_descriptor_info_t info;
+  unsigned seq;
+  uint16_t len;
+  do
+  {
+    seq = read_snapshot(dev, &info);
+    len = build_device_descriptor(&info, cfg, buf, maxlen);
+  } while (read_retry(dev, seq));
+  return len;
+}
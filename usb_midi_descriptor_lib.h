@@ -26,25 +26,28 @@
 /*
  * This library extracts all the string indices from a USB MIDI device's
  * interface descriptors and provides an API for retrieving them.
- * It assumes that there is at most one IN endpoint and/or one OUT endpoint
- * for the MIDI device. If the device has two or more MIDI IN endpoints
- * or two or more MIDI OUT endpoints, then this library will fail.
+ * A MIDI device may have up to MAX_IN_ENDPOINTS MIDI IN endpoints and up to
+ * MAX_OUT_ENDPOINTS MIDI OUT endpoints. The cables of all the endpoints in
+ * one direction share the MAX_IN_CABLES or MAX_OUT_CABLES cable tables.
+ *
+ * One thread or core, the writer, calls the init, configure, parser and
+ * restore functions. Any thread or core may call the getters at the same
+ * time: each device slot has a sequence number, and a getter that overlaps
+ * the writer changing the slot tries again. A getter never waits for a lock
+ * and never sees a half configured slot. The writer and the getters access
+ * the slots and the arena with relaxed atomics, so the retried reads are
+ * not data races.
  */
 
 
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
 #include "tusb.h"
 #ifndef MAX_STRING_INDICES
 #define MAX_STRING_INDICES 40
 #endif
-#ifndef MAX_IN_JACKS
-#define MAX_IN_JACKS 16
-#endif
-
-#ifndef MAX_OUT_JACKS
-#define MAX_OUT_JACKS 16
-#endif
 
 #ifndef MAX_IN_CABLES
 #define MAX_IN_CABLES 16
@@ -54,8 +57,292 @@
 #define MAX_OUT_CABLES 16
 #endif
 
+#ifndef MAX_IN_ENDPOINTS
+#define MAX_IN_ENDPOINTS 2
+#endif
+
+#ifndef MAX_OUT_ENDPOINTS
+#define MAX_OUT_ENDPOINTS 2
+#endif
+
+// The number of bytes the device slots of the index API share for their
+// jack, cable and string index data. Configuring a device fails if its data
+// does not fit. Arenas the application provides have sizes of their own.
+#ifndef USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE
+#define USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE (CFG_TUH_MIDI * 256)
+#endif
+
+// Descriptors in the MIDI Streaming interface that arrive split across
+// calls to usb_midi_descriptor_parser_feed() must fit in this many bytes
+#ifndef USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE
+#define USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE 64
+#endif
+
+typedef struct usb_midi_descriptor_info_s usb_midi_descriptor_info_t;
+
+/**
+ * @brief Scratch state needed only while a device slot is being configured
+ *
+ * The fields are private to the library.
+ */
+typedef struct
+{
+  usb_midi_descriptor_info_t* dev; // the device being configured
+  uint8_t prev_ep_addr;            // the endpoint the next CS endpoint descriptor describes
+  uint8_t num_strings;             // the number of unique string indices found so far
+  uint8_t string_index_bitmap[32]; // bit n is set if string index n has been found
+  uint8_t num_elements;            // the number of elements found so far, up to 255
+  uint8_t element_id_first;        // the smallest element ID found so far
+  uint8_t element_id_last;         // the largest element ID found so far
+  bool in_audio_control;           // the descriptors are in the Audio Control interface
+  uint8_t ac_protocol;             // the Audio Control interface's bInterfaceProtocol
+  uint64_t start_us;               // when the parse started, for the slot's statistics
+  uint8_t in_cable_jack_ids[MAX_IN_CABLES];  // the jack associated with each IN endpoint cable
+  uint8_t out_cable_jack_ids[MAX_OUT_CABLES];// the jack associated with each OUT endpoint cable
+} usb_midi_descriptor_parse_ctx_t;
+
+/**
+ * @brief State for parsing a configuration descriptor that arrives in pieces
+ *
+ * The application owns the storage; the fields are private to the library.
+ */
+typedef struct
+{
+  usb_midi_descriptor_parse_ctx_t ctx;
+  uint16_t total_len;   // wTotalLength once the configuration descriptor header has arrived
+  uint16_t offset;      // number of configuration descriptor bytes consumed so far
+  uint8_t state;
+  uint8_t desc_len;     // bLength of the descriptor split across calls to feed
+  uint8_t desc_have;    // number of bytes of that descriptor received so far
+  uint8_t desc[USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE];
+} usb_midi_descriptor_parser_t;
+
+/**
+ * @brief A bounds checked walk over a buffer of USB descriptors
+ *
+ * The application owns the storage; read the first six fields after each
+ * successful call to usb_midi_descriptor_lib_iter_next().
+ */
+typedef struct
+{
+  const uint8_t* desc;  // the current descriptor; all len bytes of it are in the buffer
+  uint8_t len;          // its bLength
+  uint8_t type;         // its bDescriptorType
+  uint8_t subtype;      // its third byte, bDescriptorSubType for class-specific descriptors; 0 if len is 2
+  uint32_t offset;      // where it starts in the buffer
+  uint32_t remaining;   // the number of bytes from its start to the end of the buffer
+  bool malformed;       // the walk stopped at a bLength less than 2 or past the end of the buffer
+} usb_midi_descriptor_lib_iter_t;
+
+/**
+ * @brief Where one MIDI Streaming interface is in a configuration descriptor
+ */
+typedef struct
+{
+  uint8_t itf_num;          // bInterfaceNumber
+  uint8_t alt;              // bAlternateSetting
+  uint8_t control_str_idx;  // iInterface of the Audio Control interface before it, if any
+  uint16_t offset;          // where the interface descriptor starts in the configuration descriptor
+  uint16_t len;             // the number of bytes up to the next interface descriptor, IAD or the end
+  uint16_t control_offset;  // where the Audio Control interface descriptor before it starts, if any
+  uint16_t control_len;     // the number of bytes of that interface up to the next interface descriptor or IAD; 0 if none
+} usb_midi_descriptor_lib_interface_t;
+
+/**
+ * @brief The bmElementCaps bits of a MIDI Element
+ */
+typedef enum
+{
+  USB_MIDI_ELEMENT_CAPS_CUSTOM         = 1u << 0,  // undefined or vendor specific
+  USB_MIDI_ELEMENT_CAPS_MIDI_CLOCK     = 1u << 1,
+  USB_MIDI_ELEMENT_CAPS_MTC            = 1u << 2,  // MIDI Time Code
+  USB_MIDI_ELEMENT_CAPS_MMC            = 1u << 3,  // MIDI Machine Control
+  USB_MIDI_ELEMENT_CAPS_GM1            = 1u << 4,
+  USB_MIDI_ELEMENT_CAPS_GM2            = 1u << 5,
+  USB_MIDI_ELEMENT_CAPS_GS             = 1u << 6,
+  USB_MIDI_ELEMENT_CAPS_XG             = 1u << 7,
+  USB_MIDI_ELEMENT_CAPS_EFX            = 1u << 8,
+  USB_MIDI_ELEMENT_CAPS_MIDI_PATCH_BAY = 1u << 9,
+  USB_MIDI_ELEMENT_CAPS_DLS1           = 1u << 10,
+  USB_MIDI_ELEMENT_CAPS_DLS2           = 1u << 11,
+} usb_midi_element_caps_t;
+
+/**
+ * @brief A MIDI Element of a configured device slot
+ */
+typedef struct
+{
+  uint8_t id;                 // bElementID
+  uint8_t num_in_pins;        // bNrInputPins
+  uint8_t num_out_pins;       // bNrOutputPins
+  uint8_t in_terminal_link;   // bInTerminalLink; 0 if the element is not linked to an Audio Terminal
+  uint8_t out_terminal_link;  // bOutTerminalLink; 0 if the element is not linked to an Audio Terminal
+  uint8_t str_idx;            // iElement
+  uint32_t caps;              // the first 32 bits of bmElementCaps; see usb_midi_element_caps_t
+} usb_midi_descriptor_lib_element_t;
+
+/**
+ * @brief A terminal, unit or clock entity of the Audio Control interface
+ * before a configured device slot's MIDI Streaming interface
+ */
+typedef struct
+{
+  uint8_t id;             // bTerminalID, bUnitID or bClockID
+  uint8_t subtype;        // bDescriptorSubtype; see audio_cs_ac_interface_subtype_t for UAC2
+  uint16_t terminal_type; // wTerminalType of a terminal; 0 for units and clock entities
+  uint8_t str_idx;        // iTerminal, iFeature, iClockSource and so on; 0 if none
+  uint8_t protocol;       // bInterfaceProtocol of the Audio Control interface: 0 for UAC1, 0x20 for UAC2
+} usb_midi_descriptor_lib_audio_entity_t;
+
+/**
+ * @brief Everything a UI needs to label one configured device slot
+ */
+typedef struct
+{
+  uint8_t itf_str_idx;        // iInterface of the MIDI Streaming interface
+  uint8_t num_in_eps;
+  uint8_t num_out_eps;
+  uint8_t in_ep_addrs[MAX_IN_ENDPOINTS];         // the MIDI device's MIDI IN endpoint addresses
+  uint8_t in_ep_num_cables[MAX_IN_ENDPOINTS];    // and the number of cables on each
+  uint8_t out_ep_addrs[MAX_OUT_ENDPOINTS];       // the MIDI device's MIDI OUT endpoint addresses
+  uint8_t out_ep_num_cables[MAX_OUT_ENDPOINTS];  // and the number of cables on each
+  uint8_t num_in_cables;      // the rx cables of every IN endpoint, one endpoint after another
+  uint8_t num_out_cables;     // the tx cables of every OUT endpoint, one endpoint after another
+  uint8_t in_cable_str_idx[MAX_IN_CABLES];       // the string index of each IN cable; 0 if none
+  uint8_t out_cable_str_idx[MAX_OUT_CABLES];     // the string index of each OUT cable; 0 if none
+  uint8_t num_string_indices;
+  uint8_t string_indices[MAX_STRING_INDICES];    // every unique string index, in ascending order
+} usb_midi_descriptor_lib_device_summary_t;
+
+/**
+ * @brief Why the last configure call or parser run on a device slot failed
+ */
+typedef enum
+{
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_NONE = 0,
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_MIDI_INTERFACE,  // no MIDI Streaming interface was found
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_BAD_DESCRIPTOR,     // a descriptor is malformed or out of place
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_MANY_ENDPOINTS, // more than MAX_IN_ENDPOINTS or MAX_OUT_ENDPOINTS
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_ARENA_FULL,         // the device's arena is too small, or it has none
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_NO_CABLES,          // no endpoint has any virtual cables
+  USB_MIDI_DESCRIPTOR_LIB_ERROR_TOO_LONG,           // a descriptor is longer than USB_MIDI_DESCRIPTOR_PARSER_BUFSIZE
+} usb_midi_descriptor_lib_error_t;
+
+/**
+ * @brief What the last configure call or parser run on a device slot found
+ *
+ * Offsets and byte counts are from the first byte passed to the configure
+ * function or the parser.
+ */
+typedef struct
+{
+  uint16_t descriptors;       // the number of descriptors visited
+  uint16_t bytes;             // the number of bytes in the descriptors visited
+  uint8_t num_in_jacks;       // every MIDI IN jack found, up to 255
+  uint8_t num_out_jacks;      // every MIDI OUT jack found, up to 255
+  uint8_t num_elements;       // every Element found, up to 255
+  uint8_t cables_dropped;     // cables past MAX_IN_CABLES or MAX_OUT_CABLES, up to 255
+  uint8_t strings_dropped;    // string index uses not kept because MAX_STRING_INDICES were kept already
+  uint8_t error;              // usb_midi_descriptor_lib_error_t
+  uint16_t error_offset;      // the offset of the descriptor that caused the error
+  uint32_t parse_time_us;     // from the start to the end of the parse; 0 without a time source
+} usb_midi_descriptor_lib_stats_t;
+
+/**
+ * @brief A function that returns a free running time in microseconds
+ */
+typedef uint64_t (*usb_midi_descriptor_lib_time_us_t)(void);
+
+/**
+ * @brief One MIDI endpoint of a device
+ */
+typedef struct
+{
+  uint8_t ep_addr;      // endpoint address
+  uint8_t num_cables;   // bNumEmbMIDIJack, less the cables that did not fit in the cable tables
+  uint8_t first_cable;  // where this endpoint's cables start in the device's cable tables
+} usb_midi_descriptor_lib_ep_info_t;
+
+/**
+ * @brief Storage for the jack, cable and string index data of devices
+ *
+ * The application owns an arena and its bytes; the functions that take a
+ * device slot index use one of USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE bytes
+ * the index API owns. Any number of devices may share an arena, and
+ * configuring one may move the data of the others, so the init, configure,
+ * parser and restore functions of all the devices in one arena must be
+ * called by the same writer. Nothing locks an arena: a second writer, such
+ * as a second USB host port on the other core, needs an arena of its own.
+ * The fields are private to the library.
+ */
+typedef struct
+{
+  uint8_t* bytes;                           // the storage the application provided
+  uint16_t size;                            // its size
+  uint16_t used;                            // the bytes from the start that hold blocks
+  usb_midi_descriptor_info_t* first_block;  // every device with a block here, in arena order
+} usb_midi_descriptor_lib_arena_t;
+
+/**
+ * @brief The fixed size part of one device's parsed data
+ *
+ * The application may own these, as many as it needs, anywhere in RAM and
+ * use them with the usb_midi_descriptor_lib_dev_ functions; the functions
+ * that take a device slot index use CFG_TUH_MIDI of them the index API owns.
+ * Zero a device before its first use and give it an arena with
+ * usb_midi_descriptor_lib_dev_set_arena(); a device that is only configured
+ * as a view or restored in place needs none. Call
+ * usb_midi_descriptor_lib_dev_init() on it before freeing or reusing its
+ * memory so its arena block is released. The fields are private to the library.
+ */
+struct usb_midi_descriptor_info_s
+{
+  bool configured;
+  usb_midi_descriptor_lib_ep_info_t in_eps[MAX_IN_ENDPOINTS];
+  uint8_t num_in_eps;
+  usb_midi_descriptor_lib_ep_info_t out_eps[MAX_OUT_ENDPOINTS];
+  uint8_t num_out_eps;
+  uint8_t num_in_jacks;
+  uint8_t num_out_jacks;
+  uint8_t num_in_cables;      // the cables of every IN endpoint, one endpoint after another
+  uint8_t num_out_cables;     // the cables of every OUT endpoint, one endpoint after another
+  uint8_t num_string_indices;
+  uint8_t num_elements;
+  uint8_t element_id_first;   // the smallest element ID
+  uint8_t element_id_last;    // the largest element ID
+  uint8_t itf_str_idx;        // the MIDI Streaming interface's iInterface
+  uint8_t num_audio_entities; // the Audio Control terminals, units and clock entities
+  uint16_t arena_offset;      // where the block starts in the arena
+  uint16_t arena_len;         // the length of the block; 0 if the device has no block
+  uint16_t tables;            // where the cable tables start in the block
+  const uint8_t* block;       // the start of the block, in the arena or read in place
+  uint16_t in_place_len;      // the length of a block read in place
+  bool view;                  // block is the caller's MIDI Streaming interface descriptors
+  uint16_t cs_ep_offsets[MAX_IN_ENDPOINTS + MAX_OUT_ENDPOINTS]; // where each view endpoint's CS endpoint descriptor is
+  atomic_uint seq;            // odd while the device is being changed
+  usb_midi_descriptor_lib_stats_t stats;
+  struct usb_midi_descriptor_info_s* next_block; // the next device in arena order
+  usb_midi_descriptor_lib_arena_t* arena;         // where the block goes; NULL for none
+};
+
+/**
+ * @brief How usb_midi_descriptor_lib_build_device_descriptor() lays out the
+ * device side copy of a MIDI Streaming interface
+ */
+typedef struct
+{
+  uint8_t itf_num;        // bInterfaceNumber of the MIDI Streaming interface
+  uint8_t first_str_idx;  // the device side string index of the first of the slot's string indices; 0 for no strings
+  uint16_t ep_size;       // wMaxPacketSize of every endpoint; 64 for a full speed device
+  uint8_t in_ep_addrs[MAX_IN_ENDPOINTS];   // the device side address of each MIDI IN endpoint
+  uint8_t out_ep_addrs[MAX_OUT_ENDPOINTS]; // the device side address of each MIDI OUT endpoint
+} usb_midi_descriptor_lib_device_cfg_t;
+
 /**
  * @brief Initialize data structures for parsing a new MIDI descriptor
+ *
+ * This releases the device slot's arena space. The configure functions
+ * and usb_midi_descriptor_parser_init() call this first.
  */
 void usb_midi_descriptor_lib_init(uint8_t idx);
 
@@ -77,8 +364,68 @@ bool usb_midi_descriptor_lib_configure_from_full(uint8_t idx, const uint8_t* ful
  */
 bool usb_midi_descriptor_lib_configure(uint8_t idx, uint8_t const *midi_descriptor, uint32_t max_len);
 
+/**
+ * @brief Configure a device slot to read the MIDI Streaming interface descriptors in place
+ *
+ * This only checks the descriptors and notes where the endpoints and jacks
+ * are, so it takes no arena space and little time. The endpoint getters
+ * work as usual, but nothing is cached: each call for a cable's string
+ * index walks the interface's descriptors to find the cable's jack, so it
+ * costs time in proportion to the descriptor length rather than a table
+ * load, and usb_midi_descriptor_lib_copy_all_str_indices() walks them
+ * once per call. usb_midi_descriptor_lib_get_device_summary() does one
+ * walk per cable, so labeling all n cables of a device costs n walks,
+ * whether through the summary or one getter call per cable. The slot has
+ * no cable routes and no elements, and
+ * usb_midi_descriptor_lib_get_all_str_inidices(),
+ * usb_midi_descriptor_lib_save() and
+ * usb_midi_descriptor_lib_build_device_descriptor() fail on it. Use this
+ * for applications that keep the descriptors anyway and rarely or never
+ * ask for names, such as a MIDI merger.
+ * @param midi_descriptor a pointer to the first byte of the MIDI descriptor.
+ * It must not change until the slot is next initialized or configured.
+ * @param max_len The number of bytes in the MIDI descriptor
+ * @return true if the descriptors are valid and have at least one cable
+ */
+bool usb_midi_descriptor_lib_configure_view(uint8_t idx, uint8_t const *midi_descriptor, uint32_t max_len);
+
+/**
+ * @brief Find every MIDI Streaming interface in a full configuration descriptor
+ *
+ * usb_midi_descriptor_lib_configure_from_full() only configures the first
+ * MIDI Streaming interface. This walks the configuration descriptor once
+ * and lists every MIDI Streaming interface and alternate setting, in
+ * descriptor order, wherever it is: after several Audio Streaming
+ * interfaces, or in another function of a composite device. An interface
+ * that a malformed descriptor cuts short is not listed. Pass each
+ * entry to usb_midi_descriptor_lib_configure_interface() to configure it
+ * into its own device slot.
+ * @param full_config_descriptor The device's full configuration descriptor
+ * @param itfs where to list the interfaces
+ * @param max_itfs the number of entries itfs has room for
+ * @return uint8_t the number of interfaces listed, at most max_itfs
+ */
+uint8_t usb_midi_descriptor_lib_find_midi_interfaces(const uint8_t* full_config_descriptor,
+  usb_midi_descriptor_lib_interface_t* itfs, uint8_t max_itfs);
+
+/**
+ * @brief Configure a device slot from one interface usb_midi_descriptor_lib_find_midi_interfaces() found
+ *
+ * @param full_config_descriptor the configuration descriptor the interface was found in
+ * @param itf the interface
+ * @return true if the string indicies were successfully parsed
+ */
+bool usb_midi_descriptor_lib_configure_interface(uint8_t idx, const uint8_t* full_config_descriptor,
+  const usb_midi_descriptor_lib_interface_t* itf);
+
 /**
  * @brief set indices to point to an array of all MIDI interface string indices
+ *
+ * Each string index appears once in the array, and the array is sorted in
+ * ascending order. The array is valid until any device slot is
+ * initialized or configured again, because that may move it. Only the
+ * writer may use the array; a reader on another core should call
+ * usb_midi_descriptor_lib_copy_all_str_indices() instead.
  * 
  * @param inidices a pointer to an array of string indices
  * @return int the number of indices in the array
@@ -86,7 +433,19 @@ bool usb_midi_descriptor_lib_configure(uint8_t idx, uint8_t const *midi_descript
 int usb_midi_descriptor_lib_get_all_str_inidices(uint8_t idx, const uint8_t** inidices);
 
 /**
- * @brief Get the string index for a particular MIDI IN virtual cable
+ * @brief Copy the array usb_midi_descriptor_lib_get_all_str_inidices() points to
+ *
+ * The copy is consistent even if the writer changes the device slot
+ * meanwhile.
+ * @param indices where to copy the string indices
+ * @param max_indices the number of entries indices has room for
+ * @return int the number of indices copied, at most max_indices, or -1 if
+ * the device slot is not configured
+ */
+int usb_midi_descriptor_lib_copy_all_str_indices(uint8_t idx, uint8_t* indices, uint8_t max_indices);
+
+/**
+ * @brief Get the string index for a particular MIDI IN virtual cable of the first MIDI IN endpoint
  * 
  * @param in_cable_num the cable number, 0-15
  * @return int the string index or 0 if none is found
@@ -94,9 +453,541 @@ int usb_midi_descriptor_lib_get_all_str_inidices(uint8_t idx, const uint8_t** in
 int usb_midi_descriptor_lib_get_str_idx_for_in_cable(uint8_t idx, uint8_t in_cable_num);
 
 /**
- * @brief Get the string index for a particular MIDI OUT virtual cable
+ * @brief Get the string index for a particular MIDI OUT virtual cable of the first MIDI OUT endpoint
  * 
  * @param out_cable_num the cable number, 0-15
  * @return int the string index or 0 if none is found
  */
-int usb_midi_descriptor_lib_get_str_idx_for_out_cable(uint8_t idx, uint8_t out_cable_num);
\ No newline at end of file
+int usb_midi_descriptor_lib_get_str_idx_for_out_cable(uint8_t idx, uint8_t out_cable_num);
+
+/**
+ * @brief Get the number of MIDI IN endpoints the device has
+ *
+ * @return uint8_t the number of MIDI IN endpoints; 0 if the slot is not configured
+ */
+uint8_t usb_midi_descriptor_lib_get_num_in_endpoints(uint8_t idx);
+
+/**
+ * @brief Get the number of MIDI OUT endpoints the device has
+ *
+ * @return uint8_t the number of MIDI OUT endpoints; 0 if the slot is not configured
+ */
+uint8_t usb_midi_descriptor_lib_get_num_out_endpoints(uint8_t idx);
+
+/**
+ * @brief Get the address and number of virtual cables of a MIDI IN endpoint
+ *
+ * @param ep_num the MIDI IN endpoint number, in descriptor order, starting at 0
+ * @param ep_addr set to the endpoint address
+ * @param num_cables set to the number of the endpoint's virtual cables the
+ * cable tables hold; cables past MAX_IN_CABLES or MAX_OUT_CABLES are not counted
+ * @return true if the slot is configured and ep_num is a valid MIDI IN endpoint number
+ */
+bool usb_midi_descriptor_lib_get_in_endpoint(uint8_t idx, uint8_t ep_num, uint8_t* ep_addr, uint8_t* num_cables);
+
+/**
+ * @brief Get the address and number of virtual cables of a MIDI OUT endpoint
+ *
+ * @param ep_num the MIDI OUT endpoint number, in descriptor order, starting at 0
+ * @param ep_addr set to the endpoint address
+ * @param num_cables set to the number of the endpoint's virtual cables the
+ * cable tables hold; cables past MAX_IN_CABLES or MAX_OUT_CABLES are not counted
+ * @return true if the slot is configured and ep_num is a valid MIDI OUT endpoint number
+ */
+bool usb_midi_descriptor_lib_get_out_endpoint(uint8_t idx, uint8_t ep_num, uint8_t* ep_addr, uint8_t* num_cables);
+
+/**
+ * @brief Get the string index for a particular virtual cable of a MIDI IN endpoint
+ *
+ * @param ep_num the MIDI IN endpoint number, in descriptor order, starting at 0
+ * @param in_cable_num the cable number on that endpoint, 0-15
+ * @return int the string index or 0 if none is found
+ */
+int usb_midi_descriptor_lib_get_str_idx_for_in_endpoint_cable(uint8_t idx, uint8_t ep_num, uint8_t in_cable_num);
+
+/**
+ * @brief Get the string index for a particular virtual cable of a MIDI OUT endpoint
+ *
+ * @param ep_num the MIDI OUT endpoint number, in descriptor order, starting at 0
+ * @param out_cable_num the cable number on that endpoint, 0-15
+ * @return int the string index or 0 if none is found
+ */
+int usb_midi_descriptor_lib_get_str_idx_for_out_endpoint_cable(uint8_t idx, uint8_t ep_num, uint8_t out_cable_num);
+
+/**
+ * @brief Get the external MIDI IN jack that feeds a particular virtual cable of a MIDI IN endpoint
+ *
+ * The route is resolved when the device slot is configured by following the
+ * baSourceID lists of the cable's embedded jack and of any elements in between,
+ * so this is a table lookup. The external jack is normally a physical MIDI IN port.
+ * @param ep_num the MIDI IN endpoint number, in descriptor order, starting at 0
+ * @param in_cable_num the cable number on that endpoint, 0-15
+ * @param ext_jack_id set to the external jack's bJackID; 0 if there is none
+ * @param str_idx set to the external jack's iJack; 0 if there is none
+ * @return true if the cable is fed by an external jack
+ */
+bool usb_midi_descriptor_lib_get_in_endpoint_cable_route(uint8_t idx, uint8_t ep_num, uint8_t in_cable_num,
+  uint8_t* ext_jack_id, uint8_t* str_idx);
+
+/**
+ * @brief Get the external MIDI OUT jack that a particular virtual cable of a MIDI OUT endpoint feeds
+ *
+ * The route is resolved when the device slot is configured; see
+ * usb_midi_descriptor_lib_get_in_endpoint_cable_route(). If the cable feeds
+ * more than one external jack, the first one in descriptor order is returned.
+ * @param ep_num the MIDI OUT endpoint number, in descriptor order, starting at 0
+ * @param out_cable_num the cable number on that endpoint, 0-15
+ * @param ext_jack_id set to the external jack's bJackID; 0 if there is none
+ * @param str_idx set to the external jack's iJack; 0 if there is none
+ * @return true if the cable feeds an external jack
+ */
+bool usb_midi_descriptor_lib_get_out_endpoint_cable_route(uint8_t idx, uint8_t ep_num, uint8_t out_cable_num,
+  uint8_t* ext_jack_id, uint8_t* str_idx);
+
+/**
+ * @brief Fill in everything a UI needs to label a device in one call
+ *
+ * This is the same as calling the endpoint, cable string index and
+ * usb_midi_descriptor_lib_copy_all_str_indices() functions for every
+ * endpoint and cable, but checks idx and reads the slot only once.
+ * @param summary the summary to fill in
+ * @return true if the slot is configured; otherwise summary is unchanged
+ */
+bool usb_midi_descriptor_lib_get_device_summary(uint8_t idx, usb_midi_descriptor_lib_device_summary_t* summary);
+
+/**
+ * @brief Get the number of MIDI Elements the device has
+ *
+ * @return uint8_t the number of elements, or 0 if the slot is not configured
+ */
+uint8_t usb_midi_descriptor_lib_get_num_elements(uint8_t idx);
+
+/**
+ * @brief Get a MIDI Element by its position
+ *
+ * @param elem_num the element number, in descriptor order, starting at 0
+ * @param element set to the element's fields
+ * @return true if the element exists
+ */
+bool usb_midi_descriptor_lib_get_element(uint8_t idx, uint8_t elem_num, usb_midi_descriptor_lib_element_t* element);
+
+/**
+ * @brief Get a MIDI Element by its bElementID
+ *
+ * The elements are indexed by ID when the device slot is configured, so this is a table lookup.
+ * @param element_id the element's bElementID
+ * @param element set to the element's fields
+ * @return true if the element exists
+ */
+bool usb_midi_descriptor_lib_find_element(uint8_t idx, uint8_t element_id, usb_midi_descriptor_lib_element_t* element);
+
+/**
+ * @brief Get the jack or element connected to an input pin of a MIDI Element
+ *
+ * @param element_id the element's bElementID
+ * @param pin the input pin number, starting at 0
+ * @param source_id set to the baSourceID of the pin
+ * @param source_pin set to the baSourcePin of the pin
+ * @return true if the element and the pin exist
+ */
+bool usb_midi_descriptor_lib_get_element_source(uint8_t idx, uint8_t element_id, uint8_t pin,
+  uint8_t* source_id, uint8_t* source_pin);
+
+/**
+ * @brief Get the number of Audio Control terminals, units and clock entities of a configured device slot
+ *
+ * usb_midi_descriptor_lib_configure_from_full(),
+ * usb_midi_descriptor_lib_configure_interface() and the streaming parser
+ * keep every terminal, unit and clock entity of the Audio Control interface
+ * before the MIDI Streaming interface, in UAC1 or UAC2 layout, in the same
+ * pass. Their string indices are in the list
+ * usb_midi_descriptor_lib_get_all_str_inidices() returns, so the string
+ * cache fetches them. usb_midi_descriptor_lib_configure() and view mode
+ * only see the MIDI Streaming interface and keep none.
+ * @return uint8_t the number of entities, up to 255; 0 if the slot is not configured
+ */
+uint8_t usb_midi_descriptor_lib_get_num_audio_entities(uint8_t idx);
+
+/**
+ * @brief Get an Audio Control terminal, unit or clock entity by its position in descriptor order
+ *
+ * @param entity_num 0 to usb_midi_descriptor_lib_get_num_audio_entities() - 1
+ * @param entity set to the entity
+ * @return true if the entity exists
+ */
+bool usb_midi_descriptor_lib_get_audio_entity(uint8_t idx, uint8_t entity_num, usb_midi_descriptor_lib_audio_entity_t* entity);
+
+/**
+ * @brief Find an Audio Control terminal, unit or clock entity by ID
+ *
+ * Use this to name the Audio Terminal an Element's in_terminal_link or out_terminal_link refers to.
+ * @param id the entity's bTerminalID, bUnitID or bClockID
+ * @param entity set to the first entity with that ID
+ * @return true if there is one
+ */
+bool usb_midi_descriptor_lib_find_audio_entity(uint8_t idx, uint8_t id, usb_midi_descriptor_lib_audio_entity_t* entity);
+
+/**
+ * @brief Start parsing a full configuration descriptor that will arrive in pieces
+ *
+ * This also initializes the device slot idx.
+ * @param parser the parser state
+ * @param idx the device slot to configure
+ */
+void usb_midi_descriptor_parser_init(usb_midi_descriptor_parser_t* parser, uint8_t idx);
+
+/**
+ * @brief Parse the next piece of the full configuration descriptor
+ *
+ * The pieces may be any size and may split descriptors. Once wTotalLength
+ * bytes have been fed, the device slot is configured exactly as if
+ * usb_midi_descriptor_lib_configure_from_full() had parsed the whole
+ * configuration descriptor, and any bytes past wTotalLength are ignored.
+ * @param parser the parser state
+ * @param bytes the next bytes of the configuration descriptor
+ * @param len the number of bytes
+ * @return false if the configuration descriptor is malformed or has no
+ * MIDI Streaming interface; true otherwise
+ */
+bool usb_midi_descriptor_parser_feed(usb_midi_descriptor_parser_t* parser, const uint8_t* bytes, uint32_t len);
+
+/**
+ * @brief Check if the parser has successfully parsed the whole configuration descriptor
+ *
+ * @param parser the parser state
+ * @return true if the device slot is configured
+ */
+bool usb_midi_descriptor_parser_complete(const usb_midi_descriptor_parser_t* parser);
+
+/**
+ * @brief Start a walk over the descriptors in a buffer
+ *
+ * The configure functions walk descriptors with this iterator. An
+ * application can use it to walk any other descriptors, such as the
+ * descriptors of another class, with the same guarantees: the walk never
+ * reads outside the buffer and takes at most len / 2 steps, however
+ * malformed the descriptors are.
+ * @param iter the iterator
+ * @param buf the first byte of the first descriptor
+ * @param len the number of bytes in the buffer, such as wTotalLength for a configuration descriptor
+ */
+void usb_midi_descriptor_lib_iter_init(usb_midi_descriptor_lib_iter_t* iter, const uint8_t* buf, uint32_t len);
+
+/**
+ * @brief Step to the next descriptor, or to the first one after usb_midi_descriptor_lib_iter_init()
+ *
+ * @param iter the iterator
+ * @return true if iter is at a descriptor that fits in the buffer. false at
+ * the end of the buffer, or with iter->malformed set if the next descriptor's
+ * bLength is less than 2 or runs past the end of the buffer; every later
+ * call returns false as well.
+ */
+bool usb_midi_descriptor_lib_iter_next(usb_midi_descriptor_lib_iter_t* iter);
+
+/**
+ * @brief Get what the last configure call or parser run on a device slot found
+ *
+ * Use this to size the MAX_* limits for the devices you support and to
+ * find out why a device does not configure or configures slowly. The
+ * statistics are reset when the slot is initialized; only the writer
+ * should read them.
+ * @param stats set to the slot's statistics
+ * @return true if idx is a valid device slot
+ */
+bool usb_midi_descriptor_lib_get_stats(uint8_t idx, usb_midi_descriptor_lib_stats_t* stats);
+
+/**
+ * @brief Set the function that times parses
+ *
+ * The default uses time_us_64() in a Pico SDK build, clock_gettime() on
+ * Linux, and is NULL otherwise.
+ * @param time_us the time source, or NULL to not time parses
+ */
+void usb_midi_descriptor_lib_set_time_source(usb_midi_descriptor_lib_time_us_t time_us);
+
+/**
+ * @brief Get the number of bytes of RAM a device slot is using
+ *
+ * @return uint16_t the size of the slot's fixed part plus the arena bytes
+ * the slot holds once it is configured
+ */
+uint16_t usb_midi_descriptor_lib_get_bytes_used(uint8_t idx);
+
+/**
+ * @brief Get the number of bytes of the index API's arena no device slot is using
+ *
+ * @return uint16_t the number of free bytes in the arena
+ */
+uint16_t usb_midi_descriptor_lib_get_arena_bytes_free(void);
+
+/**
+ * @brief Copy the parsed data of a configured device slot to a flat buffer
+ *
+ * The saved data contains no pointers or arena offsets and its 16-bit
+ * values are little endian, so it can be kept anywhere and restored to any
+ * device slot with usb_midi_descriptor_lib_restore().
+ * @param buf where to copy the data, or NULL to get the number of bytes needed
+ * @param maxlen the size of buf
+ * @return uint16_t the number of bytes saved, or 0 if the slot is not
+ * configured or buf is too small
+ */
+uint16_t usb_midi_descriptor_lib_save(uint8_t idx, uint8_t* buf, uint16_t maxlen);
+
+/**
+ * @brief Configure a device slot from data usb_midi_descriptor_lib_save() saved, without parsing
+ *
+ * @param buf the saved data
+ * @param len the number of bytes usb_midi_descriptor_lib_save() returned
+ * @return true if the data is valid and fits in the arena. Otherwise the
+ * slot is left unconfigured.
+ */
+bool usb_midi_descriptor_lib_restore(uint8_t idx, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Configure a device slot to read data usb_midi_descriptor_lib_save() saved in place
+ *
+ * This is usb_midi_descriptor_lib_restore() without copying the jack,
+ * cable and string index data to the arena, for saved data in memory that
+ * does not change, such as memory mapped flash. The slot uses no arena
+ * space, and it reads buf until the next init or configure.
+ * @param buf the saved data. It needs no alignment.
+ * @param len the number of bytes usb_midi_descriptor_lib_save() returned
+ * @return true if the data is valid. Otherwise the slot is left unconfigured.
+ */
+bool usb_midi_descriptor_lib_restore_in_place(uint8_t idx, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Build the device side copy of a configured slot's MIDI Streaming interface
+ *
+ * This writes the descriptors a USB device that mirrors the MIDI device
+ * presents to its own host, in one pass: the standard MIDI Streaming
+ * interface descriptor, the class-specific header, every MIDI IN and MIDI
+ * OUT jack with its type, ID and sources, every Element, and a bulk
+ * endpoint descriptor followed by its class-specific endpoint descriptor
+ * and baAssocJackID list for each endpoint.
+ *
+ * String indices, including the interface's iInterface, are renumbered so
+ * the device can serve them from one table: if the string index list
+ * usb_midi_descriptor_lib_get_all_str_inidices() returns is inidices[], then
+ * the device side string index cfg->first_str_idx + n names the same string
+ * as the MIDI device's string index inidices[n]. If cfg->first_str_idx is 0,
+ * or a renumbered index would not fit in a byte, the string index is 0.
+ * @param cfg the interface number, endpoint addresses and first string index to use
+ * @param buf where to write the descriptors, or NULL to get the number of bytes needed
+ * @param maxlen the size of buf
+ * @return uint16_t the number of bytes of descriptors, or 0 if the slot is not
+ * configured, buf is too small, or the slot has more MIDI IN or MIDI OUT
+ * endpoints than cfg has device side addresses for
+ */
+uint16_t usb_midi_descriptor_lib_build_device_descriptor(uint8_t idx, const usb_midi_descriptor_lib_device_cfg_t* cfg,
+  uint8_t* buf, uint16_t maxlen);
+
+/**
+ * @brief Get the device the library owns for a device slot
+ *
+ * The usb_midi_descriptor_lib_dev_ functions accept it, so code written for
+ * devices the application owns also works with the library's device slots.
+ * It gives the slot the library's shared arena the first time, so call it
+ * from the code that calls the init and configure functions.
+ * @return the device, or NULL if idx is not a valid device slot
+ */
+usb_midi_descriptor_info_t* usb_midi_descriptor_lib_get_device(uint8_t idx);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_init() for a device the application owns
+ *
+ * Call this before freeing or reusing the device's memory. The device keeps
+ * its arena. A NULL dev is ignored.
+ */
+void usb_midi_descriptor_lib_dev_init(usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Make an arena hold the jack, cable and string index data of a device the application owns
+ *
+ * This calls usb_midi_descriptor_lib_dev_init() first, which releases the
+ * device's block in the arena it had. A NULL dev is ignored.
+ * @param arena the arena, or NULL for a device that is only configured as a
+ * view or restored in place
+ */
+void usb_midi_descriptor_lib_dev_set_arena(usb_midi_descriptor_info_t* dev, usb_midi_descriptor_lib_arena_t* arena);
+
+/**
+ * @brief Set up an arena in storage the application provides
+ *
+ * Call this before any device uses the arena. It needs room for the blocks
+ * of all of its configured devices at once; report_memory and
+ * analyze_corpus print the block sizes of real devices.
+ * @param bytes the storage. It needs no alignment and must outlive every
+ * device that uses the arena.
+ * @param size the number of bytes of storage
+ */
+void usb_midi_descriptor_lib_arena_init(usb_midi_descriptor_lib_arena_t* arena, uint8_t* bytes, uint16_t size);
+
+/**
+ * @brief Get the number of bytes of an arena no device is using
+ */
+uint16_t usb_midi_descriptor_lib_arena_bytes_free(const usb_midi_descriptor_lib_arena_t* arena);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_configure_from_full() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_configure_from_full(usb_midi_descriptor_info_t* dev,
+  const uint8_t* full_config_descriptor);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_configure() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_configure(usb_midi_descriptor_info_t* dev, uint8_t const *midi_descriptor,
+  uint32_t max_len);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_configure_view() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_configure_view(usb_midi_descriptor_info_t* dev, uint8_t const *midi_descriptor,
+  uint32_t max_len);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_configure_interface() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_configure_interface(usb_midi_descriptor_info_t* dev,
+  const uint8_t* full_config_descriptor, const usb_midi_descriptor_lib_interface_t* itf);
+
+/**
+ * @brief Same as usb_midi_descriptor_parser_init() for a device the application owns
+ */
+void usb_midi_descriptor_parser_init_dev(usb_midi_descriptor_parser_t* parser, usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_all_str_inidices() for a device the application owns
+ */
+int usb_midi_descriptor_lib_dev_get_all_str_indices(const usb_midi_descriptor_info_t* dev, const uint8_t** indices);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_copy_all_str_indices() for a device the application owns
+ */
+int usb_midi_descriptor_lib_dev_copy_all_str_indices(const usb_midi_descriptor_info_t* dev, uint8_t* indices,
+  uint8_t max_indices);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_num_in_endpoints() for a device the application owns
+ */
+uint8_t usb_midi_descriptor_lib_dev_get_num_in_endpoints(const usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_num_out_endpoints() for a device the application owns
+ */
+uint8_t usb_midi_descriptor_lib_dev_get_num_out_endpoints(const usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_in_endpoint() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_in_endpoint(const usb_midi_descriptor_info_t* dev, uint8_t ep_num,
+  uint8_t* ep_addr, uint8_t* num_cables);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_out_endpoint() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_out_endpoint(const usb_midi_descriptor_info_t* dev, uint8_t ep_num,
+  uint8_t* ep_addr, uint8_t* num_cables);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_str_idx_for_in_endpoint_cable() for a device the application owns
+ */
+int usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(const usb_midi_descriptor_info_t* dev,
+  uint8_t ep_num, uint8_t in_cable_num);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_str_idx_for_out_endpoint_cable() for a device the application owns
+ */
+int usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(const usb_midi_descriptor_info_t* dev,
+  uint8_t ep_num, uint8_t out_cable_num);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_in_endpoint_cable_route() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_in_endpoint_cable_route(const usb_midi_descriptor_info_t* dev,
+  uint8_t ep_num, uint8_t in_cable_num, uint8_t* ext_jack_id, uint8_t* str_idx);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_out_endpoint_cable_route() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_out_endpoint_cable_route(const usb_midi_descriptor_info_t* dev,
+  uint8_t ep_num, uint8_t out_cable_num, uint8_t* ext_jack_id, uint8_t* str_idx);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_device_summary() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_device_summary(const usb_midi_descriptor_info_t* dev,
+  usb_midi_descriptor_lib_device_summary_t* summary);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_num_elements() for a device the application owns
+ */
+uint8_t usb_midi_descriptor_lib_dev_get_num_elements(const usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_element() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_element(const usb_midi_descriptor_info_t* dev, uint8_t elem_num,
+  usb_midi_descriptor_lib_element_t* element);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_find_element() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_find_element(const usb_midi_descriptor_info_t* dev, uint8_t element_id,
+  usb_midi_descriptor_lib_element_t* element);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_element_source() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_element_source(const usb_midi_descriptor_info_t* dev, uint8_t element_id,
+  uint8_t pin, uint8_t* source_id, uint8_t* source_pin);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_num_audio_entities() for a device the application owns
+ */
+uint8_t usb_midi_descriptor_lib_dev_get_num_audio_entities(const usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_audio_entity() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_audio_entity(const usb_midi_descriptor_info_t* dev, uint8_t entity_num,
+  usb_midi_descriptor_lib_audio_entity_t* entity);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_find_audio_entity() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_find_audio_entity(const usb_midi_descriptor_info_t* dev, uint8_t id,
+  usb_midi_descriptor_lib_audio_entity_t* entity);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_stats() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_get_stats(const usb_midi_descriptor_info_t* dev,
+  usb_midi_descriptor_lib_stats_t* stats);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_get_bytes_used() for a device the application owns
+ */
+uint16_t usb_midi_descriptor_lib_dev_get_bytes_used(const usb_midi_descriptor_info_t* dev);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_save() for a device the application owns
+ */
+uint16_t usb_midi_descriptor_lib_dev_save(const usb_midi_descriptor_info_t* dev, uint8_t* buf, uint16_t maxlen);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_restore() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_restore(usb_midi_descriptor_info_t* dev, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_restore_in_place() for a device the application owns
+ */
+bool usb_midi_descriptor_lib_dev_restore_in_place(usb_midi_descriptor_info_t* dev, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Same as usb_midi_descriptor_lib_build_device_descriptor() for a device the application owns
+ */
+uint16_t usb_midi_descriptor_lib_dev_build_device_descriptor(const usb_midi_descriptor_info_t* dev,
+  const usb_midi_descriptor_lib_device_cfg_t* cfg, uint8_t* buf, uint16_t maxlen);
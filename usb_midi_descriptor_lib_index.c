@@ -0,0 +1,233 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// The index API: device slot idx is one of CFG_TUH_MIDI devices this file
+// owns, which share one arena of USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE bytes.
+// An application that calls none of these functions, and only uses devices
+// and arenas of its own, leaves nothing here for the linker to keep, so
+// neither the devices nor the arena take any RAM.
+
+#include "usb_midi_descriptor_lib.h"
+
+#if USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE > 0xFFFF
+#error "USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE must fit in 16 bits"
+#endif
+
+static uint8_t arena_bytes[USB_MIDI_DESCRIPTOR_LIB_ARENA_SIZE];
+static usb_midi_descriptor_lib_arena_t arena = { .bytes = arena_bytes, .size = sizeof(arena_bytes) };
+
+static usb_midi_descriptor_info_t midi_host[CFG_TUH_MIDI];
+
+static usb_midi_descriptor_info_t* slot(uint8_t idx)
+{
+  return idx < CFG_TUH_MIDI ? midi_host + idx : NULL;
+}
+
+// slot() for the writer. A slot starts out zero, so the first call for it
+// gives it the shared arena, which leaves it the way
+// usb_midi_descriptor_lib_dev_set_arena() would. Only the writer stores the
+// pointer, and the getters never read it.
+static usb_midi_descriptor_info_t* writer_slot(uint8_t idx)
+{
+  usb_midi_descriptor_info_t* dev = slot(idx);
+  if (dev != NULL && dev->arena == NULL)
+    dev->arena = &arena;
+  return dev;
+}
+
+uint16_t usb_midi_descriptor_lib_get_arena_bytes_free(void)
+{
+  return usb_midi_descriptor_lib_arena_bytes_free(&arena);
+}
+
+usb_midi_descriptor_info_t* usb_midi_descriptor_lib_get_device(uint8_t idx)
+{
+  return writer_slot(idx);
+}
+
+void usb_midi_descriptor_lib_init(uint8_t idx)
+{
+  usb_midi_descriptor_lib_dev_init(writer_slot(idx));
+}
+
+bool usb_midi_descriptor_lib_configure_from_full(uint8_t idx, const uint8_t* full_config_descriptor)
+{
+  return usb_midi_descriptor_lib_dev_configure_from_full(writer_slot(idx), full_config_descriptor);
+}
+
+bool usb_midi_descriptor_lib_configure(uint8_t idx, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  return usb_midi_descriptor_lib_dev_configure(writer_slot(idx), midi_descriptor, max_len);
+}
+
+bool usb_midi_descriptor_lib_configure_view(uint8_t idx, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  return usb_midi_descriptor_lib_dev_configure_view(writer_slot(idx), midi_descriptor, max_len);
+}
+
+bool usb_midi_descriptor_lib_configure_interface(uint8_t idx, const uint8_t* full_config_descriptor,
+  const usb_midi_descriptor_lib_interface_t* itf)
+{
+  return usb_midi_descriptor_lib_dev_configure_interface(writer_slot(idx), full_config_descriptor, itf);
+}
+
+int usb_midi_descriptor_lib_get_all_str_inidices(uint8_t idx, const uint8_t** indices)
+{
+  return usb_midi_descriptor_lib_dev_get_all_str_indices(slot(idx), indices);
+}
+
+int usb_midi_descriptor_lib_copy_all_str_indices(uint8_t idx, uint8_t* indices, uint8_t max_indices)
+{
+  return usb_midi_descriptor_lib_dev_copy_all_str_indices(slot(idx), indices, max_indices);
+}
+
+uint8_t usb_midi_descriptor_lib_get_num_in_endpoints(uint8_t idx)
+{
+  return usb_midi_descriptor_lib_dev_get_num_in_endpoints(slot(idx));
+}
+
+uint8_t usb_midi_descriptor_lib_get_num_out_endpoints(uint8_t idx)
+{
+  return usb_midi_descriptor_lib_dev_get_num_out_endpoints(slot(idx));
+}
+
+bool usb_midi_descriptor_lib_get_in_endpoint(uint8_t idx, uint8_t ep_num, uint8_t* ep_addr, uint8_t* num_cables)
+{
+  return usb_midi_descriptor_lib_dev_get_in_endpoint(slot(idx), ep_num, ep_addr, num_cables);
+}
+
+bool usb_midi_descriptor_lib_get_out_endpoint(uint8_t idx, uint8_t ep_num, uint8_t* ep_addr, uint8_t* num_cables)
+{
+  return usb_midi_descriptor_lib_dev_get_out_endpoint(slot(idx), ep_num, ep_addr, num_cables);
+}
+
+int usb_midi_descriptor_lib_get_str_idx_for_in_endpoint_cable(uint8_t idx, uint8_t ep_num, uint8_t in_cable_num)
+{
+  return usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(slot(idx), ep_num, in_cable_num);
+}
+
+int usb_midi_descriptor_lib_get_str_idx_for_in_cable(uint8_t idx, uint8_t in_cable_num)
+{
+  return usb_midi_descriptor_lib_dev_get_str_idx_for_in_endpoint_cable(slot(idx), 0, in_cable_num);
+}
+
+int usb_midi_descriptor_lib_get_str_idx_for_out_endpoint_cable(uint8_t idx, uint8_t ep_num, uint8_t out_cable_num)
+{
+  return usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(slot(idx), ep_num, out_cable_num);
+}
+
+int usb_midi_descriptor_lib_get_str_idx_for_out_cable(uint8_t idx, uint8_t out_cable_num)
+{
+  return usb_midi_descriptor_lib_dev_get_str_idx_for_out_endpoint_cable(slot(idx), 0, out_cable_num);
+}
+
+bool usb_midi_descriptor_lib_get_in_endpoint_cable_route(uint8_t idx, uint8_t ep_num, uint8_t in_cable_num,
+  uint8_t* ext_jack_id, uint8_t* str_idx)
+{
+  return usb_midi_descriptor_lib_dev_get_in_endpoint_cable_route(slot(idx), ep_num, in_cable_num, ext_jack_id, str_idx);
+}
+
+bool usb_midi_descriptor_lib_get_out_endpoint_cable_route(uint8_t idx, uint8_t ep_num, uint8_t out_cable_num,
+  uint8_t* ext_jack_id, uint8_t* str_idx)
+{
+  return usb_midi_descriptor_lib_dev_get_out_endpoint_cable_route(slot(idx), ep_num, out_cable_num, ext_jack_id, str_idx);
+}
+
+bool usb_midi_descriptor_lib_get_device_summary(uint8_t idx, usb_midi_descriptor_lib_device_summary_t* summary)
+{
+  return usb_midi_descriptor_lib_dev_get_device_summary(slot(idx), summary);
+}
+
+uint8_t usb_midi_descriptor_lib_get_num_elements(uint8_t idx)
+{
+  return usb_midi_descriptor_lib_dev_get_num_elements(slot(idx));
+}
+
+bool usb_midi_descriptor_lib_get_element(uint8_t idx, uint8_t elem_num, usb_midi_descriptor_lib_element_t* element)
+{
+  return usb_midi_descriptor_lib_dev_get_element(slot(idx), elem_num, element);
+}
+
+bool usb_midi_descriptor_lib_find_element(uint8_t idx, uint8_t element_id, usb_midi_descriptor_lib_element_t* element)
+{
+  return usb_midi_descriptor_lib_dev_find_element(slot(idx), element_id, element);
+}
+
+bool usb_midi_descriptor_lib_get_element_source(uint8_t idx, uint8_t element_id, uint8_t pin, uint8_t* source_id,
+  uint8_t* source_pin)
+{
+  return usb_midi_descriptor_lib_dev_get_element_source(slot(idx), element_id, pin, source_id, source_pin);
+}
+
+uint8_t usb_midi_descriptor_lib_get_num_audio_entities(uint8_t idx)
+{
+  return usb_midi_descriptor_lib_dev_get_num_audio_entities(slot(idx));
+}
+
+bool usb_midi_descriptor_lib_get_audio_entity(uint8_t idx, uint8_t entity_num, usb_midi_descriptor_lib_audio_entity_t* entity)
+{
+  return usb_midi_descriptor_lib_dev_get_audio_entity(slot(idx), entity_num, entity);
+}
+
+bool usb_midi_descriptor_lib_find_audio_entity(uint8_t idx, uint8_t id, usb_midi_descriptor_lib_audio_entity_t* entity)
+{
+  return usb_midi_descriptor_lib_dev_find_audio_entity(slot(idx), id, entity);
+}
+
+bool usb_midi_descriptor_lib_get_stats(uint8_t idx, usb_midi_descriptor_lib_stats_t* stats)
+{
+  return usb_midi_descriptor_lib_dev_get_stats(slot(idx), stats);
+}
+
+uint16_t usb_midi_descriptor_lib_get_bytes_used(uint8_t idx)
+{
+  return usb_midi_descriptor_lib_dev_get_bytes_used(slot(idx));
+}
+
+uint16_t usb_midi_descriptor_lib_save(uint8_t idx, uint8_t* buf, uint16_t maxlen)
+{
+  return usb_midi_descriptor_lib_dev_save(slot(idx), buf, maxlen);
+}
+
+bool usb_midi_descriptor_lib_restore(uint8_t idx, const uint8_t* buf, uint16_t len)
+{
+  return usb_midi_descriptor_lib_dev_restore(writer_slot(idx), buf, len);
+}
+
+bool usb_midi_descriptor_lib_restore_in_place(uint8_t idx, const uint8_t* buf, uint16_t len)
+{
+  return usb_midi_descriptor_lib_dev_restore_in_place(writer_slot(idx), buf, len);
+}
+
+uint16_t usb_midi_descriptor_lib_build_device_descriptor(uint8_t idx,
+  const usb_midi_descriptor_lib_device_cfg_t* cfg, uint8_t* buf, uint16_t maxlen)
+{
+  return usb_midi_descriptor_lib_dev_build_device_descriptor(slot(idx), cfg, buf, maxlen);
+}
+
+void usb_midi_descriptor_parser_init(usb_midi_descriptor_parser_t* parser, uint8_t idx)
+{
+  usb_midi_descriptor_parser_init_dev(parser, writer_slot(idx));
+}
@@ -0,0 +1,301 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#include "usb_midi_replug_cache.h"
+#include "usb_midi_descriptor_lib.h"
+#include "usb_midi_string_cache.h"
+
+#if USB_MIDI_REPLUG_CACHE_POOL_SIZE > 0xFFFF
+#error "USB_MIDI_REPLUG_CACHE_POOL_SIZE must fit in 16 bits"
+#endif
+
+typedef struct
+{
+  uint16_t vid;
+  uint16_t pid;
+  uint16_t bcd_device;
+  uint16_t desc_len;    // the number of MIDI interface descriptor bytes
+  uint32_t desc_hash;   // FNV-1a hash of the MIDI interface descriptor bytes
+} usb_midi_replug_cache_key_t;
+
+// Each entry's data in the pool is the usb_midi_descriptor_lib_save()
+// data followed by the usb_midi_string_cache_save() data
+typedef struct
+{
+  usb_midi_replug_cache_key_t key;
+  uint32_t last_used;   // the value of use_count when the entry was last stored or found
+  uint16_t offset;      // where the entry's data starts in the pool
+  uint16_t lib_len;     // the number of usb_midi_descriptor_lib_save() bytes
+  uint16_t strings_len; // the number of usb_midi_string_cache_save() bytes
+} usb_midi_replug_cache_entry_t;
+
+static usb_midi_replug_cache_entry_t entries[USB_MIDI_REPLUG_CACHE_ENTRIES];
+static uint8_t num_entries;
+static uint32_t use_count;
+
+// The data of all entries, packed together from the start of the pool
+static uint8_t pool[USB_MIDI_REPLUG_CACHE_POOL_SIZE];
+static uint16_t pool_used;
+
+// The images usb_midi_replug_cache_add_image() added
+static const uint8_t* images[USB_MIDI_REPLUG_CACHE_IMAGES];
+static uint8_t num_images;
+
+// An image is this header, the usb_midi_descriptor_lib_save() data, the
+// usb_midi_string_cache_save() data and the CRC-32 of everything before it.
+// Every multi-byte value is little endian.
+enum
+{
+  IMAGE_MAGIC = 0,               // 4 bytes, "UMRC"
+  IMAGE_VERSION = 4,
+  IMAGE_RESERVED,
+  IMAGE_LEN = 6,                 // 2 bytes, the whole image including the CRC
+  IMAGE_VID = 8,                 // 2 bytes
+  IMAGE_PID = 10,                // 2 bytes
+  IMAGE_BCD_DEVICE = 12,         // 2 bytes
+  IMAGE_DESC_LEN = 14,           // 2 bytes
+  IMAGE_DESC_HASH = 16,          // 4 bytes
+  IMAGE_LIB_LEN = 20,            // 2 bytes
+  IMAGE_STRINGS_LEN = 22,        // 2 bytes
+  IMAGE_HEADER_LEN = 24,
+  IMAGE_CRC_LEN = 4,
+  IMAGE_FORMAT_VERSION = 5,      // change this when the image or the saved data format changes
+};
+
+static const uint8_t image_magic[4] = {'U', 'M', 'R', 'C'};
+
+static uint16_t get_le16(const uint8_t* bytes)
+{
+  return bytes[0] | (bytes[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t* bytes)
+{
+  return bytes[0] | (bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void put_le16(uint8_t* bytes, uint16_t value)
+{
+  bytes[0] = value & 0xFF;
+  bytes[1] = value >> 8;
+}
+
+static void put_le32(uint8_t* bytes, uint32_t value)
+{
+  put_le16(bytes, value & 0xFFFF);
+  put_le16(bytes + 2, value >> 16);
+}
+
+// The CRC-32 of IEEE 802.3, the same as zlib's crc32(). Images are checked
+// only when they are added, so this trades speed for no table.
+static uint32_t image_crc32(const uint8_t* bytes, uint32_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t byte = 0; byte < len; byte++)
+  {
+    crc ^= bytes[byte];
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// The key usb_midi_replug_cache_lookup() computed for each device slot
+static usb_midi_replug_cache_key_t slot_keys[CFG_TUH_MIDI];
+static bool slot_key_valid[CFG_TUH_MIDI];
+
+static bool keys_equal(usb_midi_replug_cache_key_t const* a, usb_midi_replug_cache_key_t const* b)
+{
+  return a->vid == b->vid && a->pid == b->pid && a->bcd_device == b->bcd_device &&
+    a->desc_len == b->desc_len && a->desc_hash == b->desc_hash;
+}
+
+static usb_midi_replug_cache_entry_t* find_entry(usb_midi_replug_cache_key_t const* key)
+{
+  for (uint8_t entry = 0; entry < num_entries; entry++)
+  {
+    if (keys_equal(&entries[entry].key, key))
+      return entries + entry;
+  }
+  return NULL;
+}
+
+// Forget an entry and slide the data of the entries above it down
+static void remove_entry(usb_midi_replug_cache_entry_t* entry)
+{
+  uint16_t offset = entry->offset;
+  uint16_t len = entry->lib_len + entry->strings_len;
+  memmove(pool + offset, pool + offset + len, pool_used - offset - len);
+  pool_used -= len;
+  *entry = entries[--num_entries];
+  for (uint8_t other = 0; other < num_entries; other++)
+  {
+    if (entries[other].offset > offset)
+      entries[other].offset -= len;
+  }
+}
+
+static void remove_least_recently_used(void)
+{
+  usb_midi_replug_cache_entry_t* oldest = entries;
+  for (uint8_t entry = 1; entry < num_entries; entry++)
+  {
+    if (entries[entry].last_used < oldest->last_used)
+      oldest = entries + entry;
+  }
+  remove_entry(oldest);
+}
+
+// Restore device slot idx from the image with the given key, if there is one
+static bool lookup_image(uint8_t idx, uint8_t daddr, usb_midi_replug_cache_key_t const* key)
+{
+  for (uint8_t image_num = 0; image_num < num_images; image_num++)
+  {
+    const uint8_t* image = images[image_num];
+    usb_midi_replug_cache_key_t image_key = {
+      .vid = get_le16(image + IMAGE_VID),
+      .pid = get_le16(image + IMAGE_PID),
+      .bcd_device = get_le16(image + IMAGE_BCD_DEVICE),
+      .desc_len = get_le16(image + IMAGE_DESC_LEN),
+      .desc_hash = get_le32(image + IMAGE_DESC_HASH),
+    };
+    if (keys_equal(&image_key, key))
+    {
+      uint16_t lib_len = get_le16(image + IMAGE_LIB_LEN);
+      const uint8_t* lib_data = image + IMAGE_HEADER_LEN;
+      if (usb_midi_descriptor_lib_restore_in_place(idx, lib_data, lib_len) &&
+          usb_midi_string_cache_restore_in_place(idx, daddr, lib_data + lib_len, get_le16(image + IMAGE_STRINGS_LEN)))
+        return true;
+      usb_midi_descriptor_lib_init(idx);
+      return false;
+    }
+  }
+  return false;
+}
+
+bool usb_midi_replug_cache_lookup(uint8_t idx, uint8_t daddr, uint8_t const *midi_descriptor, uint32_t max_len)
+{
+  TU_VERIFY(idx < CFG_TUH_MIDI);
+  slot_key_valid[idx] = false;
+  tusb_desc_device_t desc_device;
+  TU_VERIFY(max_len <= 0xFFFF && tuh_descriptor_get_device_local(daddr, &desc_device));
+  usb_midi_replug_cache_key_t* key = slot_keys + idx;
+  key->vid = desc_device.idVendor;
+  key->pid = desc_device.idProduct;
+  key->bcd_device = desc_device.bcdDevice;
+  key->desc_len = max_len;
+  uint32_t hash = 2166136261u;
+  for (uint32_t byte = 0; byte < max_len; byte++)
+    hash = (hash ^ midi_descriptor[byte]) * 16777619u;
+  key->desc_hash = hash;
+  slot_key_valid[idx] = true;
+
+  usb_midi_replug_cache_entry_t* entry = find_entry(key);
+  if (entry == NULL)
+    return lookup_image(idx, daddr, key);
+  if (!usb_midi_descriptor_lib_restore(idx, pool + entry->offset, entry->lib_len) ||
+      !usb_midi_string_cache_restore(idx, daddr, pool + entry->offset + entry->lib_len, entry->strings_len))
+  {
+    // No room in the arena or the string pool; parse and fetch as usual
+    usb_midi_descriptor_lib_init(idx);
+    return false;
+  }
+  entry->last_used = ++use_count;
+  return true;
+}
+
+bool usb_midi_replug_cache_store(uint8_t idx)
+{
+  TU_VERIFY(idx < CFG_TUH_MIDI && slot_key_valid[idx]);
+  uint16_t lib_len = usb_midi_descriptor_lib_save(idx, NULL, 0);
+  uint16_t strings_len = usb_midi_string_cache_save(idx, NULL, 0);
+  TU_VERIFY(lib_len != 0 && strings_len != 0);
+  uint32_t len = (uint32_t)lib_len + strings_len;
+  TU_VERIFY(len <= sizeof(pool));
+  usb_midi_replug_cache_entry_t* entry = find_entry(slot_keys + idx);
+  if (entry)
+    remove_entry(entry);
+  while (num_entries == USB_MIDI_REPLUG_CACHE_ENTRIES || len > sizeof(pool) - pool_used)
+    remove_least_recently_used();
+  entry = entries + num_entries++;
+  entry->key = slot_keys[idx];
+  entry->last_used = ++use_count;
+  entry->offset = pool_used;
+  entry->lib_len = usb_midi_descriptor_lib_save(idx, pool + pool_used, lib_len);
+  entry->strings_len = usb_midi_string_cache_save(idx, pool + pool_used + lib_len, strings_len);
+  pool_used += len;
+  return true;
+}
+
+void usb_midi_replug_cache_clear(void)
+{
+  num_entries = 0;
+  pool_used = 0;
+  num_images = 0;
+  memset(slot_key_valid, 0, sizeof(slot_key_valid));
+}
+
+uint16_t usb_midi_replug_cache_save_image(uint8_t idx, uint8_t* buf, uint16_t maxlen)
+{
+  TU_VERIFY(idx < CFG_TUH_MIDI && slot_key_valid[idx], 0);
+  uint16_t lib_len = usb_midi_descriptor_lib_save(idx, NULL, 0);
+  uint16_t strings_len = usb_midi_string_cache_save(idx, NULL, 0);
+  TU_VERIFY(lib_len != 0 && strings_len != 0, 0);
+  uint32_t len = (uint32_t)IMAGE_HEADER_LEN + lib_len + strings_len + IMAGE_CRC_LEN;
+  TU_VERIFY(len <= 0xFFFF, 0);
+  if (buf == NULL)
+    return len;
+  TU_VERIFY(len <= maxlen, 0);
+  usb_midi_replug_cache_key_t const* key = slot_keys + idx;
+  memcpy(buf + IMAGE_MAGIC, image_magic, sizeof(image_magic));
+  buf[IMAGE_VERSION] = IMAGE_FORMAT_VERSION;
+  buf[IMAGE_RESERVED] = 0;
+  put_le16(buf + IMAGE_LEN, len);
+  put_le16(buf + IMAGE_VID, key->vid);
+  put_le16(buf + IMAGE_PID, key->pid);
+  put_le16(buf + IMAGE_BCD_DEVICE, key->bcd_device);
+  put_le16(buf + IMAGE_DESC_LEN, key->desc_len);
+  put_le32(buf + IMAGE_DESC_HASH, key->desc_hash);
+  put_le16(buf + IMAGE_LIB_LEN, lib_len);
+  put_le16(buf + IMAGE_STRINGS_LEN, strings_len);
+  usb_midi_descriptor_lib_save(idx, buf + IMAGE_HEADER_LEN, lib_len);
+  usb_midi_string_cache_save(idx, buf + IMAGE_HEADER_LEN + lib_len, strings_len);
+  put_le32(buf + len - IMAGE_CRC_LEN, image_crc32(buf, len - IMAGE_CRC_LEN));
+  return len;
+}
+
+bool usb_midi_replug_cache_add_image(const uint8_t* image, uint32_t maxlen)
+{
+  TU_VERIFY(num_images < USB_MIDI_REPLUG_CACHE_IMAGES);
+  TU_VERIFY(maxlen >= IMAGE_HEADER_LEN + IMAGE_CRC_LEN);
+  TU_VERIFY(memcmp(image + IMAGE_MAGIC, image_magic, sizeof(image_magic)) == 0);
+  TU_VERIFY(image[IMAGE_VERSION] == IMAGE_FORMAT_VERSION);
+  uint16_t len = get_le16(image + IMAGE_LEN);
+  TU_VERIFY(len <= maxlen);
+  TU_VERIFY((uint32_t)IMAGE_HEADER_LEN + get_le16(image + IMAGE_LIB_LEN) +
+    get_le16(image + IMAGE_STRINGS_LEN) + IMAGE_CRC_LEN == len);
+  TU_VERIFY(image_crc32(image, len - IMAGE_CRC_LEN) == get_le32(image + len - IMAGE_CRC_LEN));
+  images[num_images++] = image;
+  return true;
+}
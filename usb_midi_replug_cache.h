@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * This library remembers the parsed MIDI interface data and the cached
+ * strings of recently unplugged MIDI devices. When one of those devices is
+ * plugged in again, usb_midi_replug_cache_lookup() restores its device
+ * slots in usb_midi_descriptor_lib and usb_midi_string_cache without
+ * parsing and without requesting any string descriptors. A device matches
+ * only if its Vendor ID, Product ID, bcdDevice and a hash of its MIDI
+ * interface descriptors all match, so a firmware update or a different
+ * device of the same model with a different configuration is fetched again.
+ * The saved devices share a pool of USB_MIDI_REPLUG_CACHE_POOL_SIZE bytes;
+ * when the pool or the USB_MIDI_REPLUG_CACHE_ENTRIES entries are full, the
+ * least recently used device is forgotten.
+ *
+ * A device can also be saved as a flat image with
+ * usb_midi_replug_cache_save_image() and kept in flash so it survives a
+ * power cycle. usb_midi_replug_cache_add_image() checks an image once and
+ * adds it to the cache without copying it; a lookup that matches the image
+ * reads the device's data and strings directly from it, so images in
+ * memory mapped (XIP) flash use no RAM beyond the fixed part of the slot.
+ * An image has no pointers, stores every value little endian, needs no
+ * alignment, and carries a format version and a CRC-32.
+ *
+ * Like usb_midi_string_cache, the cache restores the CFG_TUH_MIDI device
+ * slots of the usb_midi_descriptor_lib index API and has no form for
+ * devices or arenas the application owns. An application with its own
+ * devices can still keep saved data or images of its own and restore them
+ * with usb_midi_descriptor_lib_dev_restore() or
+ * usb_midi_descriptor_lib_dev_restore_in_place().
+ */
+
+#pragma once
+#include <stdint.h>
+#include "tusb.h"
+
+// The number of devices the cache remembers
+#ifndef USB_MIDI_REPLUG_CACHE_ENTRIES
+#define USB_MIDI_REPLUG_CACHE_ENTRIES 8
+#endif
+
+// The number of bytes of saved device data all entries share
+#ifndef USB_MIDI_REPLUG_CACHE_POOL_SIZE
+#define USB_MIDI_REPLUG_CACHE_POOL_SIZE 2048
+#endif
+
+// The number of images usb_midi_replug_cache_add_image() can add
+#ifndef USB_MIDI_REPLUG_CACHE_IMAGES
+#define USB_MIDI_REPLUG_CACHE_IMAGES 4
+#endif
+
+/**
+ * @brief Look up a newly mounted device and restore its device slot on a hit
+ *
+ * Call this instead of usb_midi_descriptor_lib_configure() with the same
+ * MIDI interface descriptor bytes. On a miss, configure the slot and start
+ * usb_midi_string_cache as usual, then call usb_midi_replug_cache_store()
+ * once the strings are cached.
+ * @param idx the device slot
+ * @param daddr the device's USB address
+ * @param midi_descriptor the MIDI interface descriptors
+ * @param max_len the number of bytes of MIDI interface descriptors
+ * @return true if the device was found and its usb_midi_descriptor_lib and
+ * usb_midi_string_cache slots are restored
+ */
+bool usb_midi_replug_cache_lookup(uint8_t idx, uint8_t daddr, uint8_t const *midi_descriptor, uint32_t max_len);
+
+/**
+ * @brief Remember a configured device whose strings are all cached
+ *
+ * Call this from the usb_midi_string_cache complete callback. The device
+ * is stored under the key usb_midi_replug_cache_lookup() computed for the
+ * slot, replacing any older copy.
+ * @param idx the device slot
+ * @return true if the device was stored
+ */
+bool usb_midi_replug_cache_store(uint8_t idx);
+
+/**
+ * @brief Forget every remembered device and every added image
+ */
+void usb_midi_replug_cache_clear(void);
+
+/**
+ * @brief Save a configured device whose strings are all cached as a flat image
+ *
+ * The image holds the key usb_midi_replug_cache_lookup() computed for the
+ * slot, the parsed MIDI interface data and the cached strings.
+ * @param idx the device slot
+ * @param buf where to write the image, or NULL to get the number of bytes needed
+ * @param maxlen the size of buf
+ * @return uint16_t the size of the image, or 0 if the device cannot be saved
+ * or buf is too small
+ */
+uint16_t usb_midi_replug_cache_save_image(uint8_t idx, uint8_t* buf, uint16_t maxlen);
+
+/**
+ * @brief Add an image usb_midi_replug_cache_save_image() saved to the cache
+ *
+ * The image is checked once, here, and then read in place, so it must stay
+ * valid and unchanged until usb_midi_replug_cache_clear() and until every
+ * device slot restored from it is released. Images are
+ * looked up after the devices stored in RAM and are never evicted.
+ * @param image the image. It needs no alignment.
+ * @param maxlen the number of bytes available at image, which may be more
+ * than the image size, for example the size of a flash sector
+ * @return true if the image is valid, has the current format version, and
+ * there was room to add it
+ */
+bool usb_midi_replug_cache_add_image(const uint8_t* image, uint32_t maxlen);
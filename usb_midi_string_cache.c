@@ -0,0 +1,423 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "usb_midi_string_cache.h"
+#include "usb_midi_descriptor_lib.h"
+#include "utf16_to_utf8.h"
+
+// Device slot states
+enum
+{
+  CACHE_IDLE = 0,  // not started or released
+  CACHE_LANGID,    // waiting to fetch the language ID
+  CACHE_STRINGS,   // fetching strings
+  CACHE_COMPLETE,  // fetched every string
+};
+
+// A device fetches its device descriptor strings first, then its MIDI
+// interface strings in ascending string index order
+enum
+{
+  DEVICE_STR_MANUFACTURER = 0,
+  DEVICE_STR_PRODUCT,
+  DEVICE_STR_SERIAL,
+  NUM_DEVICE_STRINGS
+};
+
+typedef struct
+{
+  uint8_t state;
+  uint8_t daddr;
+  uint16_t langid;
+  uint8_t device_str_idx[NUM_DEVICE_STRINGS];
+  uint8_t next;    // the next string to fetch, in the order above
+  usb_midi_string_cache_cb_t complete_cb;
+  const uint8_t* in_place;  // saved strings read in place instead of from the pool
+  uint16_t in_place_len;
+  uint8_t strings_dropped;  // strings that arrived but did not fit in the pool
+} usb_midi_string_cache_info_t;
+
+static usb_midi_string_cache_info_t cache[CFG_TUH_MIDI];
+
+// Each string in the pool is the owner's device slot, the string index, the
+// number of UTF-8 bytes including the NULL termination, little endian in two
+// bytes, then the UTF-8 bytes. A string descriptor's 126 UTF-16 code units
+// can take 378 UTF-8 bytes, so the length does not fit in a byte.
+// Strings are appended as they arrive, so fetching never moves a string.
+#define POOL_ENTRY_HEADER_LEN 4
+static uint8_t pool[USB_MIDI_STRING_CACHE_POOL_SIZE];
+static uint16_t pool_used;
+
+// The request in flight, if any. Only one is in flight at a time.
+#define XFER_NONE 0xFF
+static uint8_t xfer_idx = XFER_NONE;
+static uint8_t xfer_str_idx;
+static uint8_t last_idx;        // the device slot that had the most recent turn
+static uint8_t xfer_buf[256];   // big enough for the largest string descriptor
+
+// Each device slot's release count. A request carries its slot and the
+// slot's generation in user_data, so the callback of a request whose slot
+// was released since, if it comes at all, is told apart and ignored.
+static uint8_t generation[CFG_TUH_MIDI];
+#define XFER_USER_DATA(idx) ((uintptr_t)(idx) | ((uintptr_t)generation[idx] << 8))
+
+static void string_xfer_cb(tuh_xfer_t* xfer);
+
+// The saved form of a device's strings is the Manufacturer, Product and
+// Serial Number string indices and the number of strings, then for each
+// string its string index, its two byte length including the NULL
+// termination and its UTF-8 bytes. This is a pool entry without the owner byte.
+#define SAVED_STRINGS_OFFSET (NUM_DEVICE_STRINGS + 1)
+#define SAVED_STRING_HEADER_LEN (POOL_ENTRY_HEADER_LEN - 1)
+
+// Return the length a pool entry or saved string stores at len_bytes
+static uint16_t string_len(const uint8_t* len_bytes)
+{
+  return len_bytes[0] | (len_bytes[1] << 8);
+}
+
+// The length of the pool entry at offset, header included
+static uint16_t pool_entry_len(uint16_t offset)
+{
+  return POOL_ENTRY_HEADER_LEN + string_len(pool + offset + 2);
+}
+
+// The length of the saved string at buf, header included
+static uint16_t saved_string_len(const uint8_t* buf)
+{
+  return SAVED_STRING_HEADER_LEN + string_len(buf + 1);
+}
+
+// Return the UTF-8 bytes of string str_idx of device idx or NULL if it is not cached
+static uint8_t const* find_string(uint8_t idx, uint8_t str_idx)
+{
+  for (uint16_t offset = 0; offset < pool_used; offset += pool_entry_len(offset))
+  {
+    if (pool[offset] == idx && pool[offset + 1] == str_idx)
+      return pool + offset + POOL_ENTRY_HEADER_LEN;
+  }
+  const uint8_t* saved = cache[idx].in_place;
+  for (uint16_t offset = SAVED_STRINGS_OFFSET; saved && offset < cache[idx].in_place_len; offset += saved_string_len(saved + offset))
+  {
+    if (saved[offset] == str_idx)
+      return saved + offset + SAVED_STRING_HEADER_LEN;
+  }
+  return NULL;
+}
+
+// Convert the string descriptor in xfer_buf to UTF-8 and append it to the pool
+static void add_string(uint8_t idx, uint8_t str_idx, uint32_t actual_len)
+{
+  if (actual_len < 2)
+    return;
+  // Allocate exactly what the whole string needs
+  size_t maxdest = utf16DescriptorToUtf8Length(xfer_buf, actual_len) + 1;
+  // A string that does not fit is left out rather than cut short
+  if (POOL_ENTRY_HEADER_LEN + maxdest > sizeof(pool) - pool_used)
+  {
+    if (cache[idx].strings_dropped < 0xFF)
+      ++cache[idx].strings_dropped;
+    return;
+  }
+  uint8_t* entry = pool + pool_used;
+  uint16_t len = utf16DescriptorToUtf8(xfer_buf, actual_len, entry + POOL_ENTRY_HEADER_LEN, maxdest) + 1;
+  entry[0] = idx;
+  entry[1] = str_idx;
+  entry[2] = len & 0xFF;
+  entry[3] = len >> 8;
+  pool_used += POOL_ENTRY_HEADER_LEN + len;
+}
+
+// Find the next string of device idx to fetch. Return its string index or 0 if there are no more.
+static uint8_t next_str_idx(uint8_t idx)
+{
+  usb_midi_string_cache_info_t* info = cache + idx;
+  const uint8_t* midi_str_idx = NULL;
+  int num_midi_strings = usb_midi_descriptor_lib_get_all_str_inidices(idx, &midi_str_idx);
+  if (num_midi_strings < 0)
+    num_midi_strings = 0;
+  for (; info->next < NUM_DEVICE_STRINGS + num_midi_strings; info->next++)
+  {
+    uint8_t str_idx = info->next < NUM_DEVICE_STRINGS ? info->device_str_idx[info->next] :
+      midi_str_idx[info->next - NUM_DEVICE_STRINGS];
+    // The device descriptor and the MIDI interface may share a string
+    if (str_idx != 0 && find_string(idx, str_idx) == NULL)
+      return str_idx;
+  }
+  return 0;
+}
+
+static void finish(uint8_t idx)
+{
+  cache[idx].state = CACHE_COMPLETE;
+  if (cache[idx].complete_cb)
+    cache[idx].complete_cb(idx);
+}
+
+// Issue the next request for device idx. Return true if the request is in flight.
+static bool issue_request(uint8_t idx)
+{
+  usb_midi_string_cache_info_t* info = cache + idx;
+  bool issued = false;
+  xfer_idx = idx;
+  if (info->state == CACHE_LANGID)
+  {
+    issued = tuh_descriptor_get_string_langid(info->daddr, xfer_buf, sizeof(xfer_buf), string_xfer_cb, XFER_USER_DATA(idx));
+  }
+  else if (info->state == CACHE_STRINGS)
+  {
+    xfer_str_idx = next_str_idx(idx);
+    if (xfer_str_idx == 0)
+      finish(idx);
+    else
+      issued = tuh_descriptor_get_string(info->daddr, xfer_str_idx, info->langid, xfer_buf, sizeof(xfer_buf), string_xfer_cb,
+        XFER_USER_DATA(idx));
+  }
+  if (!issued)
+    xfer_idx = XFER_NONE;
+  return issued;
+}
+
+// Give each device slot that has strings to fetch a turn until one issues a request
+static void issue_next_request(void)
+{
+  for (uint8_t turn = 0; turn < CFG_TUH_MIDI && xfer_idx == XFER_NONE; turn++)
+  {
+    last_idx = (last_idx + 1) % CFG_TUH_MIDI;
+    issue_request(last_idx);
+  }
+}
+
+static void string_xfer_cb(tuh_xfer_t* xfer)
+{
+  uint8_t idx = xfer->user_data & 0xFF;
+  // Ignore the callback of a request whose device slot was released since; it no longer owns xfer_idx
+  if (idx < CFG_TUH_MIDI && idx == xfer_idx && xfer->user_data == XFER_USER_DATA(idx))
+  {
+    xfer_idx = XFER_NONE;
+    usb_midi_string_cache_info_t* info = cache + idx;
+    if (info->state == CACHE_LANGID)
+    {
+      if (xfer->result == XFER_RESULT_SUCCESS && xfer->actual_len >= 4)
+      {
+        info->langid = xfer_buf[2] | (xfer_buf[3] << 8);
+        info->state = CACHE_STRINGS;
+      }
+      else
+      {
+        // A device without a language ID has no strings
+        finish(idx);
+      }
+    }
+    else if (info->state == CACHE_STRINGS)
+    {
+      // A string that fails to arrive is left out of the cache
+      if (xfer->result == XFER_RESULT_SUCCESS)
+        add_string(idx, xfer_str_idx, xfer->actual_len);
+      ++info->next;
+    }
+  }
+  issue_next_request();
+}
+
+void usb_midi_string_cache_init(uint8_t idx)
+{
+  if (idx >= CFG_TUH_MIDI)
+    return;
+  // TinyUSB drops the control transfer of an unplugged device without a
+  // callback, so free the request here. The host runs one control transfer
+  // at a time, so a later request can not start while this one still could
+  // complete, and if it does complete its generation no longer matches.
+  ++generation[idx];
+  if (xfer_idx == idx)
+    xfer_idx = XFER_NONE;
+  // Remove the device's strings and close the gaps they leave
+  uint16_t dest = 0;
+  for (uint16_t offset = 0; offset < pool_used;)
+  {
+    uint16_t len = pool_entry_len(offset);
+    if (pool[offset] != idx)
+    {
+      memmove(pool + dest, pool + offset, len);
+      dest += len;
+    }
+    offset += len;
+  }
+  pool_used = dest;
+  memset(cache + idx, 0, sizeof(cache[0]));
+}
+
+bool usb_midi_string_cache_start(uint8_t idx, uint8_t daddr, usb_midi_string_cache_cb_t complete_cb)
+{
+  TU_VERIFY(idx < CFG_TUH_MIDI);
+  usb_midi_string_cache_init(idx);
+  tusb_desc_device_t desc_device;
+  TU_VERIFY(tuh_descriptor_get_device_local(daddr, &desc_device));
+  usb_midi_string_cache_info_t* info = cache + idx;
+  info->daddr = daddr;
+  info->device_str_idx[DEVICE_STR_MANUFACTURER] = desc_device.iManufacturer;
+  info->device_str_idx[DEVICE_STR_PRODUCT] = desc_device.iProduct;
+  info->device_str_idx[DEVICE_STR_SERIAL] = desc_device.iSerialNumber;
+  info->complete_cb = complete_cb;
+  info->state = CACHE_LANGID;
+  issue_next_request();
+  return true;
+}
+
+void usb_midi_string_cache_task(void)
+{
+  issue_next_request();
+}
+
+bool usb_midi_string_cache_complete(uint8_t idx)
+{
+  return idx < CFG_TUH_MIDI && cache[idx].state == CACHE_COMPLETE;
+}
+
+uint8_t usb_midi_string_cache_get_strings_dropped(uint8_t idx)
+{
+  return idx < CFG_TUH_MIDI ? cache[idx].strings_dropped : 0;
+}
+
+const char* usb_midi_string_cache_get_string(uint8_t idx, uint8_t str_idx)
+{
+  if (idx >= CFG_TUH_MIDI || str_idx == 0)
+    return NULL;
+  return (const char*)find_string(idx, str_idx);
+}
+
+const char* usb_midi_string_cache_get_in_cable_name(uint8_t idx, uint8_t in_cable_num)
+{
+  return usb_midi_string_cache_get_string(idx, usb_midi_descriptor_lib_get_str_idx_for_in_cable(idx, in_cable_num));
+}
+
+const char* usb_midi_string_cache_get_out_cable_name(uint8_t idx, uint8_t out_cable_num)
+{
+  return usb_midi_string_cache_get_string(idx, usb_midi_descriptor_lib_get_str_idx_for_out_cable(idx, out_cable_num));
+}
+
+const char* usb_midi_string_cache_get_manufacturer(uint8_t idx)
+{
+  return idx < CFG_TUH_MIDI ? usb_midi_string_cache_get_string(idx, cache[idx].device_str_idx[DEVICE_STR_MANUFACTURER]) : NULL;
+}
+
+const char* usb_midi_string_cache_get_product(uint8_t idx)
+{
+  return idx < CFG_TUH_MIDI ? usb_midi_string_cache_get_string(idx, cache[idx].device_str_idx[DEVICE_STR_PRODUCT]) : NULL;
+}
+
+const char* usb_midi_string_cache_get_serial(uint8_t idx)
+{
+  return idx < CFG_TUH_MIDI ? usb_midi_string_cache_get_string(idx, cache[idx].device_str_idx[DEVICE_STR_SERIAL]) : NULL;
+}
+
+uint16_t usb_midi_string_cache_save(uint8_t idx, uint8_t* buf, uint16_t maxlen)
+{
+  TU_VERIFY(usb_midi_string_cache_complete(idx), 0);
+  usb_midi_string_cache_info_t const* info = cache + idx;
+  // Strings read in place come first, then the strings in the pool
+  uint16_t in_place_len = info->in_place ? info->in_place_len - SAVED_STRINGS_OFFSET : 0;
+  uint32_t len = SAVED_STRINGS_OFFSET + in_place_len;
+  uint32_t num_strings = info->in_place ? info->in_place[NUM_DEVICE_STRINGS] : 0;
+  for (uint16_t offset = 0; offset < pool_used; offset += pool_entry_len(offset))
+  {
+    if (pool[offset] == idx)
+    {
+      len += pool_entry_len(offset) - 1;
+      ++num_strings;
+    }
+  }
+  TU_VERIFY(len <= 0xFFFF && num_strings <= 0xFF, 0);
+  if (buf == NULL)
+    return len;
+  TU_VERIFY(len <= maxlen, 0);
+  memcpy(buf, info->device_str_idx, NUM_DEVICE_STRINGS);
+  buf[NUM_DEVICE_STRINGS] = num_strings;
+  uint8_t* dest = buf + SAVED_STRINGS_OFFSET;
+  if (in_place_len)
+  {
+    memcpy(dest, info->in_place + SAVED_STRINGS_OFFSET, in_place_len);
+    dest += in_place_len;
+  }
+  for (uint16_t offset = 0; offset < pool_used; offset += pool_entry_len(offset))
+  {
+    if (pool[offset] == idx)
+    {
+      memcpy(dest, pool + offset + 1, pool_entry_len(offset) - 1);
+      dest += pool_entry_len(offset) - 1;
+    }
+  }
+  return len;
+}
+
+// Cache saved strings for device idx by copying them to the pool or reading them in place
+static bool restore_strings(uint8_t idx, uint8_t daddr, const uint8_t* buf, uint16_t len, bool in_place)
+{
+  TU_VERIFY(idx < CFG_TUH_MIDI);
+  usb_midi_string_cache_init(idx);
+  TU_VERIFY(len >= SAVED_STRINGS_OFFSET);
+  // Check every string before adding any of them
+  uint32_t offset = SAVED_STRINGS_OFFSET;
+  for (uint8_t str = 0; str < buf[NUM_DEVICE_STRINGS]; str++)
+  {
+    TU_VERIFY(offset + SAVED_STRING_HEADER_LEN <= len);
+    uint16_t str_len = string_len(buf + offset + 1);
+    TU_VERIFY(str_len != 0 && offset + SAVED_STRING_HEADER_LEN + str_len <= len);
+    TU_VERIFY(buf[offset + SAVED_STRING_HEADER_LEN + str_len - 1] == 0); // NULL terminated
+    offset += SAVED_STRING_HEADER_LEN + str_len;
+  }
+  TU_VERIFY(offset == len);
+  usb_midi_string_cache_info_t* info = cache + idx;
+  if (in_place)
+  {
+    info->in_place = buf;
+    info->in_place_len = len;
+  }
+  else
+  {
+    // Each saved string takes one more byte in the pool for its owner
+    TU_VERIFY((uint32_t)len - SAVED_STRINGS_OFFSET + buf[NUM_DEVICE_STRINGS] <= sizeof(pool) - pool_used);
+    for (offset = SAVED_STRINGS_OFFSET; offset < len; offset += saved_string_len(buf + offset))
+    {
+      pool[pool_used] = idx;
+      memcpy(pool + pool_used + 1, buf + offset, saved_string_len(buf + offset));
+      pool_used += 1 + saved_string_len(buf + offset);
+    }
+  }
+  info->daddr = daddr;
+  memcpy(info->device_str_idx, buf, NUM_DEVICE_STRINGS);
+  info->state = CACHE_COMPLETE;
+  return true;
+}
+
+bool usb_midi_string_cache_restore(uint8_t idx, uint8_t daddr, const uint8_t* buf, uint16_t len)
+{
+  return restore_strings(idx, daddr, buf, len, false);
+}
+
+bool usb_midi_string_cache_restore_in_place(uint8_t idx, uint8_t daddr, const uint8_t* buf, uint16_t len)
+{
+  return restore_strings(idx, daddr, buf, len, true);
+}
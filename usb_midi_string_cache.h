@@ -0,0 +1,188 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * This library fetches the string descriptors of a configured MIDI device
+ * without blocking, converts each one to UTF-8 once, and keeps the result
+ * so the application can label the device and its virtual cables at any
+ * time. It fetches the Manufacturer, Product and Serial Number strings and
+ * every string index usb_midi_descriptor_lib_get_all_str_inidices() reports.
+ * Only one string request is in flight at a time for all devices, the same
+ * as the USB host's control transfers, and the devices take turns.
+ * The strings of all devices share a pool of
+ * USB_MIDI_STRING_CACHE_POOL_SIZE bytes.
+ *
+ * The cache works on the CFG_TUH_MIDI device slots of the
+ * usb_midi_descriptor_lib index API, so it links those slots and their
+ * arena in. It has no form for devices or arenas the application owns.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "tusb.h"
+
+// The number of bytes of UTF-8 string data, plus 4 bytes per string, that
+// all devices share. Strings that do not fit are not cached; every string
+// that is cached is whole, up to the 378 UTF-8 bytes the longest string
+// descriptor can need.
+#ifndef USB_MIDI_STRING_CACHE_POOL_SIZE
+#define USB_MIDI_STRING_CACHE_POOL_SIZE (CFG_TUH_MIDI * 512)
+#endif
+
+/**
+ * @brief Called once all of a device's strings have been fetched
+ *
+ * @param idx the device slot
+ */
+typedef void (*usb_midi_string_cache_cb_t)(uint8_t idx);
+
+/**
+ * @brief Release the strings of device slot idx and stop fetching them
+ *
+ * Call this when the device is unmounted. A string request still in flight
+ * for the device is abandoned, so the other devices' requests go on even if
+ * its callback never comes. The strings of other devices
+ * stay cached, but this moves them in the pool, so pointers the get
+ * functions returned before the call are no longer valid.
+ */
+void usb_midi_string_cache_init(uint8_t idx);
+
+/**
+ * @brief Start fetching the strings of a configured device
+ *
+ * Call this after usb_midi_descriptor_lib_configure() or the streaming
+ * parser has configured device slot idx and the device is mounted.
+ * @param daddr the device's USB address
+ * @param complete_cb called when all strings have been fetched; may be NULL
+ * @return true if fetching started
+ */
+bool usb_midi_string_cache_start(uint8_t idx, uint8_t daddr, usb_midi_string_cache_cb_t complete_cb);
+
+/**
+ * @brief Issue the next string request if the USB host was too busy to take it earlier
+ *
+ * Call this from the main loop after tuh_task().
+ */
+void usb_midi_string_cache_task(void);
+
+/**
+ * @brief Check if all of a device's strings have been fetched
+ *
+ * @return true if the device slot's strings are all cached
+ */
+bool usb_midi_string_cache_complete(uint8_t idx);
+
+/**
+ * @brief Get the number of a device's strings that arrived but were not cached
+ *
+ * A string is not cached if it does not fit in what is left of the pool.
+ * @return uint8_t the number of strings left out, up to 255
+ */
+uint8_t usb_midi_string_cache_get_strings_dropped(uint8_t idx);
+
+/**
+ * @brief Get a cached string by its string index
+ *
+ * @param str_idx the string index
+ * @return const char* the UTF-8 string or NULL if it is not cached
+ */
+const char* usb_midi_string_cache_get_string(uint8_t idx, uint8_t str_idx);
+
+/**
+ * @brief Get the name of a MIDI IN virtual cable of the first MIDI IN endpoint
+ *
+ * @param in_cable_num the cable number, 0-15
+ * @return const char* the UTF-8 name or NULL if the cable has no cached name
+ */
+const char* usb_midi_string_cache_get_in_cable_name(uint8_t idx, uint8_t in_cable_num);
+
+/**
+ * @brief Get the name of a MIDI OUT virtual cable of the first MIDI OUT endpoint
+ *
+ * @param out_cable_num the cable number, 0-15
+ * @return const char* the UTF-8 name or NULL if the cable has no cached name
+ */
+const char* usb_midi_string_cache_get_out_cable_name(uint8_t idx, uint8_t out_cable_num);
+
+/**
+ * @brief Get the device's Manufacturer string
+ *
+ * @return const char* the UTF-8 string or NULL if it is not cached
+ */
+const char* usb_midi_string_cache_get_manufacturer(uint8_t idx);
+
+/**
+ * @brief Get the device's Product string
+ *
+ * @return const char* the UTF-8 string or NULL if it is not cached
+ */
+const char* usb_midi_string_cache_get_product(uint8_t idx);
+
+/**
+ * @brief Get the device's Serial Number string
+ *
+ * @return const char* the UTF-8 string or NULL if it is not cached
+ */
+const char* usb_midi_string_cache_get_serial(uint8_t idx);
+
+/**
+ * @brief Copy the cached strings of a device to a flat buffer
+ *
+ * The saved data contains no pointers, so it can be kept anywhere and
+ * restored to any device slot with usb_midi_string_cache_restore().
+ * @param buf where to copy the strings, or NULL to get the number of bytes needed
+ * @param maxlen the size of buf
+ * @return uint16_t the number of bytes saved, or 0 if the device's strings
+ * are not all cached or buf is too small
+ */
+uint16_t usb_midi_string_cache_save(uint8_t idx, uint8_t* buf, uint16_t maxlen);
+
+/**
+ * @brief Cache the strings usb_midi_string_cache_save() saved, without fetching them
+ *
+ * After this, usb_midi_string_cache_complete() is true for the device slot
+ * and the get functions return the restored strings. The complete callback
+ * is not called.
+ * @param daddr the device's USB address
+ * @param buf the saved data
+ * @param len the number of bytes usb_midi_string_cache_save() returned
+ * @return true if the data is valid and fits in the pool. Otherwise the
+ * device slot has no cached strings.
+ */
+bool usb_midi_string_cache_restore(uint8_t idx, uint8_t daddr, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Cache strings usb_midi_string_cache_save() saved by reading them in place
+ *
+ * This is usb_midi_string_cache_restore() without copying the strings to
+ * the pool, for saved data in memory that does not change, such as memory
+ * mapped flash. The get functions return pointers into buf, and the device
+ * slot reads buf until usb_midi_string_cache_init() releases it.
+ * @param daddr the device's USB address
+ * @param buf the saved data. It needs no alignment.
+ * @param len the number of bytes usb_midi_string_cache_save() returned
+ * @return true if the data is valid. Otherwise the device slot has no cached strings.
+ */
+bool usb_midi_string_cache_restore_in_place(uint8_t idx, uint8_t daddr, const uint8_t* buf, uint16_t len);
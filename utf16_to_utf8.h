@@ -25,99 +25,160 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
-/// @brief convert the UTF-16 string from a USB string descriptor to a UTF-8 C-string
-///
-/// Only works with single 16-bit word src characters. U+0000 (NULL) is
-/// treated as a string terminator in the src string. On return dest is NULL terminated.
-/// See https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-23/#G20365.
-/// For conversion, see
-/// See https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-3/#G7404
-/// UTF-16 encoding that is not well formed emits U+FFFD See
-/// see https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-3/#G2155
-/// https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-5/#G40630
-///
-/// For easier to understand references, see
-/// https://en.wikipedia.org/wiki/UTF-8 and https://en.wikipedia.org/wiki/UTF-16
-/// @param src points to an array of UTF-16 encoded code units; may be NULL terminated.
-///        It is important that the byte order of the src array match the endian
-///        encoding order of the machine using this function or else this function
-///        will not work correctly. If there is a Byte Order Mark U+FEFF in src[0],
-///        it will be skipped and not encoded.
-/// @param maxsrc is at least as large as number of code units in the src array; if it is larger, then
-///        the array must be NULL terminated
-/// @param dest points to an array of bytes for storing the UTF-8 encoded string. It is NULL terminated
-/// @param maxdest is the maximum number of bytes that can be stored in the dest buffer, including the NULL termination
-/// @note if maxdest is set larger than the dest memory buffer size, bad things happen.
-/// @todo This function is more generally useful than just this class. Make this a separate repository.
-static void utf16ToUtf8(uint16_t* src, size_t maxsrc, uint8_t* dest, size_t maxdest) {
+#include <stdbool.h>
+#include <string.h>
+
+// Convert the ASCII code units a string starts with 4 at a time. Define this
+// to 0 to convert one code unit at a time.
+#ifndef UTF16_TO_UTF8_ASCII_FAST_PATH
+#define UTF16_TO_UTF8_ASCII_FAST_PATH 1
+#endif
+
+// Return code unit idx of src. If le_bytes is true, src is an array of bytes
+// that holds little endian code units at any alignment; otherwise src is an
+// array of uint16_t code units in the machine's byte order.
+static inline uint16_t utf16Unit(const void* src, size_t idx, bool le_bytes) {
+  if (le_bytes) {
+    const uint8_t* bytes = (const uint8_t*)src + 2*idx;
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+  }
+  return ((const uint16_t*)src)[idx];
+}
+
+#if UTF16_TO_UTF8_ASCII_FAST_PATH
+// Convert the ASCII code units at the start of src, from code unit *srcidx, 4
+// at a time while they are all ASCII and none is the NULL termination, and
+// return the number of bytes written to dest. On return *srcidx is the index
+// of the first code unit not converted. Most USB MIDI device strings are
+// ASCII; a string with one non-ASCII code unit usually has more, so the rest
+// of the string after the first group of 4 that is not all ASCII is left to
+// the one code unit at a time conversion, and a string that starts with a
+// non-ASCII code unit tries no group at all.
+static inline size_t utf16AsciiPrefixToUtf8(const void* src, bool le_bytes, size_t* srcidx_ptr, size_t maxsrc,
+                                            uint8_t* dest, size_t maxdest) {
+  size_t destidx = 0;
+  size_t srcidx = *srcidx_ptr;
+  while (srcidx + 4 <= maxsrc && (destidx + 4) < maxdest && utf16Unit(src, srcidx, le_bytes) < 0x80) {
+    uint64_t units;
+    if (le_bytes) {
+      // Assemble the code units the same way on any machine; compilers
+      // turn this into one load on a little endian machine
+      const uint8_t* bytes = (const uint8_t*)src + 2*srcidx;
+      units = (uint64_t)bytes[0] | ((uint64_t)bytes[1] << 8) | ((uint64_t)bytes[2] << 16) |
+              ((uint64_t)bytes[3] << 24) | ((uint64_t)bytes[4] << 32) | ((uint64_t)bytes[5] << 40) |
+              ((uint64_t)bytes[6] << 48) | ((uint64_t)bytes[7] << 56);
+    }
+    else {
+      memcpy(&units, (const uint16_t*)src + srcidx, sizeof(units));
+    }
+    // No code unit may have a bit set above bit 6. Adding 0x7F to each
+    // code unit sets its bit 7 only if the code unit is not 0.
+    if ((units & 0xFF80FF80FF80FF80ULL) != 0 ||
+        ((units + 0x007F007F007F007FULL) & 0x0080008000800080ULL) != 0x0080008000800080ULL) {
+      break;
+    }
+    if (le_bytes) {
+      // The first code unit is in the low bits on any machine
+      dest[destidx] = (uint8_t)units;
+      dest[destidx+1] = (uint8_t)(units >> 16);
+      dest[destidx+2] = (uint8_t)(units >> 32);
+      dest[destidx+3] = (uint8_t)(units >> 48);
+    }
+    else {
+      // Narrow each 16-bit code unit to a byte; this keeps the code units
+      // in order on both little and big endian machines
+      uint32_t bytes = (uint32_t)((units & 0xFF) | ((units >> 8) & 0xFF00) |
+                                  ((units >> 16) & 0xFF0000) | ((units >> 24) & 0xFF000000));
+      memcpy(dest + destidx, &bytes, sizeof(bytes));
+    }
+    destidx += 4;
+    srcidx += 4;
+  }
+  *srcidx_ptr = srcidx;
+  return destidx;
+}
+#endif
+
+// Common code of utf16ToUtf8Written() and utf16DescriptorToUtf8(). See
+// utf16ToUtf8Written() for a description of the parameters.
+static inline size_t utf16ToUtf8Core(const void* src, bool le_bytes, size_t maxsrc, uint8_t* dest, size_t maxdest) {
   size_t destidx = 0;
   size_t srcidx = 0; // The first word contains the string length in word and the descriptor type
-  if (srcidx < maxsrc && src[srcidx] == 0xFEFF) {
+  if (srcidx < maxsrc && utf16Unit(src, srcidx, le_bytes) == 0xFEFF) {
     ++srcidx; // ignore Byte Order Mark
   }
+#if UTF16_TO_UTF8_ASCII_FAST_PATH
+  destidx = utf16AsciiPrefixToUtf8(src, le_bytes, &srcidx, maxsrc, dest, maxdest);
+#endif
   for(;;) {
+    uint16_t unit;
     // assume a 0 word in the src array is a null termination
-    if (srcidx >= maxsrc || src[srcidx] == 0 || (destidx+1) >= maxdest) {
+    if (srcidx >= maxsrc || (unit = utf16Unit(src, srcidx, le_bytes)) == 0 || (destidx+1) >= maxdest) {
       dest[destidx] = 0;
       break;
     }
-    else if (src[srcidx] < 0x80) {
-      dest[destidx++] = src[srcidx++] & 0x7f;
+    else if (unit < 0x80) {
+      dest[destidx++] = unit & 0x7f;
+      ++srcidx;
     }
-    else if (src[srcidx] < 0x800) {
+    else if (unit < 0x800) {
       if ((destidx+2) >= maxdest) {
         // no room for a 2-byte code
         dest[destidx] = 0;
         break;
       }
       else {
-        dest[destidx++] = 0xC0 | ((src[srcidx] >> 6) & 0x1f);
-        dest[destidx++] = 0x80 | (src[srcidx++] & 0x3f);
+        dest[destidx++] = 0xC0 | ((unit >> 6) & 0x1f);
+        dest[destidx++] = 0x80 | (unit & 0x3f);
+        ++srcidx;
       }
     }
-    else if (src[srcidx] < 0xD800 || src[srcidx] >= 0xE000) {
+    else if (unit < 0xD800 || unit >= 0xE000) {
       if ((destidx+3) >= maxdest) {
         // no room for a 3-byte code
         dest[destidx] = 0;
         break;
       }
       else {
-        dest[destidx++] = 0xE0 | ((src[srcidx] >> 12) & 0xf);
-        dest[destidx++] = 0x80 | ((src[srcidx] >> 6) & 0x3f);
-        dest[destidx++] = 0x80 | (src[srcidx++] & 0x3f);
+        dest[destidx++] = 0xE0 | ((unit >> 12) & 0xf);
+        dest[destidx++] = 0x80 | ((unit >> 6) & 0x3f);
+        dest[destidx++] = 0x80 | (unit & 0x3f);
+        ++srcidx;
       }
     }
     else if ((srcidx+1) < maxsrc) {
       // should be paired surrogate
-      if ((destidx + 4) < maxdest) {
-        // There is enough room to decode a paired surrogate
-        if (src[srcidx] >= 0xD800 && src[srcidx] < 0xDC00 &&
-            src[srcidx+1] >= 0xDC00 && src[srcidx+1] < 0xE000) {
-          // There is a well-formed surrogate pair
-
-          // compute the 32-bit UTF code point
-          uint32_t upper = src[srcidx++] & 0x3FF;
-          uint32_t lower = src[srcidx++] & 0x3FF;
-          uint32_t code = ((upper << 10) | lower) + 0x10000;
-          // Convert to UTF-8
-          dest[destidx++] = 0xF0 | ((code >> 18) & 0x07);
-          dest[destidx++] = 0x80 | ((code >> 12) & 0x3f);
-          dest[destidx++] = 0x80 | ((code >> 6) & 0x3f);
-          dest[destidx++] = 0x80 | (code & 0x3f);
-        }
-        else {
-          // Unpaired surrogate value; encode with replacement character U+FFFD
-          // and attempt to keep going
-          dest[destidx++] = 0xEF;
-          dest[destidx++] = 0xBF;
-          dest[destidx++] = 0xBD;
-          ++srcidx;
+      uint16_t next = utf16Unit(src, srcidx+1, le_bytes);
+      if (unit < 0xDC00 && next >= 0xDC00 && next < 0xE000) {
+        // There is a well-formed surrogate pair
+        if ((destidx + 4) >= maxdest) {
+          // Not enough room to decode the surrogate pair. Give up
+          dest[destidx] = 0;
+          break;
         }
+        // compute the 32-bit UTF code point
+        uint32_t upper = unit & 0x3FF;
+        uint32_t lower = next & 0x3FF;
+        uint32_t code = ((upper << 10) | lower) + 0x10000;
+        srcidx += 2;
+        // Convert to UTF-8
+        dest[destidx++] = 0xF0 | ((code >> 18) & 0x07);
+        dest[destidx++] = 0x80 | ((code >> 12) & 0x3f);
+        dest[destidx++] = 0x80 | ((code >> 6) & 0x3f);
+        dest[destidx++] = 0x80 | (code & 0x3f);
       }
       else {
-        // Not enough room to decode the surrogate pair. Give up
-        dest[destidx] = 0;
-        break;
+        if ((destidx + 3) >= maxdest) {
+          // Not enough room for the replacement character. Give up
+          dest[destidx] = 0;
+          break;
+        }
+        // Unpaired surrogate value; encode with replacement character U+FFFD
+        // and attempt to keep going
+        dest[destidx++] = 0xEF;
+        dest[destidx++] = 0xBF;
+        dest[destidx++] = 0xBD;
+        ++srcidx;
       }
     }
     else {
@@ -133,4 +194,129 @@ static void utf16ToUtf8(uint16_t* src, size_t maxsrc, uint8_t* dest, size_t maxd
       break;
     }
   }
+  return destidx;
+}
+
+// Common code of utf16ToUtf8Length() and utf16DescriptorToUtf8Length()
+static inline size_t utf16ToUtf8LengthCore(const void* src, bool le_bytes, size_t maxsrc) {
+  size_t len = 0;
+  size_t srcidx = 0;
+  if (srcidx < maxsrc && utf16Unit(src, srcidx, le_bytes) == 0xFEFF) {
+    ++srcidx; // ignore Byte Order Mark
+  }
+  for (; srcidx < maxsrc; srcidx++) {
+    uint16_t unit = utf16Unit(src, srcidx, le_bytes);
+    if (unit == 0) {
+      break;
+    }
+    else if (unit < 0x80) {
+      len += 1;
+    }
+    else if (unit < 0x800) {
+      len += 2;
+    }
+    else if (unit >= 0xD800 && unit < 0xDC00 && (srcidx+1) < maxsrc &&
+             utf16Unit(src, srcidx+1, le_bytes) >= 0xDC00 && utf16Unit(src, srcidx+1, le_bytes) < 0xE000) {
+      // A well-formed surrogate pair
+      len += 4;
+      ++srcidx;
+    }
+    else {
+      // Any other code unit, including an unpaired surrogate encoded as U+FFFD
+      len += 3;
+    }
+  }
+  return len;
+}
+
+/// @brief convert the UTF-16 string from a USB string descriptor to a UTF-8 C-string
+/// and return the number of bytes written
+///
+/// Only works with single 16-bit word src characters. U+0000 (NULL) is
+/// treated as a string terminator in the src string. On return dest is NULL terminated.
+/// See https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-23/#G20365.
+/// For conversion, see
+/// See https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-3/#G7404
+/// UTF-16 encoding that is not well formed emits U+FFFD See
+/// see https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-3/#G2155
+/// https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-5/#G40630
+///
+/// For easier to understand references, see
+/// https://en.wikipedia.org/wiki/UTF-8 and https://en.wikipedia.org/wiki/UTF-16
+/// @param src points to an array of UTF-16 encoded code units; may be NULL terminated.
+///        It is important that the byte order of the src array match the endian
+///        encoding order of the machine using this function or else this function
+///        will not work correctly. utf16DescriptorToUtf8() converts the string
+///        descriptor bytes directly. If there is a Byte Order Mark U+FEFF in src[0],
+///        it will be skipped and not encoded.
+/// @param maxsrc is at least as large as number of code units in the src array; if it is larger, then
+///        the array must be NULL terminated
+/// @param dest points to an array of bytes for storing the UTF-8 encoded string. It is NULL terminated
+/// @param maxdest is the maximum number of bytes that can be stored in the dest buffer, including the NULL termination
+/// @return the number of UTF-8 bytes written to dest, not counting the NULL termination
+/// @note if maxdest is set larger than the dest memory buffer size, bad things happen.
+/// If maxdest is utf16ToUtf8Length(src, maxsrc) + 1, the whole string fits.
+/// @todo This function is more generally useful than just this class. Make this a separate repository.
+static inline size_t utf16ToUtf8Written(uint16_t* src, size_t maxsrc, uint8_t* dest, size_t maxdest) {
+  return utf16ToUtf8Core(src, false, maxsrc, dest, maxdest);
+}
+
+/// @brief convert the UTF-16 string from a USB string descriptor to a UTF-8 C-string
+///
+/// This is utf16ToUtf8Written() without the return value.
+static inline void utf16ToUtf8(uint16_t* src, size_t maxsrc, uint8_t* dest, size_t maxdest) {
+  (void)utf16ToUtf8Written(src, maxsrc, dest, maxdest);
+}
+
+/// @brief get the number of bytes utf16ToUtf8() needs to convert a UTF-16 string
+///
+/// The src string is measured by the same rules utf16ToUtf8() converts it by:
+/// a leading Byte Order Mark is skipped, U+0000 ends the string, and each code
+/// unit that is not part of a well-formed surrogate pair takes the 3 bytes of U+FFFD.
+/// @param src points to an array of UTF-16 encoded code units; may be NULL terminated.
+/// @param maxsrc is at least as large as number of code units in the src array; if it is larger, then
+///        the array must be NULL terminated
+/// @return the number of UTF-8 bytes, not counting the NULL termination
+static inline size_t utf16ToUtf8Length(const uint16_t* src, size_t maxsrc) {
+  return utf16ToUtf8LengthCore(src, false, maxsrc);
+}
+
+// The number of UTF-16 code units in string descriptor desc, using bLength
+// but no more than the desc_len bytes that are valid. A descriptor that is
+// not a string descriptor has none.
+static inline size_t utf16DescriptorUnits(const uint8_t* desc, size_t desc_len) {
+  if (desc_len < 2 || desc[1] != 3) { // 3 is TUSB_DESC_STRING
+    return 0;
+  }
+  if (desc[0] < desc_len) {
+    desc_len = desc[0];
+  }
+  return desc_len < 2 ? 0 : (desc_len - 2) / 2;
+}
+
+/// @brief convert a USB string descriptor straight from its bytes to a UTF-8 C-string
+///
+/// This is utf16ToUtf8Written() for the string descriptor as it arrives from the
+/// device. The code units are read as little endian bytes, so desc needs no
+/// alignment, the machine may be little or big endian, and there is no need
+/// to copy the descriptor to a uint16_t array first.
+/// @param desc points to the string descriptor, starting with its bLength and
+///        bDescriptorType bytes
+/// @param desc_len is the number of valid bytes at desc, for example the number
+///        of bytes the transfer returned. Bytes past bLength or past desc_len are not read.
+/// @param dest points to an array of bytes for storing the UTF-8 encoded string. It is NULL terminated
+/// @param maxdest is the maximum number of bytes that can be stored in the dest buffer, including the NULL termination
+/// @return the number of UTF-8 bytes written to dest, not counting the NULL termination.
+///         If desc is not a string descriptor, dest is set to the empty string.
+static inline size_t utf16DescriptorToUtf8(const uint8_t* desc, size_t desc_len, uint8_t* dest, size_t maxdest) {
+  return utf16ToUtf8Core(desc + 2, true, utf16DescriptorUnits(desc, desc_len), dest, maxdest);
+}
+
+/// @brief get the number of bytes utf16DescriptorToUtf8() needs to convert a USB string descriptor
+/// @param desc points to the string descriptor, starting with its bLength and
+///        bDescriptorType bytes
+/// @param desc_len is the number of valid bytes at desc
+/// @return the number of UTF-8 bytes, not counting the NULL termination
+static inline size_t utf16DescriptorToUtf8Length(const uint8_t* desc, size_t desc_len) {
+  return utf16ToUtf8LengthCore(desc + 2, true, utf16DescriptorUnits(desc, desc_len));
 }
@@ -0,0 +1,152 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 rppicomidi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief convert a UTF-8 C-string to a USB string descriptor and return its length
+///
+/// The descriptor is written as bytes: dest[0] is bLength, dest[1] is
+/// bDescriptorType (3, STRING) and the UTF-16LE code units follow, low byte
+/// first. The result is the same on little and big endian machines and dest
+/// needs no alignment. The descriptor has no NULL termination.
+///
+/// Code points above U+FFFF are encoded as surrogate pairs. UTF-8 that is not
+/// well formed emits one U+FFFD for each maximal subpart of an ill-formed
+/// sequence, which is the practice the Unicode standard recommends. See
+/// https://www.unicode.org/versions/Unicode16.0.0/core-spec/chapter-3/#G66453
+/// A string too long for the descriptor is truncated at a code point boundary,
+/// so a surrogate pair is never split.
+/// @param src points to an array of UTF-8 encoded bytes; may be NULL terminated
+/// @param maxsrc is at least as large as number of bytes in the src array; if it is larger, then
+///        the array must be NULL terminated
+/// @param dest points to the buffer for the string descriptor. If dest is NULL,
+///        nothing is written and only the length is computed
+/// @param maxdest is the maximum number of bytes that can be stored in the dest buffer.
+///        A string descriptor is at most 254 bytes long, so larger values are treated as 254.
+/// @return the bLength of the descriptor, which is the number of bytes written to dest,
+///         or 0 if maxdest is too small for the 2 byte descriptor header
+/// @note if maxdest is set larger than the dest memory buffer size, bad things happen.
+static inline size_t utf8ToUtf16Descriptor(const uint8_t* src, size_t maxsrc, uint8_t* dest, size_t maxdest) {
+  if (maxdest > 254) {
+    maxdest = 254; // bLength is 8 bits and must be even
+  }
+  if (maxdest < 2) {
+    return 0;
+  }
+  size_t destidx = 2;
+  size_t srcidx = 0;
+  while (srcidx < maxsrc && src[srcidx] != 0) {
+    uint8_t lead = src[srcidx];
+    uint32_t code;
+    size_t ncont;  // number of continuation bytes lead calls for
+    uint8_t lower = 0x80; // range of the first continuation byte
+    uint8_t upper = 0xBF;
+    if (lead < 0x80) {
+      code = lead;
+      ncont = 0;
+    }
+    else if (lead >= 0xC2 && lead < 0xE0) {
+      code = lead & 0x1F;
+      ncont = 1;
+    }
+    else if (lead >= 0xE0 && lead < 0xF0) {
+      code = lead & 0x0F;
+      ncont = 2;
+      if (lead == 0xE0) {
+        lower = 0xA0; // no overlong 3-byte codes
+      }
+      else if (lead == 0xED) {
+        upper = 0x9F; // no surrogate code points
+      }
+    }
+    else if (lead >= 0xF0 && lead < 0xF5) {
+      code = lead & 0x07;
+      ncont = 3;
+      if (lead == 0xF0) {
+        lower = 0x90; // no overlong 4-byte codes
+      }
+      else if (lead == 0xF4) {
+        upper = 0x8F; // nothing above U+10FFFF
+      }
+    }
+    else {
+      // A continuation byte without a lead byte, or a byte that never occurs in UTF-8
+      code = 0xFFFD;
+      ncont = 0;
+    }
+    size_t nused = 1;
+    while (nused <= ncont) {
+      if ((srcidx + nused) >= maxsrc || src[srcidx + nused] < lower || src[srcidx + nused] > upper) {
+        // Truncated sequence: the bytes so far are one maximal subpart. The
+        // byte that ended it starts the next character.
+        code = 0xFFFD;
+        break;
+      }
+      code = (code << 6) | (src[srcidx + nused] & 0x3F);
+      lower = 0x80;
+      upper = 0xBF;
+      ++nused;
+    }
+    size_t nbytes = code >= 0x10000 ? 4 : 2;
+    if ((destidx + nbytes) > maxdest) {
+      // no room for the whole character
+      break;
+    }
+    if (dest) {
+      if (nbytes == 4) {
+        code -= 0x10000;
+        uint16_t high = 0xD800 | (code >> 10);
+        uint16_t low = 0xDC00 | (code & 0x3FF);
+        dest[destidx] = high & 0xFF;
+        dest[destidx+1] = high >> 8;
+        dest[destidx+2] = low & 0xFF;
+        dest[destidx+3] = low >> 8;
+      }
+      else {
+        dest[destidx] = code & 0xFF;
+        dest[destidx+1] = code >> 8;
+      }
+    }
+    destidx += nbytes;
+    srcidx += nused;
+  }
+  if (dest) {
+    dest[0] = (uint8_t)destidx;
+    dest[1] = 3; // TUSB_DESC_STRING
+  }
+  return destidx;
+}
+
+/// @brief get the bLength of the USB string descriptor utf8ToUtf16Descriptor() builds
+///
+/// This is utf8ToUtf16Descriptor() with a NULL dest and the largest descriptor size.
+/// @param src points to an array of UTF-8 encoded bytes; may be NULL terminated
+/// @param maxsrc is at least as large as number of bytes in the src array; if it is larger, then
+///        the array must be NULL terminated
+/// @return the number of descriptor bytes, including the 2 byte header
+static inline size_t utf8ToUtf16DescriptorLength(const uint8_t* src, size_t maxsrc) {
+  return utf8ToUtf16Descriptor(src, maxsrc, NULL, 254);
+}